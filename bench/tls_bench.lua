@@ -0,0 +1,483 @@
+--
+-- Copyright (C) 2026 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+-- bench/tls_bench.lua
+-- lua-net
+--
+-- TLS handshake and record-layer benchmarks over loopback.
+--
+-- usage: lua bench/tls_bench.lua [--only=<name>[,<name>...]]
+--                                [--duration=<sec>] [--bytes=<n>]
+--
+-- results are written to stdout as JSON Lines; see bench/README.md.
+--
+local concat = table.concat
+local format = string.format
+local sort = table.sort
+local exec = require('exec').execvp
+local gettime = require('time.clock').gettime
+local inet = require('net.stream.inet')
+local unix = require('net.stream.unix')
+
+local HOST = '127.0.0.1'
+local BUFSIZE = 65536
+local TRANSPORTS = {
+    'inet',
+    'unix',
+}
+-- 'bio': memory BIO rings of src/tls_bio.c, 'fd': SSL_set_fd
+local IO_PATHS = {
+    'bio',
+    'fd',
+}
+local CIPHERSUITES = {
+    'TLS_AES_128_GCM_SHA256',
+    'TLS_AES_256_GCM_SHA384',
+    'TLS_CHACHA20_POLY1305_SHA256',
+}
+local WRITE_SIZES = {
+    1024,
+    16384,
+    65536,
+}
+local LATENCY_SIZE = 64
+
+--- encode a flat record as a JSON object in the order of keys
+--- @param keys string[]
+--- @param rec table
+--- @return string
+local function encode(keys, rec)
+    local list = {}
+    for _, k in ipairs(keys) do
+        local v = rec[k]
+        if type(v) == 'string' then
+            v = '"' .. v:gsub('[%c"\\]', function(c)
+                return format('\\u%04x', c:byte())
+            end) .. '"'
+        elseif type(v) == 'number' then
+            v = v == math.floor(v) and format('%d', v) or format('%.3f', v)
+        elseif v == nil then
+            v = 'null'
+        else
+            v = tostring(v)
+        end
+        list[#list + 1] = format('"%s":%s', k, v)
+    end
+    return '{' .. concat(list, ',') .. '}'
+end
+
+local function report(keys, rec)
+    io.stdout:write(encode(keys, rec), '\n')
+    io.stdout:flush()
+end
+
+--- run a command and return its stdout lines
+--- @param cmd string
+--- @param argv string[]
+--- @return string[] lines
+local function run(cmd, argv)
+    local p = assert(exec(cmd, argv))
+    local lines = {}
+    for line in p.stdout:lines() do
+        lines[#lines + 1] = line
+    end
+    local res = assert(p:close())
+    if res.exit ~= 0 then
+        error(format('%s exited with %d', cmd, res.exit))
+    end
+    return lines
+end
+
+--- server process: serve the connections one by one until a connection sends
+--- 'QUIT' first.  if sink is 0, echo back the received data, otherwise reply
+--- 'ok' every time sink bytes have been received.
+local function serve(transport, addr, io_path, ciphersuites, sink, cert, key)
+    local tlscfg = {
+        cert = cert,
+        key = key,
+        use_bio = io_path == 'bio',
+        ciphersuites = ciphersuites ~= '-' and ciphersuites or nil,
+    }
+    local server
+    if transport == 'inet' then
+        server = assert(inet.server.new(HOST, 0, {
+            reuseaddr = true,
+            tlscfg = tlscfg,
+        }))
+        addr = tostring(assert(server:getsockname()):port())
+    else
+        server = assert(unix.server.new(addr, tlscfg))
+    end
+    assert(server:listen(1024))
+    io.stdout:write(addr, '\n')
+    io.stdout:flush()
+
+    sink = assert(tonumber(sink))
+    while true do
+        local peer = server:accept()
+        if peer then
+            local msg = peer:read(BUFSIZE)
+            if msg == 'QUIT' then
+                peer:close()
+                break
+            end
+
+            local n = 0
+            while msg do
+                if sink == 0 then
+                    peer:write(msg)
+                else
+                    n = n + #msg
+                    if n >= sink then
+                        peer:write('ok')
+                        n = n - sink
+                    end
+                end
+                msg = peer:read(BUFSIZE)
+            end
+            peer:close()
+        end
+    end
+    server:close()
+    if transport == 'unix' then
+        os.remove(addr)
+    end
+end
+
+--- @class bench.Server
+--- @field proc exec.process
+--- @field transport string
+--- @field io_path string
+--- @field addr string
+--- @field ciphersuites string?
+
+--- start a server process
+--- @return bench.Server
+local function start_server(cfg, transport, io_path, ciphersuites, sink)
+    local addr = '-'
+    if transport == 'unix' then
+        addr = os.tmpname()
+        os.remove(addr)
+    end
+    local proc = assert(exec(arg[-1], {
+        arg[0],
+        'server',
+        transport,
+        addr,
+        io_path,
+        ciphersuites or '-',
+        tostring(sink or 0),
+        cfg.cert,
+        cfg.key,
+    }))
+    for line in proc.stdout:lines() do
+        addr = line
+        break
+    end
+    return {
+        proc = proc,
+        transport = transport,
+        io_path = io_path,
+        addr = addr,
+        ciphersuites = ciphersuites,
+    }
+end
+
+--- connect to the server
+--- @param srv bench.Server
+--- @return net.tls.stream.Socket conn
+local function connect(srv)
+    local opts = {
+        tlscfg = {
+            noverify_name = true,
+            noverify_time = true,
+            noverify_cert = true,
+            use_bio = srv.io_path == 'bio',
+            ciphersuites = srv.ciphersuites,
+        },
+    }
+    local conn, err
+    if srv.transport == 'inet' then
+        conn, err = inet.client.new(HOST, srv.addr, opts)
+    else
+        conn, err = unix.client.new(srv.addr, opts)
+    end
+    assert(conn, err)
+    assert(conn:handshake())
+    return conn
+end
+
+local function stop_server(srv)
+    local conn = connect(srv)
+    assert(conn:write('QUIT'))
+    conn:read(BUFSIZE)
+    conn:close()
+    srv.proc:close()
+end
+
+local function bench_handshake(cfg, srv)
+    local n = 0
+    local t0 = gettime()
+    local elapsed = 0
+    while elapsed < cfg.duration do
+        local conn = connect(srv)
+        conn:close()
+        n = n + 1
+        elapsed = gettime() - t0
+    end
+    report({
+        'bench',
+        'client',
+        'transport',
+        'io',
+        'mode',
+        'n',
+        'sec',
+        'ops_per_sec',
+    }, {
+        bench = 'handshake',
+        client = 'net',
+        transport = srv.transport,
+        io = srv.io_path,
+        mode = 'full',
+        n = n,
+        sec = elapsed,
+        ops_per_sec = n / elapsed,
+    })
+end
+
+--- full and resumed handshakes against the server, driven by
+--- `openssl s_time`.  net.tls.client does not resume sessions, and s_time
+--- only resumes TLS 1.2 sessions since it does not read the TLS 1.3 tickets.
+local function bench_handshake_s_time(cfg, srv)
+    local sec = tostring(math.max(1, math.floor(cfg.duration)))
+    for _, mode in ipairs({
+        'full',
+        'resumed',
+    }) do
+        local lines = run('openssl', {
+            's_time',
+            '-connect',
+            HOST .. ':' .. srv.addr,
+            '-tls1_2',
+            mode == 'full' and '-new' or '-reuse',
+            '-time',
+            sec,
+        })
+        local n, elapsed
+        for _, line in ipairs(lines) do
+            n, elapsed = line:match('(%d+) connections in (%d+) real seconds')
+            if n then
+                break
+            end
+        end
+        n, elapsed = assert(tonumber(n)), assert(tonumber(elapsed))
+        report({
+            'bench',
+            'client',
+            'transport',
+            'io',
+            'mode',
+            'n',
+            'sec',
+            'ops_per_sec',
+        }, {
+            bench = 'handshake',
+            client = 'openssl s_time',
+            transport = srv.transport,
+            io = srv.io_path,
+            mode = mode,
+            n = n,
+            sec = elapsed,
+            ops_per_sec = n / elapsed,
+        })
+    end
+end
+
+local function bench_throughput(cfg, srv, write_size)
+    local conn = connect(srv)
+    local chunk = string.rep('x', write_size)
+    local remain = cfg.bytes
+    local t0 = gettime()
+    while remain > 0 do
+        local data = remain < write_size and chunk:sub(1, remain) or chunk
+        local len = assert(conn:write(data))
+        remain = remain - len
+    end
+    assert(conn:read(BUFSIZE) == 'ok', 'server did not receive all bytes')
+    local elapsed = gettime() - t0
+    conn:close()
+
+    report({
+        'bench',
+        'transport',
+        'io',
+        'ciphersuite',
+        'write_size',
+        'bytes',
+        'sec',
+        'mib_per_sec',
+    }, {
+        bench = 'throughput',
+        transport = srv.transport,
+        io = srv.io_path,
+        ciphersuite = srv.ciphersuites,
+        write_size = write_size,
+        bytes = cfg.bytes,
+        sec = elapsed,
+        mib_per_sec = cfg.bytes / elapsed / 1048576,
+    })
+end
+
+local function percentile(list, p)
+    return list[math.max(1, math.ceil(#list * p))]
+end
+
+local function bench_latency(cfg, srv)
+    local conn = connect(srv)
+    local payload = string.rep('x', LATENCY_SIZE)
+    local list = {}
+    local t0 = gettime()
+    local elapsed = 0
+
+    while elapsed < cfg.duration do
+        local t = gettime()
+        assert(conn:write(payload))
+        local got = 0
+        while got < LATENCY_SIZE do
+            got = got + #assert(conn:read(BUFSIZE))
+        end
+        list[#list + 1] = (gettime() - t) * 1e6
+        elapsed = gettime() - t0
+    end
+    conn:close()
+
+    sort(list)
+    report({
+        'bench',
+        'transport',
+        'io',
+        'size',
+        'n',
+        'p50_us',
+        'p90_us',
+        'p99_us',
+        'p999_us',
+        'max_us',
+    }, {
+        bench = 'latency',
+        transport = srv.transport,
+        io = srv.io_path,
+        size = LATENCY_SIZE,
+        n = #list,
+        p50_us = percentile(list, 0.5),
+        p90_us = percentile(list, 0.9),
+        p99_us = percentile(list, 0.99),
+        p999_us = percentile(list, 0.999),
+        max_us = list[#list],
+    })
+end
+
+local function gencert(cfg)
+    cfg.cert = os.tmpname()
+    cfg.key = os.tmpname()
+    run('openssl', {
+        'req',
+        '-new',
+        '-newkey',
+        'ec',
+        '-pkeyopt',
+        'ec_paramgen_curve:prime256v1',
+        '-nodes',
+        '-x509',
+        '-days',
+        '1',
+        '-keyout',
+        cfg.key,
+        '-out',
+        cfg.cert,
+        '-subj',
+        '/CN=localhost',
+    })
+end
+
+local function main(...)
+    local cfg = {
+        only = {},
+        duration = 2,
+        bytes = 64 * 1048576,
+    }
+    for _, v in ipairs({
+        ...,
+    }) do
+        local k, val = v:match('^%-%-(%w+)=(.+)$')
+        if k == 'only' then
+            for name in val:gmatch('[^,]+') do
+                cfg.only[name] = true
+            end
+        elseif k == 'duration' or k == 'bytes' then
+            cfg[k] = assert(tonumber(val), k .. ' must be number')
+        else
+            error('unknown option: ' .. v)
+        end
+    end
+    local function enabled(name)
+        return next(cfg.only) == nil or cfg.only[name]
+    end
+
+    gencert(cfg)
+    for _, transport in ipairs(TRANSPORTS) do
+        for _, io_path in ipairs(IO_PATHS) do
+            if enabled('handshake') or enabled('latency') then
+                local srv = start_server(cfg, transport, io_path)
+                if enabled('handshake') then
+                    bench_handshake(cfg, srv)
+                    if transport == 'inet' then
+                        bench_handshake_s_time(cfg, srv)
+                    end
+                end
+                if enabled('latency') then
+                    bench_latency(cfg, srv)
+                end
+                stop_server(srv)
+            end
+
+            if enabled('throughput') then
+                for _, suite in ipairs(CIPHERSUITES) do
+                    local srv = start_server(cfg, transport, io_path, suite,
+                                             cfg.bytes)
+                    for _, write_size in ipairs(WRITE_SIZES) do
+                        bench_throughput(cfg, srv, write_size)
+                    end
+                    stop_server(srv)
+                end
+            end
+        end
+    end
+    os.remove(cfg.cert)
+    os.remove(cfg.key)
+end
+
+if ... == 'server' then
+    serve(select(2, ...))
+else
+    main(...)
+end
@@ -23,6 +23,18 @@
 -- lua-net
 -- Created by Masatoshi Teruya on 15/11/15.
 --
+--- assign to local
+local concat = table.concat
+local format = string.format
+local insert = table.insert
+local sub = string.sub
+local is_uint = require('lauxhlib.is').uint
+local poll_wait_readable = require('gpoll').wait_readable
+local encode_frame = require('net.socket').encode_frame
+local FDCACHE = require('net.fdcache').default
+-- constants
+local DEFAULT_WBUF_SIZE = 65536
+
 --- @class net.stream.Socket : net.Socket
 local Socket = {}
 
@@ -89,14 +101,59 @@ function Socket:tcpkeepcnt(cnt)
     return self.sock:tcpkeepcnt(cnt)
 end
 
+--- sendcached
+--- sends a file opened through the open-fd cache of net.fdcache.
+--- @protected
+--- @param pathname string
+--- @param bytes integer?
+--- @param offset integer?
+--- @return integer? len
+--- @return any err
+--- @return boolean? timeout
+function Socket:sendcached(pathname, bytes, offset)
+    local fd, size = FDCACHE:open(pathname)
+    if not fd then
+        return nil, size
+    end
+
+    if offset == nil then
+        offset = 0
+    end
+    if bytes == nil then
+        -- send remaining content starting at offset
+        bytes = size - offset
+    end
+
+    local len, err, timeout = 0, nil, nil
+    if bytes > 0 then
+        len, err, timeout = self:sendfile(fd, bytes, offset)
+    end
+    FDCACHE:release(fd)
+    return len, err, timeout
+end
+
 --- sendfile
---- @param fd integer
---- @param bytes integer
+--- @param fd integer|string
+--- @param bytes integer?
 --- @param offset integer?
+--- @param header string?
+--- @param trailer string?
 --- @return integer? len
 --- @return any err
 --- @return boolean? timeout
-function Socket:sendfile(fd, bytes, offset)
+function Socket:sendfile(fd, bytes, offset, header, trailer)
+    if header ~= nil or trailer ~= nil then
+        return self:sendfiles({
+            {
+                fd,
+                bytes,
+                offset,
+            },
+        }, header, trailer)
+    elseif type(fd) == 'string' then
+        return self:sendcached(fd, bytes, offset)
+    end
+
     local sock, sendfile = self.sock, self.sock.sendfile
     local deadline = self:get_send_deadline()
     local sent = 0
@@ -135,16 +192,417 @@ function Socket:sendfile(fd, bytes, offset)
 end
 
 --- sendfilesync
---- @param fd integer
+--- @param fd integer|string
 --- @param bytes integer
 --- @param offset integer?
+--- @param header string?
+--- @param trailer string?
 --- @return integer? len
 --- @return any err
 --- @return boolean? timeout
-function Socket:sendfilesync(fd, bytes, offset)
-    return self:syncwrite(self.sendfile, fd, bytes, offset)
+function Socket:sendfilesync(fd, bytes, offset, header, trailer)
+    return self:syncwrite(self.sendfile, fd, bytes, offset, header, trailer)
+end
+
+--- sendpart
+--- @param self net.stream.Socket
+--- @param part string|table
+--- @return integer len
+--- @return any err
+--- @return boolean? timeout
+--- @return boolean? short
+local function sendpart(self, part)
+    if type(part) == 'string' then
+        if #part == 0 then
+            return 0
+        end
+        local len, err, timeout = self:write(part)
+        return len or 0, err, timeout
+    end
+
+    local bytes = part[2]
+    local len, err, timeout = self:sendfile(part[1], bytes, part[3])
+    len = len or 0
+    -- the file holds fewer bytes than requested
+    return len, err, timeout, bytes ~= nil and len < bytes
 end
 
+--- sendfiles
+--- @param ranges (string|table)[]
+--- @param header string?
+--- @param trailer string?
+--- @return integer len
+--- @return any err
+--- @return boolean? timeout
+function Socket:sendfiles(ranges, header, trailer)
+    if type(ranges) ~= 'table' then
+        error('ranges must be table', 2)
+    elseif header ~= nil and type(header) ~= 'string' then
+        error('header must be string', 2)
+    elseif trailer ~= nil and type(trailer) ~= 'string' then
+        error('trailer must be string', 2)
+    end
+    local parts = {
+        header or '',
+    }
+    for i, v in ipairs(ranges) do
+        if type(v) ~= 'string' and type(v) ~= 'table' then
+            error(format('ranges[%d] must be string or table', i), 2)
+        end
+        parts[i + 1] = v
+    end
+    parts[#parts + 1] = trailer or ''
+
+    -- hold the partial segments until the last part is written, so that the
+    -- header is not sent as its own small packet
+    local corked = not self.wbuf_corked and self:tcpcork(true) == false
+    local sent, err, timeout = 0, nil, nil
+    if (self.wbuf_len or 0) > 0 then
+        -- write the buffered data first
+        _, err, timeout = self:flush(true)
+    end
+
+    if not err and not timeout then
+        for _, part in ipairs(parts) do
+            local len, short
+            len, err, timeout, short = sendpart(self, part)
+            sent = sent + len
+            if err or timeout or short then
+                break
+            end
+        end
+    end
+
+    if corked then
+        self:tcpcork(false)
+    end
+    return sent, err, timeout
+end
+
+--- sendfilessync
+--- @param ranges (string|table)[]
+--- @param header string?
+--- @param trailer string?
+--- @return integer? len
+--- @return any err
+--- @return boolean? timeout
+function Socket:sendfilessync(ranges, header, trailer)
+    return self:syncwrite(self.sendfiles, ranges, header, trailer)
+end
+
+--- recvfile
+--- @param fd integer|file*
+--- @param bytes integer
+--- @param offset integer?
+--- @return integer? len
+--- @return any err
+--- @return boolean? timeout
+function Socket:recvfile(fd, bytes, offset)
+    local sock, recvfile = self.sock, self.sock.recvfile
+
+    if offset == nil then
+        offset = 0
+    end
+
+    local len, err, timeout, sec, deadl = recvfile(sock, fd, bytes, offset)
+    while sec do
+        -- wait until readable
+        local ok
+        ok, err, timeout = self:wait_readable(sec)
+        if not ok then
+            return len, err, timeout
+        end
+
+        local n
+        n, err, timeout, sec, deadl = recvfile(sock, fd, bytes - len,
+                                               offset + len, deadl)
+        len = len + n
+    end
+    return len, err, timeout
+end
+
+--- clienthello
+--- peek the TLS ClientHello without consuming it.
+--- @return table? hello
+--- @return any err
+--- @return boolean? timeout
+function Socket:clienthello()
+    local sock, clienthello = self.sock, self.sock.clienthello
+    local deadline = self:get_recv_deadline()
+    local hello, err, timeout, lowat
+
+    while true do
+        local again, need, ok
+        hello, err, again, need = clienthello(sock)
+        if not again then
+            break
+        end
+
+        local done, sec = deadline:is_done()
+        if done then
+            timeout = true
+            break
+        elseif need then
+            -- the bytes already received keep the socket readable, so raise
+            -- SO_RCVLOWAT until the rest of the ClientHello has arrived
+            if not lowat then
+                lowat, err = sock:rcvlowat()
+                if not lowat then
+                    break
+                end
+            end
+            ok, err = sock:rcvlowat(need)
+            if not ok then
+                break
+            end
+        end
+
+        -- wait until readable
+        ok, err, timeout = self:wait_readable(sec)
+        if not ok then
+            break
+        end
+    end
+
+    if lowat then
+        sock:rcvlowat(lowat)
+    end
+    return hello, err, timeout
+end
+
+--- bufread
+--- @param self net.stream.Socket
+--- @param fn function
+--- @param arg any
+--- @return string? str
+--- @return any err
+--- @return boolean? timeout
+local function bufread(self, fn, arg)
+    local sock = self.sock
+    local str, err, timeout, sec, deadl = fn(sock, arg)
+
+    while sec do
+        -- wait until readable
+        local ok
+        ok, err, timeout = self:wait_readable(sec)
+        if not ok then
+            return nil, err, timeout
+        end
+        str, err, timeout, sec, deadl = fn(sock, arg, deadl)
+    end
+    return str, err, timeout
+end
+
+--- readline
+--- @param keepeol boolean?
+--- @return string? line
+--- @return any err
+--- @return boolean? timeout
+function Socket:readline(keepeol)
+    return bufread(self, self.sock.readline, keepeol == true)
+end
+
+--- read_until
+--- @param delim string|string[]
+--- @return string? str
+--- @return any err
+--- @return boolean? timeout
+function Socket:read_until(delim)
+    return bufread(self, self.sock.readuntil, delim)
+end
+
+--- read_exact
+--- @param n integer
+--- @return string? str
+--- @return any err
+--- @return boolean? timeout
+function Socket:read_exact(n)
+    return bufread(self, self.sock.readexact, n)
+end
+
+--- peek
+--- @param n integer
+--- @return string? str
+--- @return any err
+--- @return boolean? timeout
+function Socket:peek(n)
+    return bufread(self, self.sock.peekbuf, n)
+end
+
+--- frameread
+--- @param self net.stream.Socket
+--- @param fn function
+--- @param fmt string?
+--- @param maxsize integer?
+--- @return string|string[]|nil frame
+--- @return any err
+--- @return boolean? timeout
+local function frameread(self, fn, fmt, maxsize)
+    local sock = self.sock
+    local v, err, timeout, sec, deadl = fn(sock, fmt, maxsize)
+
+    while sec do
+        -- wait until readable
+        local ok
+        ok, err, timeout = self:wait_readable(sec)
+        if not ok then
+            return nil, err, timeout
+        end
+        v, err, timeout, sec, deadl = fn(sock, fmt, maxsize, deadl)
+    end
+    return v, err, timeout
+end
+
+--- read_frame
+--- @param fmt string?
+--- @param maxsize integer?
+--- @return string? frame
+--- @return any err
+--- @return boolean? timeout
+function Socket:read_frame(fmt, maxsize)
+    return frameread(self, self.sock.readframe, fmt, maxsize)
+end
+
+--- read_frames
+--- @param fmt string?
+--- @param maxsize integer?
+--- @return string[]? frames
+--- @return any err
+--- @return boolean? timeout
+function Socket:read_frames(fmt, maxsize)
+    return frameread(self, self.sock.readframes, fmt, maxsize)
+end
+
+--- write_frame
+--- @param str string
+--- @param fmt string?
+--- @return integer len
+--- @return any err
+--- @return boolean? timeout
+function Socket:write_frame(str, fmt)
+    return self:write(encode_frame(fmt or 'u32be', str))
+end
+
+--- write_frames
+--- @param frames string[]
+--- @param fmt string?
+--- @return integer len
+--- @return any err
+--- @return boolean? timeout
+function Socket:write_frames(frames, fmt)
+    return self:write(encode_frame(fmt or 'u32be', frames))
+end
+
+--- rbufsize
+--- @param size integer?
+--- @return integer? size
+--- @return any err
+function Socket:rbufsize(size)
+    return self.sock:rbufsize(size)
+end
+
+--- buffered
+--- @return integer len
+function Socket:buffered()
+    return self.sock:buffered()
+end
+
+--- wbufsize
+--- @param size integer?
+--- @return integer size
+function Socket:wbufsize(size)
+    local old = self.wbuf_size or DEFAULT_WBUF_SIZE
+    if size ~= nil then
+        if not is_uint(size) or size == 0 then
+            error('size must be positive integer', 2)
+        end
+        self.wbuf_size = size
+    end
+    return old
+end
+
+--- bufwrite
+--- @param str string
+--- @return integer len
+--- @return any err
+--- @return boolean? timeout
+function Socket:bufwrite(str)
+    local wbuf = self.wbuf
+    if not wbuf then
+        wbuf = {}
+        self.wbuf = wbuf
+        self.wbuf_len = 0
+    end
+    wbuf[#wbuf + 1] = str
+    self.wbuf_len = self.wbuf_len + #str
+    if self.wbuf_len < (self.wbuf_size or DEFAULT_WBUF_SIZE) then
+        return #str
+    end
+
+    -- more data will follow, so cork the TCP socket to hold the last partial
+    -- segment until flush() is called
+    if not self.wbuf_corked and self.sock:tcpcork(true) == false then
+        self.wbuf_corked = true
+    end
+    local _, err, timeout = self:flush(true)
+    return #str, err, timeout
+end
+
+--- flush
+--- @param more boolean?
+--- @return integer len
+--- @return any err
+--- @return boolean? timeout
+function Socket:flush(more)
+    local wbuf = self.wbuf
+    local len, err, timeout = 0, nil, nil
+
+    if wbuf and #wbuf > 0 then
+        local str = #wbuf == 1 and wbuf[1] or concat(wbuf)
+        -- replace the buffer before writing, so that the data buffered while
+        -- waiting is written after this
+        self.wbuf = {}
+        self.wbuf_len = 0
+        self.wbuf_flushing = true
+        len, err, timeout = self:write(str)
+        self.wbuf_flushing = nil
+        if len < #str then
+            -- put back the rest in front of the data buffered meanwhile
+            insert(self.wbuf, 1, sub(str, len + 1))
+            self.wbuf_len = self.wbuf_len + #str - len
+            return len, err, timeout
+        end
+    end
+
+    if self.wbuf_corked and not more then
+        -- push the held segment
+        self.wbuf_corked = nil
+        self.sock:tcpcork(false)
+    end
+    return len, err, timeout
+end
+
+--- wait_readable
+--- writes the buffered data before waiting, since a peer that is expected to
+--- send the next request may be waiting for the response.
+--- @protected
+--- @param self net.stream.Socket
+--- @param sec number?
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+local function wait_readable(self, sec)
+    if ((self.wbuf_len or 0) > 0 or self.wbuf_corked) and
+        not self.wbuf_flushing then
+        local _, err, timeout = self:flush()
+        if err or timeout then
+            return false, err, timeout
+        end
+    end
+    return poll_wait_readable(self:fd(), sec)
+end
+Socket.wait_readable = wait_readable
+
 Socket = require('metamodule').new.Socket(Socket, 'net.Socket')
 
 --- @class net.stream.Server : net.stream.Socket
@@ -230,3 +688,9 @@ function Server:acceptfd()
 end
 
 require('metamodule').new.Server(Server, 'net.stream.Socket')
+
+return {
+    -- net.tls.stream.Socket uses it as well, since its net.tls.Socket base
+    -- brings wait_readable of net.Socket
+    wait_readable = wait_readable,
+}
@@ -29,14 +29,12 @@ local is_string = require('lauxhlib.is').str
 local is_table = require('lauxhlib.is').table
 local is_finite = require('lauxhlib.is').finite
 local poll_wait_writable = require('gpoll').wait_writable
-local tls_server = require('net.tls.server')
-local tls_client = require('net.tls.client')
-local tls_connect = require('net.tls.context').connect
 local socket = require('net.socket')
 local socket_wrap = socket.wrap
 local socket_connect_inet = socket.connect_inet
 local socket_bind_inet = socket.bind_inet
-local tls_stream_inet = require('net.tls.stream.inet')
+-- the TLS modules are required on first use, so that plain sockets do not
+-- load OpenSSL
 
 --- inet_stream_connect
 --- Non-blocking connect to (host, port) as an AF_INET / SOCK_STREAM socket.
@@ -143,22 +141,70 @@ local function new_client(host, port, opts)
             error('opts.servername must be string', 2)
         end
 
-        -- create tls client context
-        local ctx, err = tls_client(opts.tlscfg.protocol, opts.tlscfg.ciphers,
-                                    opts.tlscfg.alpn,
-                                    opts.tlscfg.session_cache_timeout,
-                                    opts.tlscfg.session_cache_size,
-                                    opts.tlscfg.ocsp_error_callback)
-        if err then
-            return nil, err
+        if opts.tlscfg.client ~= nil then
+            if type(opts.tlscfg.client) ~= 'userdata' then
+                error('opts.tlscfg.client must be net.tls.client', 2)
+            end
+            -- share the client context, its session cache and its pool
+            -- of SSL objects with the other connections
+            tls = opts.tlscfg.client
+        else
+            -- create tls client context
+            local tls_client = require('net.tls.client')
+            local ctx, err = tls_client(opts.tlscfg.protocol,
+                                        opts.tlscfg.ciphers, opts.tlscfg.alpn,
+                                        opts.tlscfg.session_cache_timeout,
+                                        opts.tlscfg.session_cache_size,
+                                        opts.tlscfg.ocsp_error_callback)
+            if err then
+                return nil, err
+            elseif opts.tlscfg.cafile or opts.tlscfg.capath then
+                -- parsed CA certificates are shared between clients
+                local ok
+                ok, err = ctx:load_verify_locations(opts.tlscfg.cafile,
+                                                    opts.tlscfg.capath)
+                if not ok then
+                    return nil, err
+                end
+            end
+            if opts.tlscfg.groups then
+                local ok
+                ok, err = ctx:set_groups(opts.tlscfg.groups)
+                if not ok then
+                    return nil, err
+                end
+            end
+            if opts.tlscfg.sigalgs then
+                local ok
+                ok, err = ctx:set_sigalgs(opts.tlscfg.sigalgs)
+                if not ok then
+                    return nil, err
+                end
+            end
+            if opts.tlscfg.ciphersuites then
+                local ok
+                ok, err = ctx:set_ciphersuites(opts.tlscfg.ciphersuites)
+                if not ok then
+                    return nil, err
+                end
+            end
+            if opts.tlscfg.offload_handshake then
+                -- run the handshakes on the worker threads
+                ctx:set_handshake_offload(true)
+            end
+            if opts.tlscfg.shutdown_mode then
+                -- how the connections are closed
+                ctx:set_shutdown_mode(opts.tlscfg.shutdown_mode)
+            end
+            tls = ctx
         end
-        tls = ctx
     end
 
     local sock, err, timeout, ai =
         inet_stream_connect(host, port, opts.deadline)
     if sock then
         if tls then
+            local tls_connect = require('net.tls.context').connect
             local ctx
             ctx, err = tls_connect(tls, sock:fd(), opts.servername,
                                    opts.tlscfg.noverify_name,
@@ -169,6 +215,7 @@ local function new_client(host, port, opts)
                 sock:close()
                 return nil, err
             end
+            local tls_stream_inet = require('net.tls.stream.inet')
             return tls_stream_inet.Client(sock, ctx), nil, nil, ai
         end
         return Client(sock), nil, nil, ai
@@ -199,6 +246,7 @@ local function new_server(host, port, opts)
         error('opts.tlscfg must be table', 2)
     elseif opts.tlscfg then
         -- create tls server context
+        local tls_server = require('net.tls.server')
         local ctx, err = tls_server(opts.tlscfg.cert, opts.tlscfg.key,
                                     opts.tlscfg.protocol, opts.tlscfg.ciphers,
                                     opts.tlscfg.alpn,
@@ -208,6 +256,51 @@ local function new_server(host, port, opts)
         if err then
             return nil, err
         end
+        -- additional certificates of other key types (e.g. ECDSA and RSA)
+        for _, v in ipairs(opts.tlscfg.certs or {}) do
+            local ok
+            ok, err = ctx:add_certificate(v.cert, v.key)
+            if not ok then
+                return nil, err
+            end
+        end
+        if opts.tlscfg.groups then
+            local ok
+            ok, err = ctx:set_groups(opts.tlscfg.groups)
+            if not ok then
+                return nil, err
+            end
+        end
+        if opts.tlscfg.sigalgs then
+            local ok
+            ok, err = ctx:set_sigalgs(opts.tlscfg.sigalgs)
+            if not ok then
+                return nil, err
+            end
+        end
+        if opts.tlscfg.ciphersuites then
+            local ok
+            ok, err = ctx:set_ciphersuites(opts.tlscfg.ciphersuites)
+            if not ok then
+                return nil, err
+            end
+        end
+        if opts.tlscfg.offload_handshake then
+            -- run the handshakes on the worker threads
+            ctx:set_handshake_offload(true)
+        end
+        if opts.tlscfg.shutdown_mode then
+            -- how the connections are closed
+            ctx:set_shutdown_mode(opts.tlscfg.shutdown_mode)
+        end
+        if opts.tlscfg.ssl_pool_size then
+            -- reuse the SSL objects of closed connections
+            local ok
+            ok, err = ctx:set_ssl_pool_size(opts.tlscfg.ssl_pool_size)
+            if not ok then
+                return nil, err
+            end
+        end
         tls = ctx
     end
 
@@ -215,6 +308,7 @@ local function new_server(host, port, opts)
                                            opts.reuseport)
     if sock then
         if tls then
+            local tls_stream_inet = require('net.tls.stream.inet')
             return tls_stream_inet.Server(sock, tls, opts.tlscfg.use_bio), nil,
                    ai
         end
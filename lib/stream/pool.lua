@@ -0,0 +1,238 @@
+--
+-- Copyright (C) 2026 Masatoshi Fukunaga
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+-- lib/stream/pool.lua
+-- lua-net
+--
+--- assign to local
+local remove = table.remove
+local is_table = require('lauxhlib.is').table
+local is_uint = require('lauxhlib.is').uint
+local is_finite = require('lauxhlib.is').finite
+local new_deadline = require('time.clock.deadline').new
+local new_client = require('net.stream.inet').client.new
+
+--- is_alive
+--- An idle connection must have nothing to read; a readable connection has
+--- been closed or reset by the peer, or has received unsolicited data.  TLS
+--- 1.3 servers may still send post-handshake messages (e.g. session tickets),
+--- so a TLS connection is alive if those are all it has received.
+--- @param conn net.stream.inet.Client|net.tls.stream.inet.Client
+--- @return boolean ok
+local function is_alive(conn)
+    local data, _, again = conn.sock:recv(1, 'peek', 'dontwait')
+    if again then
+        return true
+    elseif not data or not conn.tls then
+        return false
+    end
+
+    if conn.tls_bio then
+        local n, _, fillagain = conn.tls_bio:fill()
+        if not n and not fillagain then
+            return false
+        end
+    end
+    local _, _, want = conn.tls:read()
+    return want ~= nil
+end
+
+--- is_usable
+--- @param item table idle item
+--- @return boolean ok
+local function is_usable(item)
+    return (not item.expiry or not item.expiry:is_done()) and
+               is_alive(item.conn)
+end
+
+--- @class net.stream.pool.Pool
+--- @field host string?
+--- @field port string|integer
+--- @field opts table<string, any>
+--- @field size integer
+--- @field max_idle number?
+--- @field idle table[]
+local Pool = {}
+
+--- init
+--- @param host string?
+--- @param port string|integer
+--- @param opts table<string, any>?
+--- @param size integer?
+--- @param max_idle number?
+--- @return net.stream.pool.Pool
+function Pool:init(host, port, opts, size, max_idle)
+    self.host = host
+    self.port = port
+    self.opts = opts or {}
+    self.size = size or 1
+    self.max_idle = max_idle
+    self.idle = {}
+    return self
+end
+
+--- connect
+--- Opens a new connection and completes the TLS handshake if the pool is
+--- configured for TLS.
+--- @return net.stream.inet.Client|net.tls.stream.inet.Client? conn
+--- @return any err
+--- @return boolean? timeout
+function Pool:connect()
+    local conn, err, timeout = new_client(self.host, self.port, self.opts)
+    if not conn then
+        return nil, err, timeout
+    elseif conn.tls then
+        local ok
+        ok, err, timeout = conn:handshake()
+        if not ok then
+            conn:close()
+            return nil, err, timeout
+        end
+    end
+    return conn
+end
+
+--- prune
+--- Closes the idle connections that have expired or are no longer alive.
+--- @return integer n number of connections closed
+function Pool:prune()
+    local idle = self.idle
+    local n = 0
+
+    for i = #idle, 1, -1 do
+        local item = idle[i]
+        if not is_usable(item) then
+            remove(idle, i)
+            item.conn:close()
+            n = n + 1
+        end
+    end
+    return n
+end
+
+--- refill
+--- Prunes the idle connections, then connects until the pool holds `size`
+--- idle connections.  Call it from a coroutine of its own (e.g. on a timer)
+--- to keep the pool warm without delaying the requests.
+--- @return integer n number of connections added
+--- @return any err
+--- @return boolean? timeout
+function Pool:refill()
+    local idle = self.idle
+    local n = 0
+
+    self:prune()
+    while #idle < self.size do
+        local conn, err, timeout = self:connect()
+        if not conn then
+            return n, err, timeout
+        end
+        idle[#idle + 1] = {
+            conn = conn,
+            expiry = self.max_idle and new_deadline(self.max_idle),
+        }
+        n = n + 1
+    end
+    return n
+end
+
+--- get
+--- Returns the most recently used idle connection that is still alive, or a
+--- new connection if there is none.
+--- @return net.stream.inet.Client|net.tls.stream.inet.Client? conn
+--- @return any err
+--- @return boolean? timeout
+function Pool:get()
+    local idle = self.idle
+
+    while #idle > 0 do
+        local item = remove(idle)
+        if is_usable(item) then
+            return item.conn
+        end
+        item.conn:close()
+    end
+    return self:connect()
+end
+
+--- put
+--- Returns the connection to the pool.  The connection is closed instead if
+--- the pool is full or the connection is no longer alive.
+--- @param conn net.stream.inet.Client|net.tls.stream.inet.Client
+--- @return boolean ok true if the connection was pooled
+function Pool:put(conn)
+    local idle = self.idle
+
+    if #idle >= self.size or not is_alive(conn) then
+        conn:close()
+        return false
+    end
+    idle[#idle + 1] = {
+        conn = conn,
+        expiry = self.max_idle and new_deadline(self.max_idle),
+    }
+    return true
+end
+
+--- len
+--- @return integer n number of idle connections
+function Pool:len()
+    return #self.idle
+end
+
+--- close
+--- Closes all idle connections.
+function Pool:close()
+    local idle = self.idle
+
+    self.idle = {}
+    for i = 1, #idle do
+        idle[i].conn:close()
+    end
+end
+
+Pool = require('metamodule').new.Pool(Pool)
+
+--- new
+--- @param host string?
+--- @param port string|integer
+--- @param opts table<string, any>? options of net.stream.inet.client.new
+--- @param cfg table<string, any>?
+--- @return net.stream.pool.Pool pool
+local function new(host, port, opts, cfg)
+    if opts ~= nil and not is_table(opts) then
+        error('opts must be table', 2)
+    elseif cfg == nil then
+        cfg = {}
+    elseif not is_table(cfg) then
+        error('cfg must be table', 2)
+    elseif cfg.size ~= nil and not is_uint(cfg.size) then
+        error('cfg.size must be unsigned integer', 2)
+    elseif cfg.max_idle ~= nil and
+        (not is_finite(cfg.max_idle) or cfg.max_idle <= 0) then
+        error('cfg.max_idle must be positive finite number', 2)
+    end
+    return Pool(host, port, opts, cfg.size, cfg.max_idle)
+end
+
+return {
+    new = new,
+}
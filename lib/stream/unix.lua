@@ -28,15 +28,13 @@ local is_string = require('lauxhlib.is').str
 local is_table = require('lauxhlib.is').table
 local is_finite = require('lauxhlib.is').finite
 local poll_wait_writable = require('gpoll').wait_writable
-local tls_server = require('net.tls.server')
-local tls_client = require('net.tls.client')
-local tls_connect = require('net.tls.context').connect
 local socket = require('net.socket')
 local socket_connect_unix = socket.connect_unix
 local socket_bind_unix = socket.bind_unix
 local socket_wrap = socket.wrap
 local socket_pair = socket.pair
-local tls_stream_unix = require('net.tls.stream.unix')
+-- the TLS modules are required on first use, so that plain sockets do not
+-- load OpenSSL
 
 --- unix_stream_connect
 --- Non-blocking connect to `pathname` as an AF_UNIX / SOCK_STREAM socket.
@@ -128,21 +126,69 @@ local function new_client(pathname, opts)
     elseif opts.tlscfg ~= nil and not is_table(opts.tlscfg) then
         error('opts.tlscfg must be table', 2)
     elseif opts.tlscfg then
-        -- create tls client context
-        local ctx, err = tls_client(opts.tlscfg.protocol, opts.tlscfg.ciphers,
-                                    opts.tlscfg.alpn,
-                                    opts.tlscfg.session_cache_timeout,
-                                    opts.tlscfg.session_cache_size,
-                                    opts.tlscfg.ocsp_error_callback)
-        if err then
-            return nil, err
+        if opts.tlscfg.client ~= nil then
+            if type(opts.tlscfg.client) ~= 'userdata' then
+                error('opts.tlscfg.client must be net.tls.client', 2)
+            end
+            -- share the client context, its session cache and its pool
+            -- of SSL objects with the other connections
+            tls = opts.tlscfg.client
+        else
+            -- create tls client context
+            local tls_client = require('net.tls.client')
+            local ctx, err = tls_client(opts.tlscfg.protocol,
+                                        opts.tlscfg.ciphers, opts.tlscfg.alpn,
+                                        opts.tlscfg.session_cache_timeout,
+                                        opts.tlscfg.session_cache_size,
+                                        opts.tlscfg.ocsp_error_callback)
+            if err then
+                return nil, err
+            elseif opts.tlscfg.cafile or opts.tlscfg.capath then
+                -- parsed CA certificates are shared between clients
+                local ok
+                ok, err = ctx:load_verify_locations(opts.tlscfg.cafile,
+                                                    opts.tlscfg.capath)
+                if not ok then
+                    return nil, err
+                end
+            end
+            if opts.tlscfg.groups then
+                local ok
+                ok, err = ctx:set_groups(opts.tlscfg.groups)
+                if not ok then
+                    return nil, err
+                end
+            end
+            if opts.tlscfg.sigalgs then
+                local ok
+                ok, err = ctx:set_sigalgs(opts.tlscfg.sigalgs)
+                if not ok then
+                    return nil, err
+                end
+            end
+            if opts.tlscfg.ciphersuites then
+                local ok
+                ok, err = ctx:set_ciphersuites(opts.tlscfg.ciphersuites)
+                if not ok then
+                    return nil, err
+                end
+            end
+            if opts.tlscfg.offload_handshake then
+                -- run the handshakes on the worker threads
+                ctx:set_handshake_offload(true)
+            end
+            if opts.tlscfg.shutdown_mode then
+                -- how the connections are closed
+                ctx:set_shutdown_mode(opts.tlscfg.shutdown_mode)
+            end
+            tls = ctx
         end
-        tls = ctx
     end
 
     local sock, err, timeout, ai = unix_stream_connect(pathname, opts.deadline)
     if sock then
         if tls then
+            local tls_connect = require('net.tls.context').connect
             local ctx
             ctx, err = tls_connect(tls, sock:fd(), opts.servername,
                                    opts.tlscfg.noverify_name,
@@ -153,6 +199,7 @@ local function new_client(pathname, opts)
                 sock:close()
                 return nil, err
             end
+            local tls_stream_unix = require('net.tls.stream.unix')
             return tls_stream_unix.Client(sock, ctx), nil, nil, ai
         end
         return Client(sock), nil, nil, ai
@@ -176,6 +223,7 @@ local function new_server(pathname, tlscfg)
         error('tlscfg must be table', 2)
     elseif tlscfg then
         -- create tls server context
+        local tls_server = require('net.tls.server')
         local ctx, err = tls_server(tlscfg.cert, tlscfg.key, tlscfg.protocol,
                                     tlscfg.ciphers, tlscfg.alpn,
                                     tlscfg.session_timeout,
@@ -184,12 +232,58 @@ local function new_server(pathname, tlscfg)
         if err then
             return nil, err
         end
+        -- additional certificates of other key types (e.g. ECDSA and RSA)
+        for _, v in ipairs(tlscfg.certs or {}) do
+            local ok
+            ok, err = ctx:add_certificate(v.cert, v.key)
+            if not ok then
+                return nil, err
+            end
+        end
+        if tlscfg.groups then
+            local ok
+            ok, err = ctx:set_groups(tlscfg.groups)
+            if not ok then
+                return nil, err
+            end
+        end
+        if tlscfg.sigalgs then
+            local ok
+            ok, err = ctx:set_sigalgs(tlscfg.sigalgs)
+            if not ok then
+                return nil, err
+            end
+        end
+        if tlscfg.ciphersuites then
+            local ok
+            ok, err = ctx:set_ciphersuites(tlscfg.ciphersuites)
+            if not ok then
+                return nil, err
+            end
+        end
+        if tlscfg.offload_handshake then
+            -- run the handshakes on the worker threads
+            ctx:set_handshake_offload(true)
+        end
+        if tlscfg.shutdown_mode then
+            -- how the connections are closed
+            ctx:set_shutdown_mode(tlscfg.shutdown_mode)
+        end
+        if tlscfg.ssl_pool_size then
+            -- reuse the SSL objects of closed connections
+            local ok
+            ok, err = ctx:set_ssl_pool_size(tlscfg.ssl_pool_size)
+            if not ok then
+                return nil, err
+            end
+        end
         tls = ctx
     end
 
     local sock, err, ai = unix_stream_bind(pathname)
     if sock then
         if tls then
+            local tls_stream_unix = require('net.tls.stream.unix')
             return tls_stream_unix.Server(sock, tls, tlscfg.use_bio), nil, ai
         end
         return Server(sock), nil, ai
@@ -24,9 +24,11 @@ local format = string.format
 local tostring = tostring
 local new_errno = require('errno').new
 local new_deadline = require('time.clock.deadline').new
+local poll_wait_readable = require('gpoll').wait_readable
 --- constants
 local WANT_POLLIN = require('net.tls.context').WANT_READ
 local WANT_POLLOUT = require('net.tls.context').WANT_WRITE
+local WANT_ASYNC = require('net.tls.context').WANT_ASYNC
 
 --- @class net.tls.Socket : net.Socket
 local Socket = {}
@@ -171,6 +173,14 @@ local function poll_wait(self, want, deadline)
             return false, nil, true
         end
         return self:wait_writable(sec)
+    elseif want == WANT_ASYNC then
+        -- the handshake is running on a worker thread; its async fd becomes
+        -- readable when the step has finished
+        local done, sec = deadline:is_done()
+        if done then
+            return false, nil, true
+        end
+        return poll_wait_readable(self.tls:get_async_fd(), sec)
     end
 
     return false,
@@ -192,7 +202,7 @@ function Socket:poll_wait(want, sec)
         deadline = new_deadline(sec)
     elseif want == WANT_POLLIN then
         deadline = self:get_recv_deadline()
-    elseif want == WANT_POLLOUT then
+    elseif want == WANT_POLLOUT or want == WANT_ASYNC then
         deadline = self:get_send_deadline()
     end
     return poll_wait(self, want, deadline)
@@ -238,6 +248,11 @@ function Socket:tls_shutdown()
             -- if use BIO, the custom TX BIO may still hold the final
             -- close_notify ciphertext; drain it to the socket.  draining an
             -- empty buffer is a no-op.
+            if self.tls_bio and tls:get_shutdown_mode() ~= 'full' then
+                -- fast close: write what the socket accepts without waiting
+                self.tls_bio:drain()
+                return true
+            end
             ok, err, timeout = bio_drain(self, deadline)
             if not ok then
                 return false, err, timeout
@@ -253,6 +268,16 @@ function Socket:tls_shutdown()
     end
 end
 
+--- set_shutdown_mode
+--- Set how tls_shutdown() closes the TLS connection:
+---  'full': exchange close_notify with the peer (default)
+---  'fast': send close_notify without waiting for the peer's one
+---  'quiet': send nothing; the session stays resumable
+--- @param mode string
+function Socket:set_shutdown_mode(mode)
+    self.tls:set_shutdown_mode(mode)
+end
+
 --- tls_close
 --- @return boolean ok
 --- @return any err
@@ -504,5 +529,23 @@ function Socket:writev()
     return nil, new_errno('EOPNOTSUPP')
 end
 
+--- enqueue
+--- @return boolean? paused
+--- @return any err
+function Socket:enqueue()
+    -- currently, does not support the outbound queue on tls connection
+    -- EOPNOTSUPP: Operation not supported on socket
+    return nil, new_errno('EOPNOTSUPP')
+end
+
+--- drain
+--- @return boolean ok
+--- @return any err
+function Socket:drain()
+    -- currently, does not support the outbound queue on tls connection
+    -- EOPNOTSUPP: Operation not supported on socket
+    return false, new_errno('EOPNOTSUPP')
+end
+
 require('metamodule').new.Socket(Socket, 'net.Socket')
 
@@ -32,6 +32,7 @@ local fstat = require('fstat')
 local is_uint = require('lauxhlib.is').uint
 local new_errno = require('errno').new
 local errorf = require('error').format
+local FDCACHE = require('net.fdcache').default
 -- constants
 local DEFAULT_SEND_BUFSIZ = 4096 * 4 -- 16KB
 
@@ -49,14 +50,95 @@ local function tofile(f)
     return fopen(f)
 end
 
+--- cachepread
+--- @param fd integer
+--- @param count integer
+--- @param offset integer
+--- @return string? s
+--- @return any err
+local function cachepread(fd, count, offset)
+    return FDCACHE:pread(fd, count, offset)
+end
+
+--- sendpread
+--- sends the bytes of a file that are read by the pread function.
+--- @param self net.tls.stream.Socket
+--- @param readfn function
+--- @param file any
+--- @param bytes integer
+--- @param offset integer
+--- @return integer? len
+--- @return any err
+--- @return boolean? timeout
+local function sendpread(self, readfn, file, bytes, offset)
+    local bufsiz, err = self:sndbuf()
+    if err then
+        return nil, err
+    elseif bufsiz > DEFAULT_SEND_BUFSIZ then
+        -- prevent to allocate a large buffer size
+        bufsiz = DEFAULT_SEND_BUFSIZ
+    end
+
+    local remain = bytes
+    local sent = 0
+    local data = ''
+    repeat
+        if remain > 0 then
+            local nread = remain < bufsiz and remain or bufsiz
+            local s
+            s, err = readfn(file, nread, offset + sent)
+            if not s then
+                return sent, err
+            elseif #s == 0 then
+                -- reached end-of-file before satisfying the requested byte
+                -- count; return what has been sent rather than spinning on
+                -- a pread that keeps returning the empty string.
+                return sent
+            end
+            data = data .. s
+        end
+
+        -- send a content
+        local len, serr, timeout = self:send(data)
+        -- Go style: send always reports a numeric sent count.
+        sent = sent + len
+
+        if serr then
+            return sent, serr
+        elseif timeout then
+            return sent, nil, timeout
+        end
+
+        -- update a remain bytes
+        data = sub(data, len + 1)
+        remain = remain - len
+    until remain == 0 and #data == 0
+
+    return sent
+end
+
 --- sendfile
 --- @param f file*|integer|string
 --- @param bytes integer?
 --- @param offset? integer
+--- @param header string?
+--- @param trailer string?
 --- @return integer? len
 --- @return any err
 --- @return boolean? timeout
-function Socket:sendfile(f, bytes, offset)
+function Socket:sendfile(f, bytes, offset, header, trailer)
+    if header ~= nil or trailer ~= nil then
+        return self:sendfiles({
+            {
+                f,
+                bytes,
+                offset,
+            },
+        }, header, trailer)
+    elseif type(f) == 'string' then
+        return self:sendcached(f, bytes, offset)
+    end
+
     local file, err = tofile(f)
     if not file then
         return nil, errorf('failed to tofile()', err)
@@ -90,51 +172,111 @@ function Socket:sendfile(f, bytes, offset)
         return 0
     end
 
-    local bufsiz
-    bufsiz, err = self:sndbuf()
-    if err then
-        return nil, err
-    elseif bufsiz > DEFAULT_SEND_BUFSIZ then
-        -- prevent to allocate a large buffer size
-        bufsiz = DEFAULT_SEND_BUFSIZ
+    return sendpread(self, pread, file, bytes, offset)
+end
+
+--- sendcached
+--- reads the file opened through the open-fd cache of net.fdcache directly
+--- from the cached descriptor, instead of wrapping it in a file handle.
+--- @protected
+--- @param pathname string
+--- @param bytes integer?
+--- @param offset integer?
+--- @return integer? len
+--- @return any err
+--- @return boolean? timeout
+function Socket:sendcached(pathname, bytes, offset)
+    if offset == nil then
+        offset = 0
+    elseif not is_uint(offset) then
+        return nil, new_errno('EINVAL', 'offset must be an nil or uint')
+    end
+    if bytes ~= nil and not is_uint(bytes) then
+        return nil, new_errno('EINVAL', 'bytes must be an nil or uint')
     end
 
-    local remain = bytes
-    local sent = 0
-    local data = ''
-    repeat
-        if remain > 0 then
-            local nread = remain < bufsiz and remain or bufsiz
-            local s
-            s, err = pread(file, nread, offset + sent)
-            if not s then
-                return sent, err
-            elseif #s == 0 then
-                -- reached end-of-file before satisfying the requested byte
-                -- count; return what has been sent rather than spinning on
-                -- a pread that keeps returning the empty string.
-                return sent
-            end
-            data = data .. s
-        end
+    local fd, size = FDCACHE:open(pathname)
+    if not fd then
+        return nil, size
+    elseif bytes == nil then
+        -- send remaining content starting at offset
+        bytes = size - offset
+    end
 
-        -- send a content
-        local len, serr, timeout = self:send(data)
-        -- Go style: send always reports a numeric sent count.
-        sent = sent + len
+    local len, err, timeout = 0, nil, nil
+    if bytes > 0 then
+        len, err, timeout = sendpread(self, cachepread, fd, bytes, offset)
+    end
+    FDCACHE:release(fd)
+    return len, err, timeout
+end
 
-        if serr then
-            return sent, serr
-        elseif timeout then
-            return sent, nil, timeout
-        end
+--- wait_readable
+--- same as net.stream.Socket; net.tls.Socket would bring that of net.Socket.
+--- @protected
+Socket.wait_readable = require('net.stream').wait_readable
 
-        -- update a remain bytes
-        data = sub(data, len + 1)
-        remain = remain - len
-    until remain == 0 and #data == 0
+--- readline
+--- @return string? line
+--- @return any err
+function Socket:readline()
+    -- currently, does not support buffered reads on tls connection
+    -- EOPNOTSUPP: Operation not supported on socket
+    return nil, new_errno('EOPNOTSUPP')
+end
 
-    return sent
+--- read_until
+--- @return string? str
+--- @return any err
+function Socket:read_until()
+    -- currently, does not support buffered reads on tls connection
+    -- EOPNOTSUPP: Operation not supported on socket
+    return nil, new_errno('EOPNOTSUPP')
+end
+
+--- read_exact
+--- @return string? str
+--- @return any err
+function Socket:read_exact()
+    -- currently, does not support buffered reads on tls connection
+    -- EOPNOTSUPP: Operation not supported on socket
+    return nil, new_errno('EOPNOTSUPP')
+end
+
+--- read_frame
+--- @return string? frame
+--- @return any err
+function Socket:read_frame()
+    -- currently, does not support buffered reads on tls connection
+    -- EOPNOTSUPP: Operation not supported on socket
+    return nil, new_errno('EOPNOTSUPP')
+end
+
+--- read_frames
+--- @return string[]? frames
+--- @return any err
+function Socket:read_frames()
+    -- currently, does not support buffered reads on tls connection
+    -- EOPNOTSUPP: Operation not supported on socket
+    return nil, new_errno('EOPNOTSUPP')
+end
+
+--- recvfile
+--- @return integer? len
+--- @return any err
+function Socket:recvfile()
+    -- currently, does not support recvfile on tls connection
+    -- EOPNOTSUPP: Operation not supported on socket
+    return nil, new_errno('EOPNOTSUPP')
+end
+
+--- peek
+--- @return string? str
+--- @return any err
+function Socket:peek()
+    -- currently, does not support buffered reads on tls connection
+    -- EOPNOTSUPP: Operation not supported on socket
+    return nil, new_errno('EOPNOTSUPP')
 end
 
 require('metamodule').new.Socket(Socket, 'net.stream.Socket', 'net.tls.Socket')
@@ -158,6 +300,47 @@ function Server:close()
     return self.sock:close()
 end
 
+--- set_certificate
+--- @param cert string
+--- @param key string
+--- @return boolean ok
+--- @return any err
+function Server:set_certificate(cert, key)
+    return self.tls:set_certificate(cert, key)
+end
+
+--- add_certificate
+--- @param cert string
+--- @param key string
+--- @return boolean ok
+--- @return any err
+function Server:add_certificate(cert, key)
+    return self.tls:add_certificate(cert, key)
+end
+
+--- set_ocsp_response
+--- @param der string
+--- @return boolean ok
+--- @return any err
+function Server:set_ocsp_response(der)
+    return self.tls:set_ocsp_response(der)
+end
+
+--- set_ocsp_callback
+--- @param callback fun(..., cert: string): string?
+--- @param ... any
+--- @return boolean ok
+--- @return any err
+function Server:set_ocsp_callback(callback, ...)
+    return self.tls:set_ocsp_callback(callback, ...)
+end
+
+--- refresh_ocsp
+--- @return integer n
+function Server:refresh_ocsp()
+    return self.tls:refresh_ocsp()
+end
+
 --- set_sni_callback
 --- @param callback fun(..., hostname: string): net.tls.server
 --- @param ... any
@@ -165,6 +348,38 @@ function Server:set_sni_callback(callback, ...)
     self.tls:set_sni_callback(callback, ...)
 end
 
+--- add_sni_cert
+--- @param hostname string
+--- @param cert string
+--- @param key string
+--- @return boolean ok
+--- @return any err
+function Server:add_sni_cert(hostname, cert, key)
+    return self.tls:add_sni_cert(hostname, cert, key)
+end
+
+--- remove_sni_cert
+--- @param hostname string
+--- @return boolean ok
+function Server:remove_sni_cert(hostname)
+    return self.tls:remove_sni_cert(hostname)
+end
+
+--- set_sni_cache_limits
+--- @param max_contexts? integer
+--- @param max_bytes? integer
+--- @return boolean ok
+--- @return any err
+function Server:set_sni_cache_limits(max_contexts, max_bytes)
+    return self.tls:set_sni_cache_limits(max_contexts, max_bytes)
+end
+
+--- get_sni_cache_stats
+--- @return table stats
+function Server:get_sni_cache_stats()
+    return self.tls:get_sni_cache_stats()
+end
+
 require('metamodule').new.Server(Server, 'net.stream.Server',
                                  'net.tls.stream.Socket')
 
@@ -25,7 +25,9 @@
 --
 --- assign to local
 local type = type
+local floor = math.floor
 local is_finite = require('lauxhlib.is').finite
+local is_uint = require('lauxhlib.is').uint
 local xpcall = require('xpcall')
 local traceback = debug.traceback
 local poll = require('gpoll')
@@ -49,6 +51,9 @@ local new_deadline = require('time.clock.deadline').new
 
 -- default max timeout for 60 minutes, which is the maximum timeout of poll_wait_* functions
 local DEFAULT_MAX_TIMEOUT = 60 * 60
+-- default high and low watermarks of the outbound queue
+local DEFAULT_QUEUE_HIGH = 65536
+local DEFAULT_QUEUE_LOW = 16384
 
 --- @class net.Socket
 --- @field sock socket
@@ -413,27 +418,19 @@ end
 --- @return any err
 --- @return boolean? timeout
 function Socket:read(bufsize)
-    local sock, read = self.sock, self.sock.read
-    local deadline = self:get_recv_deadline()
-
-    while true do
-        local str, err, again = read(sock, bufsize)
-
-        if not again then
-            return str, err, again
-        end
-
-        local done, sec = deadline:is_done()
-        if done then
-            return nil, nil, true
-        end
+    local sock, read = self.sock, self.sock.timedread
+    local str, err, timeout, sec, deadl = read(sock, bufsize)
 
+    while sec do
         -- wait until readable
-        local ok, perr, timeout = self:wait_readable(sec)
+        local ok
+        ok, err, timeout = self:wait_readable(sec)
         if not ok then
-            return nil, perr, timeout
+            return nil, err, timeout
         end
+        str, err, timeout, sec, deadl = read(sock, bufsize, deadl)
     end
+    return str, err, timeout
 end
 
 --- readsync
@@ -452,27 +449,19 @@ end
 --- @return any err
 --- @return boolean? timeout
 function Socket:recv(bufsize, ...)
-    local sock, recv = self.sock, self.sock.recv
-    local deadline = self:get_recv_deadline()
-
-    while true do
-        local str, err, again = recv(sock, bufsize, ...)
-
-        if not again then
-            return str, err, again
-        end
-
-        local done, sec = deadline:is_done()
-        if done then
-            return nil, nil, true
-        end
+    local sock, recv = self.sock, self.sock.timedrecv
+    local str, err, timeout, sec, deadl = recv(sock, bufsize, nil, ...)
 
+    while sec do
         -- wait until readable
-        local ok, perr, timeout = self:wait_readable(sec)
+        local ok
+        ok, err, timeout = self:wait_readable(sec)
         if not ok then
-            return nil, perr, timeout
+            return nil, err, timeout
         end
+        str, err, timeout, sec, deadl = recv(sock, bufsize, deadl, ...)
     end
+    return str, err, timeout
 end
 
 --- recvsync
@@ -536,7 +525,7 @@ end
 --- @return boolean? timeout
 function Socket:readv(iov, offset, nbyte)
     local sock, readv = self.sock, iov.readv
-    local deadline = self:get_recv_deadline()
+    local deadl
 
     if offset == nil then
         offset = 0
@@ -549,8 +538,9 @@ function Socket:readv(iov, offset, nbyte)
             return len, err, again
         end
 
-        local done, sec = deadline:is_done()
-        if done then
+        local sec
+        sec, deadl = sock:deadline(false, deadl)
+        if not sec then
             return nil, nil, true
         end
 
@@ -573,12 +563,28 @@ function Socket:readvsync(iov, offset, nbyte)
     return self:syncread(self.readv, iov, offset, nbyte)
 end
 
+--- write_release
+--- @param fd integer
+--- @param ok boolean
+--- @param len any
+--- @param ... any
+--- @return integer? len
+--- @return any ...
+local function write_release(fd, ok, len, ...)
+    write_unlock(fd)
+    if not ok then
+        return nil, len
+    end
+    return len, ...
+end
+
 --- syncwrite
 --- @param fn function
 --- @param ... any arguments
 --- @return integer? len
 --- @return any err
 --- @return boolean? timeout
+--- @return any ...
 function Socket:syncwrite(fn, ...)
     -- wait until another coroutine releases the right to write
     local fd = self.sock:fd()
@@ -587,13 +593,7 @@ function Socket:syncwrite(fn, ...)
     if ok then
         -- unlock even if fn raises an error, otherwise the fd is locked
         -- forever and subsequent synchronized writes wait indefinitely
-        local len
-        ok, len, err, timeout = xpcall(fn, traceback, self, ...)
-        write_unlock(fd)
-        if not ok then
-            return nil, len
-        end
-        return len, err, timeout
+        return write_release(fd, xpcall(fn, traceback, self, ...))
     end
 
     -- 0 is truthy in Lua; returning it with an error would let callers
@@ -607,36 +607,19 @@ end
 --- @return any err
 --- @return boolean? timeout
 function Socket:write(str)
-    local sock, write = self.sock, self.sock.write
-    local deadline = self:get_send_deadline()
-    local sent = 0
-
-    while true do
-        local len, err, again = write(sock, str)
-
-        if not len then
-            return sent, err
-        end
-        -- update a bytes sent
-        sent = sent + len
-
-        if not again then
-            return sent
-        end
-
-        local done, sec = deadline:is_done()
-        if done then
-            return sent, nil, true
-        end
+    local sock, write = self.sock, self.sock.timedwrite
+    local sent, err, timeout, sec, deadl = write(sock, str)
 
+    while sec do
         -- wait until writable
-        local ok, perr, timeout = self:wait_writable(sec)
+        local ok
+        ok, err, timeout = self:wait_writable(sec)
         if not ok then
-            return sent, perr, timeout
+            return sent, err, timeout
         end
-
-        str = str:sub(len + 1)
+        sent, err, timeout, sec, deadl = write(sock, str, sent, deadl)
     end
+    return sent, err, timeout
 end
 
 --- writesync
@@ -655,36 +638,19 @@ end
 --- @return any err
 --- @return boolean? timeout
 function Socket:send(str, ...)
-    local sock, send = self.sock, self.sock.send
-    local deadline = self:get_send_deadline()
-    local sent = 0
-
-    while true do
-        local len, err, again = send(sock, str, ...)
-
-        if not len then
-            return sent, err
-        end
-        -- update a bytes sent
-        sent = sent + len
-
-        if not again then
-            return sent
-        end
-
-        local done, sec = deadline:is_done()
-        if done then
-            return sent, nil, true
-        end
+    local sock, send = self.sock, self.sock.timedsend
+    local sent, err, timeout, sec, deadl = send(sock, str, 0, nil, ...)
 
+    while sec do
         -- wait until writable
-        local ok, perr, timeout = self:wait_writable(sec)
+        local ok
+        ok, err, timeout = self:wait_writable(sec)
         if not ok then
-            return sent, perr, timeout
+            return sent, err, timeout
         end
-
-        str = str:sub(len + 1)
+        sent, err, timeout, sec, deadl = send(sock, str, sent, deadl, ...)
     end
+    return sent, err, timeout
 end
 
 --- sendsync
@@ -758,16 +724,59 @@ function Socket:sendmsgsync(msg, addr, cmsg, ...)
     return self:syncwrite(self.sendmsg, msg, addr, cmsg, ...)
 end
 
+--- writearr
+--- @param self net.Socket
+--- @param arr string[]
+--- @param i? integer
+--- @param j? integer
+--- @param off? integer
+--- @return integer len
+--- @return any err
+--- @return boolean? timeout
+--- @return integer? idx
+--- @return integer? offset
+local function writearr(self, arr, i, j, off)
+    local sock, writev = self.sock, self.sock.writev
+    local len, idx, err, timeout, sec, deadl
+    len, idx, off, err, timeout, sec, deadl = writev(sock, arr, i, j, off)
+    local sent = len
+
+    while sec do
+        -- wait until writable
+        local ok
+        ok, err, timeout = self:wait_writable(sec)
+        if not ok then
+            break
+        end
+        len, idx, off, err, timeout, sec, deadl = writev(sock, arr, idx, j,
+                                                         off, deadl)
+        sent = sent + len
+    end
+
+    if err or timeout then
+        return sent, err, timeout, idx, off
+    end
+    return sent
+end
+
 --- writev
---- @param iov iovec
+--- @param iov iovec|string[]
 --- @param offset? integer
 --- @param nbyte? integer
+--- @param ... integer offset of iov[offset] if iov is string[]
 --- @return integer? len
 --- @return any err
 --- @return boolean? timeout
-function Socket:writev(iov, offset, nbyte)
+--- @return integer? idx
+--- @return integer? offset
+function Socket:writev(iov, offset, nbyte, ...)
+    if type(iov) == 'table' then
+        -- write the array of strings from iov[offset] to iov[nbyte]
+        return writearr(self, iov, offset, nbyte, ...)
+    end
+
     local sock, writev = self.sock, iov.writev
-    local deadline = self:get_send_deadline()
+    local deadl
     local sent = 0
 
     if offset == nil then
@@ -789,8 +798,9 @@ function Socket:writev(iov, offset, nbyte)
             return sent, err
         end
 
-        local done, sec = deadline:is_done()
-        if done then
+        local sec
+        sec, deadl = sock:deadline(true, deadl)
+        if not sec then
             return sent, nil, true
         end
 
@@ -803,14 +813,94 @@ function Socket:writev(iov, offset, nbyte)
 end
 
 --- writevsync
---- @param iov iovec
+--- @param iov iovec|string[]
 --- @param offset? integer
 --- @param nbyte? integer
+--- @param ... integer offset of iov[offset] if iov is string[]
 --- @return integer? len
 --- @return any err
 --- @return boolean? timeout
-function Socket:writevsync(iov, offset, nbyte)
-    return self:syncwrite(self.writev, iov, offset, nbyte)
+--- @return integer? idx
+--- @return integer? offset
+function Socket:writevsync(iov, offset, nbyte, ...)
+    return self:syncwrite(self.writev, iov, offset, nbyte, ...)
+end
+
+--- watermarks
+--- @param high integer?
+--- @param low integer?
+--- @return integer high
+--- @return integer low
+function Socket:watermarks(high, low)
+    local oldhigh = self.queue_high or DEFAULT_QUEUE_HIGH
+    local oldlow = self.queue_low or DEFAULT_QUEUE_LOW
+
+    if high ~= nil then
+        if not is_uint(high) then
+            error('high must be unsigned integer', 2)
+        elseif low == nil then
+            low = floor(high / 4)
+        elseif not is_uint(low) or low > high then
+            error('low must be unsigned integer less than or equal to high',
+                  2)
+        end
+        self.queue_high = high
+        self.queue_low = low
+    end
+    return oldhigh, oldlow
+end
+
+--- enqueue
+--- @param str string
+--- @return boolean? paused
+--- @return any err
+function Socket:enqueue(str)
+    local sock = self.sock
+    local len, err = sock:enqueue(str)
+    if not len then
+        return nil, err
+    end
+
+    -- write as much as possible without waiting
+    local _, ferr = sock:flushq()
+    if ferr then
+        return nil, ferr
+    end
+    return sock:queued() > (self.queue_high or DEFAULT_QUEUE_HIGH)
+end
+
+--- drain
+--- @param low integer?
+--- @return boolean ok
+--- @return any err
+--- @return boolean? timeout
+function Socket:drain(low)
+    local sock, flushq = self.sock, self.sock.flushq
+
+    if low == nil then
+        low = self.queue_low or DEFAULT_QUEUE_LOW
+    end
+
+    local _, err, timeout, sec, deadl = flushq(sock, low)
+    while sec do
+        -- wait until writable
+        local ok
+        ok, err, timeout = self:wait_writable(sec)
+        if not ok then
+            return false, err, timeout
+        end
+        _, err, timeout, sec, deadl = flushq(sock, low, deadl)
+    end
+    if err or timeout then
+        return false, err, timeout
+    end
+    return true
+end
+
+--- queued
+--- @return integer len
+function Socket:queued()
+    return self.sock:queued()
 end
 
 require('metamodule').new.Socket(Socket)
@@ -0,0 +1,247 @@
+/**
+ *  Copyright (C) 2026 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ */
+
+// project
+#include "net_socket.h"
+// system
+#include <string.h>
+
+#define RECORD_HEADER_LEN 5
+#define RECORD_MAXLEN     16384
+#define CONTENT_HANDSHAKE 22
+#define HANDSHAKE_HELLO   1
+#define EXT_SERVER_NAME   0
+#define EXT_ALPN          16
+#define SNI_HOST_NAME     0
+
+typedef struct {
+    const unsigned char *p;
+    size_t len;
+} cursor_t;
+
+static inline int read_u8(cursor_t *c, size_t *v)
+{
+    if (c->len < 1) {
+        return 0;
+    }
+    *v = c->p[0];
+    c->p++;
+    c->len--;
+    return 1;
+}
+
+static inline int read_u16(cursor_t *c, size_t *v)
+{
+    if (c->len < 2) {
+        return 0;
+    }
+    *v = ((size_t)c->p[0] << 8) | c->p[1];
+    c->p += 2;
+    c->len -= 2;
+    return 1;
+}
+
+// split n bytes off the head of c into sub
+static inline int read_bytes(cursor_t *c, size_t n, cursor_t *sub)
+{
+    if (c->len < n) {
+        return 0;
+    }
+    sub->p   = c->p;
+    sub->len = n;
+    c->p += n;
+    c->len -= n;
+    return 1;
+}
+
+// read a vector whose length is encoded in 1 or 2 bytes
+static inline int read_vec(cursor_t *c, int lenbytes, cursor_t *sub)
+{
+    size_t n = 0;
+
+    return (lenbytes == 1 ? read_u8(c, &n) : read_u16(c, &n)) &&
+           read_bytes(c, n, sub);
+}
+
+// RFC 6066 section 3; only the first host_name is used
+static int push_servername(lua_State *L, cursor_t ext)
+{
+    cursor_t list = {0};
+
+    if (!read_vec(&ext, 2, &list) || ext.len) {
+        return 0;
+    }
+    while (list.len) {
+        cursor_t name = {0};
+        size_t type   = 0;
+
+        if (!read_u8(&list, &type) || !read_vec(&list, 2, &name)) {
+            return 0;
+        } else if (type == SNI_HOST_NAME && name.len) {
+            lua_pushlstring(L, (const char *)name.p, name.len);
+            lua_setfield(L, -2, "servername");
+            return 1;
+        }
+    }
+    return 1;
+}
+
+// RFC 7301 section 3.1
+static int push_alpn(lua_State *L, cursor_t ext)
+{
+    cursor_t list = {0};
+    int n         = 0;
+
+    if (!read_vec(&ext, 2, &list) || ext.len || !list.len) {
+        return 0;
+    }
+    lua_createtable(L, 2, 0);
+    while (list.len) {
+        cursor_t name = {0};
+
+        if (!read_vec(&list, 1, &name) || !name.len) {
+            lua_pop(L, 1);
+            return 0;
+        }
+        lua_pushlstring(L, (const char *)name.p, name.len);
+        lua_rawseti(L, -2, ++n);
+    }
+    lua_setfield(L, -2, "alpn");
+    return 1;
+}
+
+static int push_hello(lua_State *L, cursor_t body)
+{
+    cursor_t skip = {0};
+    cursor_t exts = {0};
+    int top       = lua_gettop(L);
+
+    // legacy_version, random, legacy_session_id, cipher_suites and
+    // legacy_compression_methods
+    if (!read_bytes(&body, 2 + 32, &skip) || !read_vec(&body, 1, &skip) ||
+        !read_vec(&body, 2, &skip) || !read_vec(&body, 1, &skip)) {
+        return -1;
+    }
+
+    lua_createtable(L, 0, 2);
+    if (!body.len) {
+        // no extensions
+        return 1;
+    } else if (!read_vec(&body, 2, &exts) || body.len) {
+        lua_settop(L, top);
+        return -1;
+    }
+    while (exts.len) {
+        cursor_t ext = {0};
+        size_t type  = 0;
+        int ok       = 1;
+
+        if (!read_u16(&exts, &type) || !read_vec(&exts, 2, &ext)) {
+            ok = 0;
+        } else if (type == EXT_SERVER_NAME) {
+            ok = push_servername(L, ext);
+        } else if (type == EXT_ALPN) {
+            ok = push_alpn(L, ext);
+        }
+        if (!ok) {
+            lua_settop(L, top);
+            return -1;
+        }
+    }
+    return 1;
+}
+
+int net_clienthello_push(lua_State *L, const unsigned char *buf, size_t len,
+                         size_t *need)
+{
+    unsigned char *msg = NULL;
+    size_t msglen      = 0; // handshake message length including its header
+    size_t nmsg        = 0; // bytes of the message collected so far
+    size_t pos         = 0;
+    int rv             = 0;
+
+    while (1) {
+        size_t rlen = 0;
+
+        if (len - pos < RECORD_HEADER_LEN) {
+            *need = pos + RECORD_HEADER_LEN;
+            break;
+        }
+        // handshake record of TLS 1.0 or later (the record version of a
+        // ClientHello is 3.1 for compatibility, but 3.0 is accepted as well)
+        rlen = ((size_t)buf[pos + 3] << 8) | buf[pos + 4];
+        if (buf[pos] != CONTENT_HANDSHAKE || buf[pos + 1] != 3 || !rlen ||
+            rlen > RECORD_MAXLEN) {
+            rv = -1;
+            break;
+        } else if (len - pos - RECORD_HEADER_LEN < rlen) {
+            *need = pos + RECORD_HEADER_LEN + rlen;
+            break;
+        }
+        pos += RECORD_HEADER_LEN;
+
+        if (!nmsg && rlen >= 4) {
+            msglen = 4 + (((size_t)buf[pos + 1] << 16) |
+                          ((size_t)buf[pos + 2] << 8) | buf[pos + 3]);
+            if (buf[pos] != HANDSHAKE_HELLO || msglen > RECORD_MAXLEN + 4) {
+                rv = -1;
+                break;
+            } else if (rlen >= msglen) {
+                // the common case: the whole message is in the first record
+                cursor_t body = {buf + pos + 4, msglen - 4};
+                rv            = push_hello(L, body);
+                break;
+            }
+        }
+
+        // the message spans several records; collect the fragments
+        if (!msg && !(msg = malloc(RECORD_MAXLEN + 4))) {
+            return -1;
+        } else if (nmsg + rlen > RECORD_MAXLEN + 4) {
+            rv = -1;
+            break;
+        }
+        memcpy(msg + nmsg, buf + pos, rlen);
+        nmsg += rlen;
+        pos += rlen;
+
+        if (!msglen && nmsg >= 4) {
+            msglen = 4 + (((size_t)msg[1] << 16) | ((size_t)msg[2] << 8) |
+                          msg[3]);
+            if (msg[0] != HANDSHAKE_HELLO || msglen > RECORD_MAXLEN + 4) {
+                rv = -1;
+                break;
+            }
+        }
+        if (msglen && nmsg >= msglen) {
+            cursor_t body = {msg + 4, msglen - 4};
+            rv            = push_hello(L, body);
+            break;
+        }
+    }
+
+    free(msg);
+    if (rv < 0) {
+        errno = EPROTO;
+    }
+    return rv;
+}
@@ -0,0 +1,564 @@
+/**
+ *  Copyright (C) 2026 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ */
+
+// depend
+#include "lauxhlib.h"
+#include "lua_errno.h"
+// lua
+#include <lauxlib.h>
+// system
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FDCACHE_MT "net.fdcache"
+
+// small enough not to use up a common RLIMIT_NOFILE of 1024
+#define DEFAULT_MAXLEN 64
+#define DEFAULT_TTL    1.0
+
+// open-fd cache
+//
+// open() returns the descriptor of a regular file opened by the path, and
+// keeps it open for the next call.  The cached entry is revalidated by
+// stat(2) once its ttl has elapsed, and it is reopened if the file has been
+// replaced or modified.  The least recently used entries are evicted when
+// the cache holds more than maxlen entries.
+//
+// The descriptor is referenced until release() is called, so that an entry
+// evicted while a coroutine is waiting in sendfile does not close the
+// descriptor under it.
+
+typedef struct entry_t entry_t;
+
+struct entry_t {
+    entry_t *hnext; // hash chain
+    entry_t *prev;  // more recently used
+    entry_t *next;  // less recently used
+    uint32_t hash;
+    int fd;
+    int refs;
+    int cached; // linked in the hash table and the lru list
+    off_t size;
+    time_t mtime;
+    time_t ctime;
+    dev_t dev;
+    ino_t ino;
+    double checked; // monotonic time of the last validation
+    size_t len;
+    char path[];
+};
+
+typedef struct {
+    entry_t **buckets;
+    size_t nbucket; // power of 2
+    entry_t *head;  // most recently used
+    entry_t *tail;  // least recently used
+    entry_t **byfd; // referenced or cached entries indexed by fd
+    int nfd;
+    size_t len;
+    size_t maxlen;
+    double ttl;
+} fdcache_t;
+
+static inline double monotonic_time(void)
+{
+    struct timespec ts = {0};
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+// FNV-1a
+static inline uint32_t hash_path(const char *path, size_t len)
+{
+    uint32_t h = 2166136261u;
+
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)path[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static inline int is_modified(entry_t *e, struct stat *st)
+{
+    return e->dev != st->st_dev || e->ino != st->st_ino ||
+           e->size != st->st_size || e->mtime != st->st_mtime ||
+           e->ctime != st->st_ctime;
+}
+
+static void lru_unlink(fdcache_t *c, entry_t *e)
+{
+    if (e->prev) {
+        e->prev->next = e->next;
+    } else {
+        c->head = e->next;
+    }
+    if (e->next) {
+        e->next->prev = e->prev;
+    } else {
+        c->tail = e->prev;
+    }
+    e->prev = e->next = NULL;
+}
+
+static void lru_push(fdcache_t *c, entry_t *e)
+{
+    e->prev = NULL;
+    e->next = c->head;
+    if (c->head) {
+        c->head->prev = e;
+    } else {
+        c->tail = e;
+    }
+    c->head = e;
+}
+
+static void destroy(fdcache_t *c, entry_t *e)
+{
+    c->byfd[e->fd] = NULL;
+    close(e->fd);
+    free(e);
+}
+
+// remove the entry from the cache; the descriptor is closed when it is no
+// longer referenced
+static void evict(fdcache_t *c, entry_t *e)
+{
+    entry_t **ptr = &c->buckets[e->hash & (c->nbucket - 1)];
+
+    while (*ptr != e) {
+        ptr = &(*ptr)->hnext;
+    }
+    *ptr     = e->hnext;
+    e->hnext = NULL;
+    lru_unlink(c, e);
+    e->cached = 0;
+    c->len--;
+    if (!e->refs) {
+        destroy(c, e);
+    }
+}
+
+static void evict_overflow(fdcache_t *c)
+{
+    while (c->len > c->maxlen) {
+        evict(c, c->tail);
+    }
+}
+
+// grow the hash table to have at least as many buckets as maxlen
+static int rehash(fdcache_t *c)
+{
+    size_t n         = c->nbucket ? c->nbucket : 16;
+    entry_t **bucket = NULL;
+
+    while (n < c->maxlen) {
+        n <<= 1;
+    }
+    if (n == c->nbucket) {
+        return 0;
+    } else if (!(bucket = calloc(n, sizeof(entry_t *)))) {
+        return -1;
+    }
+    for (size_t i = 0; i < c->nbucket; i++) {
+        entry_t *e = c->buckets[i];
+
+        while (e) {
+            entry_t *next = e->hnext;
+            size_t idx    = e->hash & (n - 1);
+
+            e->hnext    = bucket[idx];
+            bucket[idx] = e;
+            e           = next;
+        }
+    }
+    free(c->buckets);
+    c->buckets = bucket;
+    c->nbucket = n;
+    return 0;
+}
+
+static entry_t *lookup(fdcache_t *c, const char *path, size_t len,
+                       uint32_t hash)
+{
+    entry_t *e = c->buckets[hash & (c->nbucket - 1)];
+
+    for (; e; e = e->hnext) {
+        if (e->hash == hash && e->len == len && !memcmp(e->path, path, len)) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static entry_t *create(fdcache_t *c, const char *path, size_t len,
+                       uint32_t hash)
+{
+    struct stat st = {0};
+    entry_t *e     = NULL;
+    int fd         = open(path, O_RDONLY | O_CLOEXEC);
+    int err        = 0;
+
+    if (fd == -1) {
+        return NULL;
+    } else if (fstat(fd, &st) == -1) {
+        goto FAILED;
+    } else if (!S_ISREG(st.st_mode)) {
+        errno = S_ISDIR(st.st_mode) ? EISDIR : EINVAL;
+        goto FAILED;
+    }
+
+    if (fd >= c->nfd) {
+        int n          = c->nfd ? c->nfd : 64;
+        entry_t **byfd = NULL;
+
+        while (n <= fd) {
+            n <<= 1;
+        }
+        if (!(byfd = realloc(c->byfd, sizeof(entry_t *) * (size_t)n))) {
+            goto FAILED;
+        }
+        memset(byfd + c->nfd, 0, sizeof(entry_t *) * (size_t)(n - c->nfd));
+        c->byfd = byfd;
+        c->nfd  = n;
+    }
+    if (!(e = malloc(sizeof(entry_t) + len + 1))) {
+        goto FAILED;
+    }
+    *e = (entry_t){
+        .hash  = hash,
+        .fd    = fd,
+        .size  = st.st_size,
+        .mtime = st.st_mtime,
+        .ctime = st.st_ctime,
+        .dev   = st.st_dev,
+        .ino   = st.st_ino,
+        .len   = len,
+    };
+    memcpy(e->path, path, len);
+    e->path[len] = 0;
+    c->byfd[fd]  = e;
+    return e;
+
+FAILED:
+    err = errno;
+    close(fd);
+    errno = err;
+    return NULL;
+}
+
+/**
+ * cache:open(pathname) -> fd, size, mtime | (nil, err)
+ *
+ * The returned descriptor must be released by cache:release(fd).
+ */
+static int open_lua(lua_State *L)
+{
+    fdcache_t *c     = lauxh_checkudata(L, 1, FDCACHE_MT);
+    size_t len       = 0;
+    const char *path = lauxh_checklstring(L, 2, &len);
+    uint32_t hash    = hash_path(path, len);
+    entry_t *e       = lookup(c, path, len, hash);
+    double now       = monotonic_time();
+
+    if (e && now - e->checked >= c->ttl) {
+        struct stat st = {0};
+
+        if (stat(path, &st) == -1) {
+            int err = errno;
+            evict(c, e);
+            lua_pushnil(L);
+            lua_errno_new(L, err, "open");
+            return 2;
+        } else if (is_modified(e, &st)) {
+            // replaced or modified
+            evict(c, e);
+            e = NULL;
+        } else {
+            e->checked = now;
+        }
+    }
+
+    if (e) {
+        lru_unlink(c, e);
+    } else if (!(e = create(c, path, len, hash))) {
+        lua_pushnil(L);
+        lua_errno_new(L, errno, "open");
+        return 2;
+    } else {
+        size_t idx = hash & (c->nbucket - 1);
+
+        e->checked      = now;
+        e->cached       = 1;
+        e->hnext        = c->buckets[idx];
+        c->buckets[idx] = e;
+        c->len++;
+    }
+    lru_push(c, e);
+    e->refs++;
+    evict_overflow(c);
+
+    lua_pushinteger(L, e->fd);
+    lua_pushinteger(L, (lua_Integer)e->size);
+    lua_pushinteger(L, (lua_Integer)e->mtime);
+    return 3;
+}
+
+/**
+ * cache:release(fd) -> ok
+ */
+static int release_lua(lua_State *L)
+{
+    fdcache_t *c   = lauxh_checkudata(L, 1, FDCACHE_MT);
+    lua_Integer fd = lauxh_checkinteger(L, 2);
+    entry_t *e     = NULL;
+
+    if (fd < 0 || fd >= c->nfd || !(e = c->byfd[fd]) || !e->refs) {
+        lua_pushboolean(L, 0);
+        return 1;
+    }
+    e->refs--;
+    if (!e->refs && !e->cached) {
+        destroy(c, e);
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+/**
+ * cache:pread(fd, count [, offset]) -> data | (nil, err)
+ *
+ * Reads from a descriptor referenced by cache:open(), for the transports that
+ * cannot pass it to sendfile(2).  Returns an empty string at end-of-file.
+ */
+static int pread_lua(lua_State *L)
+{
+    fdcache_t *c       = lauxh_checkudata(L, 1, FDCACHE_MT);
+    lua_Integer fd     = lauxh_checkinteger(L, 2);
+    lua_Integer count  = lauxh_checkinteger(L, 3);
+    lua_Integer offset = lauxh_optinteger(L, 4, 0);
+    char *buf          = NULL;
+    ssize_t rv         = 0;
+
+    if (count < 0) {
+        return luaL_argerror(L, 3, "count must be unsigned integer");
+    } else if (offset < 0) {
+        return luaL_argerror(L, 4, "offset must be unsigned integer");
+    } else if (fd < 0 || fd >= c->nfd || !c->byfd[fd] || !c->byfd[fd]->refs) {
+        lua_pushnil(L);
+        lua_errno_new(L, EBADF, "pread");
+        return 2;
+    }
+
+    buf = lua_newuserdata(L, count ? (size_t)count : 1);
+    while ((rv = pread((int)fd, buf, (size_t)count, (off_t)offset)) == -1 &&
+           errno == EINTR) {
+    }
+    if (rv == -1) {
+        lua_pushnil(L);
+        lua_errno_new(L, errno, "pread");
+        return 2;
+    }
+    lua_pushlstring(L, buf, (size_t)rv);
+    return 1;
+}
+
+/**
+ * cache:evict(pathname) -> ok
+ */
+static int evict_lua(lua_State *L)
+{
+    fdcache_t *c     = lauxh_checkudata(L, 1, FDCACHE_MT);
+    size_t len       = 0;
+    const char *path = lauxh_checklstring(L, 2, &len);
+    entry_t *e       = lookup(c, path, len, hash_path(path, len));
+
+    if (e) {
+        evict(c, e);
+    }
+    lua_pushboolean(L, e != NULL);
+    return 1;
+}
+
+/**
+ * cache:clear()
+ */
+static int clear_lua(lua_State *L)
+{
+    fdcache_t *c = lauxh_checkudata(L, 1, FDCACHE_MT);
+
+    while (c->head) {
+        evict(c, c->head);
+    }
+    return 0;
+}
+
+/**
+ * cache:len() -> len
+ */
+static int len_lua(lua_State *L)
+{
+    fdcache_t *c = lauxh_checkudata(L, 1, FDCACHE_MT);
+
+    lua_pushinteger(L, (lua_Integer)c->len);
+    return 1;
+}
+
+static void checklimits(lua_State *L, int idx, size_t *maxlen, double *ttl)
+{
+    lua_Integer n = lauxh_optinteger(L, idx, (lua_Integer)*maxlen);
+    lua_Number t  = lauxh_optnumber(L, idx + 1, *ttl);
+
+    if (n < 1) {
+        luaL_argerror(L, idx, "maxlen must be greater than 0");
+    } else if (!(t >= 0)) {
+        luaL_argerror(L, idx + 1, "ttl must be unsigned number");
+    }
+    *maxlen = (size_t)n;
+    *ttl    = t;
+}
+
+/**
+ * cache:limits([maxlen [, ttl]]) -> maxlen, ttl
+ *
+ * Returns the limits before the change.
+ */
+static int limits_lua(lua_State *L)
+{
+    fdcache_t *c  = lauxh_checkudata(L, 1, FDCACHE_MT);
+    size_t maxlen = c->maxlen;
+    double ttl    = c->ttl;
+
+    checklimits(L, 2, &c->maxlen, &c->ttl);
+    if (rehash(c) != 0) {
+        c->maxlen = maxlen;
+        c->ttl    = ttl;
+        return luaL_error(L, "failed to grow the hash table: %s",
+                          strerror(errno));
+    }
+    evict_overflow(c);
+    lua_pushinteger(L, (lua_Integer)maxlen);
+    lua_pushnumber(L, ttl);
+    return 2;
+}
+
+static int tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, FDCACHE_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+static int gc_lua(lua_State *L)
+{
+    fdcache_t *c = lauxh_checkudata(L, 1, FDCACHE_MT);
+
+    // close the referenced descriptors as well
+    for (int fd = 0; fd < c->nfd; fd++) {
+        if (c->byfd[fd]) {
+            destroy(c, c->byfd[fd]);
+        }
+    }
+    free(c->byfd);
+    free(c->buckets);
+    *c = (fdcache_t){0};
+    return 0;
+}
+
+// push a new cache; return -1 if the hash table cannot be allocated
+static int new_cache(lua_State *L, size_t maxlen, double ttl)
+{
+    fdcache_t *c = lua_newuserdata(L, sizeof(fdcache_t));
+
+    *c = (fdcache_t){
+        .maxlen = maxlen,
+        .ttl    = ttl,
+    };
+    lauxh_setmetatable(L, FDCACHE_MT);
+    return rehash(c);
+}
+
+/**
+ * fdcache.new([maxlen [, ttl]]) -> cache | (nil, err)
+ */
+static int new_lua(lua_State *L)
+{
+    size_t maxlen = DEFAULT_MAXLEN;
+    double ttl    = DEFAULT_TTL;
+
+    checklimits(L, 1, &maxlen, &ttl);
+    if (new_cache(L, maxlen, ttl) != 0) {
+        lua_pushnil(L);
+        lua_errno_new(L, errno, "new");
+        return 2;
+    }
+    return 1;
+}
+
+LUALIB_API int luaopen_net_fdcache(lua_State *L)
+{
+    struct luaL_Reg mmethod[] = {
+        {"__gc",       gc_lua      },
+        {"__tostring", tostring_lua},
+        {NULL,         NULL        }
+    };
+    struct luaL_Reg method[] = {
+        {"open",    open_lua   },
+        {"release", release_lua},
+        {"pread",   pread_lua  },
+        {"evict",   evict_lua  },
+        {"clear",   clear_lua  },
+        {"len",     len_lua    },
+        {"limits",  limits_lua },
+        {NULL,      NULL       }
+    };
+
+    lua_errno_loadlib(L);
+    if (luaL_newmetatable(L, FDCACHE_MT)) {
+        for (struct luaL_Reg *ptr = mmethod; ptr->name; ptr++) {
+            lauxh_pushfn2tbl(L, ptr->name, ptr->func);
+        }
+        lua_newtable(L);
+        for (struct luaL_Reg *ptr = method; ptr->name; ptr++) {
+            lauxh_pushfn2tbl(L, ptr->name, ptr->func);
+        }
+        lua_setfield(L, -2, "__index");
+    }
+    lua_pop(L, 1);
+
+    lua_createtable(L, 0, 2);
+    lauxh_pushfn2tbl(L, "new", new_lua);
+    // the cache shared by the sendfile methods
+    lua_pushstring(L, "default");
+    if (new_cache(L, DEFAULT_MAXLEN, DEFAULT_TTL) != 0) {
+        return luaL_error(L, "failed to create the default cache: %s",
+                          strerror(errno));
+    }
+    lua_rawset(L, -3);
+    return 1;
+}
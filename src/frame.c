@@ -0,0 +1,133 @@
+/**
+ *  Copyright (C) 2026 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ */
+
+
+// project
+#include "net_socket.h"
+
+const char *const NET_FRAME_FORMATS[] = {
+    "u16be", "u32be", "u64be", "u16le", "u32le", "u64le", "varint", NULL,
+};
+
+// number of bytes of the fixed length prefixes
+static const size_t PREFIX_SIZE[] = {
+    [NET_FRAME_U16BE] = 2, [NET_FRAME_U32BE] = 4, [NET_FRAME_U64BE] = 8,
+    [NET_FRAME_U16LE] = 2, [NET_FRAME_U32LE] = 4, [NET_FRAME_U64LE] = 8,
+};
+
+// a 64-bit varint takes up to 10 bytes
+#define VARINT_MAXLEN 10
+
+int net_frame_decode(net_frame_format_t fmt, const unsigned char *p,
+                     size_t len, size_t *hlen, uint64_t *flen)
+{
+    uint64_t v = 0;
+    size_t n   = 0;
+
+    switch (fmt) {
+    case NET_FRAME_VARINT:
+        for (; n < len && n < VARINT_MAXLEN; n++) {
+            // the 10th byte may only hold the most significant bit
+            if (n == VARINT_MAXLEN - 1 && p[n] > 1) {
+                errno = EPROTO;
+                return -1;
+            }
+            v |= (uint64_t)(p[n] & 0x7f) << (7 * n);
+            if (!(p[n] & 0x80)) {
+                *hlen = n + 1;
+                *flen = v;
+                return 1;
+            }
+        }
+        return 0;
+
+    case NET_FRAME_U16BE:
+    case NET_FRAME_U32BE:
+    case NET_FRAME_U64BE:
+        n = PREFIX_SIZE[fmt];
+        if (len < n) {
+            return 0;
+        }
+        for (size_t i = 0; i < n; i++) {
+            v = (v << 8) | p[i];
+        }
+        break;
+
+    default:
+        n = PREFIX_SIZE[fmt];
+        if (len < n) {
+            return 0;
+        }
+        for (size_t i = n; i > 0; i--) {
+            v = (v << 8) | p[i - 1];
+        }
+    }
+
+    *hlen = n;
+    *flen = v;
+    return 1;
+}
+
+size_t net_frame_encode(net_frame_format_t fmt, uint64_t flen,
+                        unsigned char *p)
+{
+    size_t n = 0;
+
+    switch (fmt) {
+    case NET_FRAME_VARINT:
+        do {
+            p[n] = (unsigned char)(flen & 0x7f);
+            flen >>= 7;
+            if (flen) {
+                p[n] |= 0x80;
+            }
+            n++;
+        } while (flen);
+        return n;
+
+    case NET_FRAME_U16BE:
+    case NET_FRAME_U32BE:
+    case NET_FRAME_U64BE:
+        n = PREFIX_SIZE[fmt];
+        if (n < 8 && flen >> (8 * n)) {
+            errno = EMSGSIZE;
+            return 0;
+        }
+        for (size_t i = n; i > 0; i--) {
+            p[i - 1] = (unsigned char)(flen & 0xff);
+            flen >>= 8;
+        }
+        return n;
+
+    default:
+        n = PREFIX_SIZE[fmt];
+        if (n < 8 && flen >> (8 * n)) {
+            errno = EMSGSIZE;
+            return 0;
+        }
+        for (size_t i = 0; i < n; i++) {
+            p[i] = (unsigned char)(flen & 0xff);
+            flen >>= 8;
+        }
+        return n;
+    }
+}
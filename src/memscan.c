@@ -0,0 +1,180 @@
+/**
+ *  Copyright (C) 2026 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ */
+
+
+// project
+#include "net_socket.h"
+// system
+#include <string.h>
+
+// x86 SIMD kernels are compiled with target attributes and selected at
+// runtime, so the module itself still runs on CPUs without AVX2
+#if (defined(__x86_64__) || defined(__i386__)) &&                             \
+    (defined(__GNUC__) || defined(__clang__))
+# define MEMSCAN_X86
+# include <immintrin.h>
+#endif
+
+typedef const char *(*memscan_fn)(const char *buf, size_t len,
+                                  const net_delim_t *d, int n, int *idx);
+
+// return the index of the first delimiter that starts at p, or -1
+static inline int match_at(const char *p, const char *end,
+                           const net_delim_t *d, int n)
+{
+    for (int i = 0; i < n; i++) {
+        if (*p == *d[i].str && (size_t)(end - p) >= d[i].len &&
+            memcmp(p, d[i].str, d[i].len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static const char *scan_scalar(const char *buf, size_t len,
+                               const net_delim_t *d, int n, int *idx)
+{
+    const char *end = buf + len;
+
+    for (const char *p = buf; p < end; p++) {
+        int k = match_at(p, end, d, n);
+        if (k >= 0) {
+            *idx = k;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+#if defined(MEMSCAN_X86)
+
+// The kernels compare a block at p with the first byte of each delimiter,
+// and the block at p + 1 with the second byte of the delimiters of two or
+// more bytes, so CRLF and LF are found in one pass; only the candidates
+// whose first two bytes match are verified with match_at().
+
+__attribute__((target("sse2"))) static const char *
+scan_sse2(const char *buf, size_t len, const net_delim_t *d, int n, int *idx)
+{
+    const char *end = buf + len;
+    const char *p   = buf;
+    __m128i c0[NET_DELIM_MAX];
+    __m128i c1[NET_DELIM_MAX];
+
+    for (int i = 0; i < n; i++) {
+        c0[i] = _mm_set1_epi8(d[i].str[0]);
+        c1[i] = _mm_set1_epi8(d[i].len > 1 ? d[i].str[1] : 0);
+    }
+
+    // 16 bytes and the byte after them
+    while (end - p > 16) {
+        __m128i v0    = _mm_loadu_si128((const __m128i *)p);
+        __m128i v1    = _mm_loadu_si128((const __m128i *)(p + 1));
+        __m128i m     = _mm_setzero_si128();
+        unsigned mask = 0;
+
+        for (int i = 0; i < n; i++) {
+            __m128i eq = _mm_cmpeq_epi8(v0, c0[i]);
+            if (d[i].len > 1) {
+                eq = _mm_and_si128(eq, _mm_cmpeq_epi8(v1, c1[i]));
+            }
+            m = _mm_or_si128(m, eq);
+        }
+        mask = (unsigned)_mm_movemask_epi8(m);
+        while (mask) {
+            const char *c = p + __builtin_ctz(mask);
+            int k         = match_at(c, end, d, n);
+            if (k >= 0) {
+                *idx = k;
+                return c;
+            }
+            mask &= mask - 1;
+        }
+        p += 16;
+    }
+    return scan_scalar(p, (size_t)(end - p), d, n, idx);
+}
+
+__attribute__((target("avx2"))) static const char *
+scan_avx2(const char *buf, size_t len, const net_delim_t *d, int n, int *idx)
+{
+    const char *end = buf + len;
+    const char *p   = buf;
+    __m256i c0[NET_DELIM_MAX];
+    __m256i c1[NET_DELIM_MAX];
+
+    for (int i = 0; i < n; i++) {
+        c0[i] = _mm256_set1_epi8(d[i].str[0]);
+        c1[i] = _mm256_set1_epi8(d[i].len > 1 ? d[i].str[1] : 0);
+    }
+
+    // 32 bytes and the byte after them
+    while (end - p > 32) {
+        __m256i v0    = _mm256_loadu_si256((const __m256i *)p);
+        __m256i v1    = _mm256_loadu_si256((const __m256i *)(p + 1));
+        __m256i m     = _mm256_setzero_si256();
+        uint32_t mask = 0;
+
+        for (int i = 0; i < n; i++) {
+            __m256i eq = _mm256_cmpeq_epi8(v0, c0[i]);
+            if (d[i].len > 1) {
+                eq = _mm256_and_si256(eq, _mm256_cmpeq_epi8(v1, c1[i]));
+            }
+            m = _mm256_or_si256(m, eq);
+        }
+        mask = (uint32_t)_mm256_movemask_epi8(m);
+        while (mask) {
+            const char *c = p + __builtin_ctz(mask);
+            int k         = match_at(c, end, d, n);
+            if (k >= 0) {
+                *idx = k;
+                return c;
+            }
+            mask &= mask - 1;
+        }
+        p += 32;
+    }
+    // the rest is less than 33 bytes
+    return scan_sse2(p, (size_t)(end - p), d, n, idx);
+}
+
+#endif
+
+static memscan_fn memscan = scan_scalar;
+
+void net_memscan_init(void)
+{
+#if defined(MEMSCAN_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        memscan = scan_avx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        memscan = scan_sse2;
+    }
+#endif
+}
+
+const char *net_memscan(const char *buf, size_t len, const net_delim_t *d,
+                        int n, int *idx)
+{
+    return memscan(buf, len, d, n, idx);
+}
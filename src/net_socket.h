@@ -40,6 +40,7 @@
 
 // project
 #include "config.h"
+#include "zring.h"
 // depend
 #include "lauxhlib.h"
 #include "lua_errno.h"
@@ -50,6 +51,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <ifaddrs.h>
+#include <limits.h>
 #include <net/if.h>
 #include <netdb.h>
 #include <netinet/in.h>
@@ -77,11 +79,78 @@
 # include <net/if_dl.h>
 #endif
 
+// per-call SIGPIPE suppression for send(2)-family calls.  On platforms
+// without MSG_NOSIGNAL this expands to 0 and suppression relies on the
+// SO_NOSIGPIPE socket option applied at construction time instead.
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
+// number of buffers written by one sendmsg(2) in writev() and flushq()
+#if defined(IOV_MAX) && IOV_MAX < 64
+# define NET_IOVMAX IOV_MAX
+#else
+# define NET_IOVMAX 64
+#endif
+
+/**
+ * @brief Timeout of the timed I/O methods (timedread(), timedwrite(), ...).
+ * The deadline of each operation is computed from it and returned to the
+ * caller, which passes it back while the EAGAIN -> wait -> retry loop lasts,
+ * so no deadline object is allocated per operation.
+ */
+typedef struct {
+    int is_set;   // 0: timeo has not been set and the default is used
+    double timeo; // seconds set by rcvtimeo() / sndtimeo()
+} net_deadline_t;
+
+/**
+ * @brief Receive buffer of the buffered read methods (readline(),
+ * readuntil(), readexact() and peekbuf()).  The data in `ring` never wraps
+ * around the end of `mem`, so it can be scanned and pushed as one string.
+ */
+typedef struct {
+    zring_t ring;
+    size_t scanned; // bytes from the head already searched for a delimiter
+    char mem[];
+} net_rbuf_t;
+
+/**
+ * @brief Outbound queue of the enqueue() / flushq() methods.  The buffers
+ * are copied into a singly linked list of nodes that are written with
+ * sendmsg(2) in batches.
+ */
+typedef struct net_wqnode_t net_wqnode_t;
+
+typedef struct {
+    net_wqnode_t *head;
+    net_wqnode_t *tail;
+    size_t off; // bytes of the head node already written
+    size_t len; // bytes queued, excluding off
+} net_wqueue_t;
+
+/**
+ * @brief Pipe of the recvfile() method that moves the data from the socket
+ * to a file with splice(2).  `len` bytes that have been read from the socket
+ * but not yet written to a file are left in the pipe.
+ */
+typedef struct {
+    int fds[2];
+    size_t len;
+} net_spipe_t;
+
 typedef struct {
     int fd;
     int family;
     int socktype;
     int protocol;
+    net_deadline_t rdeadl;
+    net_deadline_t wdeadl;
+    // allocated by the first buffered read; NULL until then
+    net_rbuf_t *rbuf;
+    net_wqueue_t wq;
+    // allocated by the first recvfile() on Linux; NULL until then
+    net_spipe_t *spipe;
     // Registry reference to (gc_thread_ref) and pointer to (gc_thread) a
     // Lua thread whose stack holds a LIFO of gc-callback closures added via
     // addgcfn().  The thread is allocated at socket construction time.
@@ -149,6 +218,198 @@ int net_cmsg_build_buffer(lua_State *L, int idx);
  */
 int net_cmsg_push_table(lua_State *L, const struct msghdr *msg);
 
+// TLS ClientHello parser (implemented in src/clienthello.c)
+
+/**
+ * @brief Maximum number of bytes that net_clienthello_push() may ask for; a
+ * ClientHello that does not fit is rejected.  It covers a ClientHello of
+ * 16KiB split into records of at least 2KiB.
+ */
+#define NET_CLIENTHELLO_MAXLEN (16384 + 4 + 5 * 9)
+
+/**
+ * @brief Parse the TLS ClientHello at the head of `buf` and push a table
+ * `{ servername = <string?>, alpn = <string[]?> }` onto the Lua stack.
+ *
+ * `buf` holds bytes peeked from a stream socket; the handshake message may
+ * span several TLS records.  No TLS state is created and nothing is sent, so
+ * the connection can still be handed over to another process or host.
+ *
+ * @param L    Lua state.
+ * @param buf  Bytes at the head of the stream.
+ * @param len  Number of bytes in `buf`.
+ * @param need Set to the number of bytes required to parse the ClientHello
+ *             when `buf` holds only a part of it.
+ * @return 1 if the table was pushed, 0 if more bytes are required (see
+ *         `need`), or -1 with errno set to EPROTO if the bytes are not a TLS
+ *         ClientHello, or to ENOMEM (nothing pushed).
+ */
+int net_clienthello_push(lua_State *L, const unsigned char *buf, size_t len,
+                         size_t *need);
+
+// delimiter scanning (implemented in src/memscan.c)
+
+/**
+ * @brief Maximum number of delimiters that can be searched for at once.
+ */
+#define NET_DELIM_MAX 8
+
+typedef struct {
+    const char *str;
+    size_t len; // must be > 0
+} net_delim_t;
+
+/**
+ * @brief Select the fastest scanning kernel that the CPU supports (AVX2 or
+ * SSE2 on x86, otherwise the scalar one).  Called when net.socket is loaded.
+ */
+void net_memscan_init(void);
+
+/**
+ * @brief Find the first position in `buf` at which one of the `n`
+ * delimiters starts.  When several delimiters start at that position, the
+ * first one in `d` is taken.
+ *
+ * @param buf Bytes to search.
+ * @param len Number of bytes in `buf`.
+ * @param d   Delimiters.
+ * @param n   Number of delimiters (1 to NET_DELIM_MAX).
+ * @param idx Set to the index of the delimiter found.
+ * @return Pointer to the start of the delimiter, or NULL if not found.
+ */
+const char *net_memscan(const char *buf, size_t len, const net_delim_t *d,
+                        int n, int *idx);
+
+// receive buffer helpers (implemented in src/rbuf.c)
+
+/**
+ * @brief Default capacity of the receive buffer; it also limits the length
+ * of a line or message that the buffered read methods can return.
+ */
+#define NET_RBUF_DEFAULT_SIZE 65536
+
+/**
+ * @brief Allocate an empty receive buffer of `cap` bytes.
+ *
+ * @return The new buffer, or NULL with errno set to ENOMEM.
+ */
+net_rbuf_t *net_rbuf_new(size_t cap);
+
+/**
+ * @brief Change the capacity of `*b` to `cap` bytes, keeping the buffered
+ * data.
+ *
+ * @return 0 on success, or -1 with errno set to EINVAL if the buffered data
+ *         does not fit in `cap` bytes, or to ENOMEM.
+ */
+int net_rbuf_resize(net_rbuf_t **b, size_t cap);
+
+/**
+ * @brief Read from `fd` into the free space of `b` with a single read(2),
+ * retrying EINTR.  The buffered data is moved to the start of the buffer
+ * first when that leaves more room to read into.
+ *
+ * @return The number of bytes read, 0 at end-of-file, or -1 with errno set
+ *         (EMSGSIZE if the buffer is already full).
+ */
+ssize_t net_rbuf_fill(net_rbuf_t *b, int fd);
+
+/**
+ * @brief Return the buffered data as one contiguous region.
+ */
+static inline const char *net_rbuf_data(net_rbuf_t *b, size_t *len)
+{
+    *len = b->ring.count;
+    return (const char *)b->mem + b->ring.head;
+}
+
+/**
+ * @brief Discard `n` bytes (<= the buffered length) from the head of `b`.
+ */
+void net_rbuf_consume(net_rbuf_t *b, size_t n);
+
+/**
+ * @brief Search the buffered data for the first occurrence of any of the `n`
+ * delimiters.  The search resumes where the previous unsuccessful search
+ * stopped when `resume` is set.
+ *
+ * @return The number of bytes up to and including the delimiter found, or 0
+ *         if the buffered data does not contain any of them.
+ */
+size_t net_rbuf_find(net_rbuf_t *b, const net_delim_t *delims, int n,
+                     int resume);
+
+// outbound queue helpers (implemented in src/wqueue.c)
+
+/**
+ * @brief Append a copy of `str` to the tail of `q`.
+ *
+ * @return 0 on success, or -1 with errno set to ENOMEM.
+ */
+int net_wqueue_push(net_wqueue_t *q, const char *str, size_t len);
+
+/**
+ * @brief Write the buffers at the head of `q` with a single sendmsg(2),
+ * retrying EINTR, and remove the bytes written from `q`.  A stream socket
+ * writes up to 64 buffers at once, and any other socket one buffer (a
+ * datagram) at a time.
+ *
+ * @return The number of bytes written (0 if `q` is empty), or -1 with errno
+ *         set.
+ */
+ssize_t net_wqueue_send(net_wqueue_t *q, int fd, int stream);
+
+/**
+ * @brief Discard all the buffers of `q`.
+ */
+void net_wqueue_clear(net_wqueue_t *q);
+
+// length-prefixed framing (implemented in src/frame.c)
+
+/**
+ * @brief Maximum number of bytes of a length prefix (a 64-bit varint).
+ */
+#define NET_FRAME_PREFIX_MAXLEN 10
+
+typedef enum {
+    NET_FRAME_U16BE = 0,
+    NET_FRAME_U32BE,
+    NET_FRAME_U64BE,
+    NET_FRAME_U16LE,
+    NET_FRAME_U32LE,
+    NET_FRAME_U64LE,
+    NET_FRAME_VARINT, // unsigned LEB128 as used by Protocol Buffers
+} net_frame_format_t;
+
+/**
+ * @brief Names of net_frame_format_t for luaL_checkoption().
+ */
+extern const char *const NET_FRAME_FORMATS[];
+
+/**
+ * @brief Decode the length prefix at the head of `p`.
+ *
+ * @param fmt  Format of the length prefix.
+ * @param p    Bytes at the head of a frame.
+ * @param len  Number of bytes in `p`.
+ * @param hlen Set to the number of bytes of the length prefix.
+ * @param flen Set to the length of the payload.
+ * @return 1 if decoded, 0 if `p` holds only a part of the length prefix, or
+ *         -1 with errno set to EPROTO if the varint is longer than 64 bits.
+ */
+int net_frame_decode(net_frame_format_t fmt, const unsigned char *p,
+                     size_t len, size_t *hlen, uint64_t *flen);
+
+/**
+ * @brief Encode the length prefix of a payload of `flen` bytes into `p`,
+ * which must have room for NET_FRAME_PREFIX_MAXLEN bytes.
+ *
+ * @return The number of bytes of the length prefix, or 0 with errno set to
+ *         EMSGSIZE if `flen` does not fit in the prefix.
+ */
+size_t net_frame_encode(net_frame_format_t fmt, uint64_t flen,
+                        unsigned char *p);
+
 // gc-callback thread helpers (implemented in src/gcthread.c)
 
 /**
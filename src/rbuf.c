@@ -0,0 +1,135 @@
+/**
+ *  Copyright (C) 2026 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ */
+
+
+// project
+#include "net_socket.h"
+// system
+#include <string.h>
+
+net_rbuf_t *net_rbuf_new(size_t cap)
+{
+    net_rbuf_t *b = malloc(sizeof(net_rbuf_t) + cap);
+
+    if (b) {
+        zring_init(&b->ring, b->mem, cap);
+        b->scanned = 0;
+    }
+    return b;
+}
+
+// move the buffered data to the start of the buffer
+static inline void compact(net_rbuf_t *b)
+{
+    zring_t *r = &b->ring;
+
+    if (r->head) {
+        memmove(b->mem, b->mem + r->head, r->count);
+        r->head = 0;
+        r->tail = r->count == r->cap ? 0 : r->count;
+    }
+}
+
+int net_rbuf_resize(net_rbuf_t **b, size_t cap)
+{
+    net_rbuf_t *nb = NULL;
+
+    if (!cap || (*b)->ring.count > cap) {
+        errno = EINVAL;
+        return -1;
+    }
+    compact(*b);
+    if (!(nb = realloc(*b, sizeof(net_rbuf_t) + cap))) {
+        return -1;
+    }
+    nb->ring.mem  = nb->mem;
+    nb->ring.cap  = cap;
+    nb->ring.tail = nb->ring.count == cap ? 0 : nb->ring.count;
+    *b            = nb;
+    return 0;
+}
+
+ssize_t net_rbuf_fill(net_rbuf_t *b, int fd)
+{
+    zring_t *r   = &b->ring;
+    size_t room  = r->cap - r->head - r->count;
+    size_t space = 0;
+    void *ptr    = NULL;
+    ssize_t n    = 0;
+
+    if (r->count == r->cap) {
+        errno = EMSGSIZE;
+        return -1;
+    } else if (!r->count) {
+        r->head = r->tail = 0;
+    } else if (2 * room < r->cap - r->count) {
+        // the data must not wrap around, so read only into the space after
+        // it, and move it when that space is less than half of the free space
+        // (including when there is no space after it at all)
+        compact(b);
+    }
+
+    ptr = zring_space(r, &space);
+RETRY:
+    n = read(fd, ptr, space);
+    if (n > 0) {
+        zring_commit(r, (size_t)n);
+    } else if (n == -1 && errno == EINTR) {
+        goto RETRY;
+    }
+    return n;
+}
+
+void net_rbuf_consume(net_rbuf_t *b, size_t n)
+{
+    zring_consume(&b->ring, n);
+    b->scanned = 0;
+}
+
+size_t net_rbuf_find(net_rbuf_t *b, const net_delim_t *delims, int n,
+                     int resume)
+{
+    size_t len      = 0;
+    const char *buf = net_rbuf_data(b, &len);
+    size_t pos      = resume ? b->scanned : 0;
+    size_t maxlen   = 0;
+    const char *p   = NULL;
+    int k           = 0;
+
+    p = net_memscan(buf + pos, len - pos, delims, n, &k);
+    if (p) {
+        return (size_t)(p - buf) + delims[k].len;
+    }
+
+    // a delimiter may start in the last maxlen - 1 bytes
+    for (int i = 0; i < n; i++) {
+        if (delims[i].len > maxlen) {
+            maxlen = delims[i].len;
+        }
+    }
+    if (len - pos >= maxlen) {
+        b->scanned = len - maxlen + 1;
+    } else {
+        b->scanned = pos;
+    }
+    return 0;
+}
@@ -41,6 +41,8 @@
 #endif
 
 #define DEFAULT_RECVSIZE 4096
+// default timeout of the timed I/O methods; the maximum timeout of gpoll
+#define DEFAULT_MAX_TIMEOUT (60 * 60)
 
 static inline void dostring(lua_State *L, const char *s, int argidx, int nres)
 {
@@ -910,14 +912,31 @@ static inline int sockopt_timeval_lua(lua_State *L, int level, int opt,
     return sockopts_timeval_lua(L, s->fd, level, opt, name);
 }
 
+// the timed I/O methods use the value that was set or got last, like the
+// rcvdeadl / snddeadl fields of net.Socket
+static inline int sockopt_timeo_lua(lua_State *L, int opt, const char *name,
+                                    net_deadline_t *d)
+{
+    int set = !lua_isnoneornil(L, 2);
+    int rv  = sockopt_timeval_lua(L, SOL_SOCKET, opt, name);
+
+    if (rv == 1) {
+        d->is_set = 1;
+        d->timeo  = set ? lua_tonumber(L, 2) : lua_tonumber(L, -1);
+    }
+    return rv;
+}
+
 static int rcvtimeo_lua(lua_State *L)
 {
-    return sockopt_timeval_lua(L, SOL_SOCKET, SO_RCVTIMEO, "rcvtimeo");
+    net_socket_t *s = lauxh_checkudata(L, 1, SOCKET_MT);
+    return sockopt_timeo_lua(L, SO_RCVTIMEO, "rcvtimeo", &s->rdeadl);
 }
 
 static int sndtimeo_lua(lua_State *L)
 {
-    return sockopt_timeval_lua(L, SOL_SOCKET, SO_SNDTIMEO, "sndtimeo");
+    net_socket_t *s = lauxh_checkudata(L, 1, SOCKET_MT);
+    return sockopt_timeo_lua(L, SO_SNDTIMEO, "sndtimeo", &s->wdeadl);
 }
 
 static int linger_lua(lua_State *L)
@@ -1126,6 +1145,17 @@ static inline int closefd(lua_State *L, int fd, int how, int with_shutdown)
     return 1;
 }
 
+// close the pipe of recvfile() and discard the data left in it
+static void free_spipe(net_socket_t *s)
+{
+    if (s->spipe) {
+        close(s->spipe->fds[0]);
+        close(s->spipe->fds[1]);
+        free(s->spipe);
+        s->spipe = NULL;
+    }
+}
+
 static int close_lua(lua_State *L)
 {
     net_socket_t *s   = lauxh_checkudata(L, 1, SOCKET_MT);
@@ -1134,6 +1164,10 @@ static int close_lua(lua_State *L)
     int fd            = s->fd;
 
     net_gcthread_close(L, s);
+    free(s->rbuf);
+    s->rbuf = NULL;
+    net_wqueue_clear(&s->wq);
+    free_spipe(s);
     if (fd == -1) {
         lua_pushboolean(L, 1);
         return 1;
@@ -1313,13 +1347,6 @@ static int net_check_msgflags(lua_State *L, int startidx)
     return flg;
 }
 
-// per-call SIGPIPE suppression for send(2)-family calls.  On platforms
-// without MSG_NOSIGNAL this expands to 0 and suppression relies on the
-// SO_NOSIGPIPE socket option applied at construction time instead.
-#ifndef MSG_NOSIGNAL
-# define MSG_NOSIGNAL 0
-#endif
-
 static int send_lua(lua_State *L)
 {
     net_socket_t *s = lauxh_checkudata(L, 1, SOCKET_MT);
@@ -1563,18 +1590,18 @@ static int sendmsg_lua(lua_State *L)
 #define NET_OFF_MAX ((off_t)(((uintmax_t)(off_t) - 1) >> 1))
 
 // Validate the fd (index 2), size (index 3) and offset (index 4) arguments
-// common to every sendfile_lua variant.  Index 2 accepts an integer fd or a
-// FILE*; the integer form is range-checked before the cast to int because
-// narrowing an out-of-range lua_Integer would wrap onto an unrelated
-// descriptor number.  Casting a negative lua_Integer straight to size_t
-// turns -1 into SIZE_MAX, and an offset beyond NET_OFF_MAX would silently
-// truncate when narrowed to off_t, so the checks live on the signed source
-// values before the casts.  On success writes fd/size/offset to *out_fd /
-// *out_len / *out_off and returns 0.  On failure pushes (nil, EINVAL error)
-// and returns the Lua-side return count so the caller can propagate it
-// verbatim.
+// common to every sendfile_lua variant and recvfile_lua.  Index 2 accepts an
+// integer fd or a FILE*; the integer form is range-checked before the cast
+// to int because narrowing an out-of-range lua_Integer would wrap onto an
+// unrelated descriptor number.  Casting a negative lua_Integer straight to
+// size_t turns -1 into SIZE_MAX, and an offset beyond NET_OFF_MAX would
+// silently truncate when narrowed to off_t, so the checks live on the signed
+// source values before the casts.  On success writes fd/size/offset to
+// *out_fd / *out_len / *out_off and returns 0.  On failure pushes (nil,
+// EINVAL error) and returns the Lua-side return count so the caller can
+// propagate it verbatim.
 static int check_sendfile_args(lua_State *L, int *out_fd, size_t *out_len,
-                               off_t *out_off)
+                               off_t *out_off, const char *op)
 {
     lua_Integer fd   = 0;
     lua_Integer size = lauxh_checkinteger(L, 3);
@@ -1590,7 +1617,7 @@ static int check_sendfile_args(lua_State *L, int *out_fd, size_t *out_len,
         off < 0 || (uintmax_t)off > (uintmax_t)NET_OFF_MAX) {
         lua_pushnil(L);
         errno = EINVAL;
-        lua_errno_new(L, errno, "sendfile");
+        lua_errno_new(L, errno, op);
         return 2;
     }
     *out_fd  = (int)fd;
@@ -1611,7 +1638,7 @@ static int sendfile_lua(lua_State *L)
     size_t len      = 0;
     off_t offset    = 0;
     ssize_t rv      = 0;
-    int nerr        = check_sendfile_args(L, &fd, &len, &offset);
+    int nerr        = check_sendfile_args(L, &fd, &len, &offset, "sendfile");
 
     if (nerr) {
         return nerr;
@@ -1653,7 +1680,7 @@ static int sendfile_lua(lua_State *L)
     int fd          = 0;
     size_t size     = 0;
     off_t offset    = 0;
-    int nerr        = check_sendfile_args(L, &fd, &size, &offset);
+    int nerr        = check_sendfile_args(L, &fd, &size, &offset, "sendfile");
 
     if (nerr) {
         return nerr;
@@ -1687,7 +1714,7 @@ static int sendfile_lua(lua_State *L)
     size_t len      = 0;
     off_t offset    = 0;
     off_t nbytes    = 0;
-    int nerr        = check_sendfile_args(L, &fd, &len, &offset);
+    int nerr        = check_sendfile_args(L, &fd, &len, &offset, "sendfile");
 
     if (nerr) {
         return nerr;
@@ -1740,7 +1767,7 @@ static int sendfile_lua(lua_State *L)
     int fd           = 0;
     size_t len       = 0;
     off_t offset     = 0;
-    int nerr         = check_sendfile_args(L, &fd, &len, &offset);
+    int nerr         = check_sendfile_args(L, &fd, &len, &offset, "sendfile");
     size_t bufsize   = len;
     char *buf        = NULL;
     char *chunk      = NULL;
@@ -1900,6 +1927,63 @@ static int recv_lua(lua_State *L)
     }
 }
 
+/**
+ * sock:clienthello() -> table | (nil, err) | (nil, nil, true [, need])
+ *
+ * Peeks the TLS ClientHello at the head of the stream and returns its SNI and
+ * ALPN without consuming any byte.  `need` is the number of bytes required
+ * when only a part of the ClientHello has arrived.  Returns nothing when the
+ * peer has closed the connection.
+ */
+static int clienthello_lua(lua_State *L)
+{
+    net_socket_t *s = lauxh_checkudata(L, 1, SOCKET_MT);
+    unsigned char buf[NET_CLIENTHELLO_MAXLEN];
+    size_t need = 0;
+    ssize_t rv  = recv(s->fd, buf, sizeof(buf), MSG_PEEK);
+
+    lua_settop(L, 0);
+    switch (rv) {
+    case -1:
+        // got error
+        lua_pushnil(L);
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            // again
+            lua_pushnil(L);
+            lua_pushboolean(L, 1);
+            return 3;
+        }
+        lua_errno_new(L, errno, "clienthello");
+        return 2;
+
+    case 0:
+        // close by peer
+        return 0;
+    }
+
+    switch (net_clienthello_push(L, buf, (size_t)rv, &need)) {
+    case 1:
+        return 1;
+
+    case 0:
+        lua_pushnil(L);
+        if (need > sizeof(buf)) {
+            // never fits in the buffer
+            lua_errno_new(L, EMSGSIZE, "clienthello");
+            return 2;
+        }
+        lua_pushnil(L);
+        lua_pushboolean(L, 1);
+        lua_pushinteger(L, (lua_Integer)need);
+        return 4;
+
+    default:
+        lua_pushnil(L);
+        lua_errno_new(L, errno, "clienthello");
+        return 2;
+    }
+}
+
 static int recvfrom_lua(lua_State *L)
 {
     net_socket_t *s             = lauxh_checkudata(L, 1, SOCKET_MT);
@@ -2266,6 +2350,982 @@ static int read_lua(lua_State *L)
     }
 }
 
+// timed I/O methods
+//
+// timedread(), timedrecv(), timedwrite() and timedsend() retry EINTR and
+// partial writes in C, and return the seconds left until the deadline and
+// the deadline itself as the 4th and 5th values instead of waiting when the
+// socket is not ready; the caller waits with its poller and calls again with
+// that deadline.  The poller may yield the running coroutine, which cannot
+// be done across a C call on Lua 5.1 and LuaJIT, so waiting stays with the
+// caller.  The deadline starts at the first EAGAIN of an operation and is
+// kept by the caller, so that an operation started by another coroutine
+// cannot move the deadline of the one that is waiting.
+
+static inline double monotonic_time(void)
+{
+    struct timespec ts = {0};
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+/**
+ * @brief Check the deadline returned by the previous call of a timed method.
+ * nil or false starts a new operation and returns 0.
+ */
+static inline double check_deadline(lua_State *L, int idx)
+{
+    if (lua_isnoneornil(L, idx) ||
+        (lua_type(L, idx) == LUA_TBOOLEAN && !lua_toboolean(L, idx))) {
+        return 0;
+    }
+    return lauxh_checknumber(L, idx);
+}
+
+/**
+ * @brief Return the seconds left until `*deadl`; a new operation (`*deadl`
+ * is 0) sets it to the timeout from now.  A value <= 0 means it passed.
+ */
+static inline double deadline_remain(net_deadline_t *d, double *deadl)
+{
+    double now = monotonic_time();
+
+    if (!*deadl) {
+        *deadl = now + (d->is_set ? d->timeo : DEFAULT_MAX_TIMEOUT);
+    }
+    return *deadl - now;
+}
+
+// push (nil, nil, true) if the deadline has passed, otherwise
+// (nil, nil, nil, sec, deadline) after the first value that is already pushed
+static inline int push_wait(lua_State *L, net_deadline_t *d, double deadl)
+{
+    double sec = deadline_remain(d, &deadl);
+
+    lua_pushnil(L);
+    if (sec <= 0) {
+        lua_pushboolean(L, 1);
+        return 3;
+    }
+    lua_pushnil(L);
+    lua_pushnumber(L, sec);
+    lua_pushnumber(L, deadl);
+    return 5;
+}
+
+// stack buffer for the common receive sizes
+#define TIMED_STACKBUF_SIZE 16384
+
+static int timedrecv(lua_State *L, net_socket_t *s, lua_Integer len, int flg,
+                     double deadl, const char *op)
+{
+    char stackbuf[TIMED_STACKBUF_SIZE];
+    char *buf  = stackbuf;
+    ssize_t rv = 0;
+
+    // invalid length
+    if (len <= 0) {
+        lua_pushnil(L);
+        errno = EINVAL;
+        lua_errno_new(L, errno, op);
+        return 2;
+    } else if (!flg && s->rbuf && s->rbuf->ring.count) {
+        // return the data left in the receive buffer first
+        size_t n        = 0;
+        const char *ptr = net_rbuf_data(s->rbuf, &n);
+
+        if ((size_t)len < n) {
+            n = (size_t)len;
+        }
+        lua_pushlstring(L, ptr, n);
+        net_rbuf_consume(s->rbuf, n);
+        return 1;
+    } else if (len > TIMED_STACKBUF_SIZE) {
+        buf = lua_newuserdata(L, len);
+    }
+
+RETRY:
+    rv = recv(s->fd, buf, (size_t)len, flg);
+    switch (rv) {
+    case -1:
+        if (errno == EINTR) {
+            goto RETRY;
+        }
+        lua_pushnil(L);
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return push_wait(L, &s->rdeadl, deadl);
+        }
+        lua_errno_new(L, errno, op);
+        return 2;
+
+    case 0:
+        if (s->socktype != SOCK_DGRAM && s->socktype != SOCK_RAW) {
+            // close by peer
+            return 0;
+        }
+        // fall through
+
+    default:
+        lua_pushlstring(L, buf, rv);
+        return 1;
+    }
+}
+
+/**
+ * sock:timedread([bufsize [, deadline]]) -> str | (nil, err) |
+ *                                           (nil, nil, true) |
+ *                                           (nil, nil, nil, sec, deadline)
+ */
+static int timedread_lua(lua_State *L)
+{
+    net_socket_t *s = lauxh_checkudata(L, 1, SOCKET_MT);
+    lua_Integer len = lauxh_optinteger(L, 2, DEFAULT_RECVSIZE);
+    double deadl    = check_deadline(L, 3);
+
+    return timedrecv(L, s, len, 0, deadl, "read");
+}
+
+/**
+ * sock:timedrecv([bufsize [, deadline [, flag, ...]]]) -> same as timedread()
+ */
+static int timedrecv_lua(lua_State *L)
+{
+    net_socket_t *s = lauxh_checkudata(L, 1, SOCKET_MT);
+    lua_Integer len = lauxh_optinteger(L, 2, DEFAULT_RECVSIZE);
+    double deadl    = check_deadline(L, 3);
+    int flg         = net_check_msgflags(L, 4);
+
+    return timedrecv(L, s, len, flg, deadl, "recv");
+}
+
+static int timedsend(lua_State *L, net_socket_t *s, int flg, const char *op)
+{
+    size_t len      = 0;
+    const char *buf = lauxh_checklstring(L, 2, &len);
+    lua_Integer off = lauxh_optinteger(L, 3, 0);
+    double deadl    = check_deadline(L, 4);
+
+    if (off < 0 || (size_t)off > len) {
+        return luaL_argerror(L, 3, "offset must be in the range of str");
+    } else if (!len) {
+        // invalid length
+        lua_pushinteger(L, 0);
+        errno = EINVAL;
+        lua_errno_new(L, errno, op);
+        return 2;
+    }
+
+    while ((size_t)off < len) {
+        ssize_t rv = send(s->fd, buf + off, len - (size_t)off,
+                          flg | MSG_NOSIGNAL);
+
+        if (rv > 0) {
+            off += rv;
+        } else if (rv == -1 && errno == EINTR) {
+            continue;
+        } else if (rv == 0 || errno == EAGAIN || errno == EWOULDBLOCK) {
+            // no space in the send buffer
+            lua_pushinteger(L, off);
+            return push_wait(L, &s->wdeadl, deadl);
+        } else {
+            // got error
+            // closed by peer: EPIPE || ECONNRESET
+            lua_pushinteger(L, off);
+            lua_errno_new(L, errno, op);
+            return 2;
+        }
+    }
+
+    lua_pushinteger(L, off);
+    return 1;
+}
+
+/**
+ * sock:timedwrite(str [, offset [, deadline]]) ->
+ *     len | (len, err) | (len, nil, true) | (len, nil, nil, sec, deadline)
+ *
+ * Writes str from offset until all of it is sent.  len is the offset of the
+ * first byte that is not sent yet.
+ */
+static int timedwrite_lua(lua_State *L)
+{
+    net_socket_t *s = lauxh_checkudata(L, 1, SOCKET_MT);
+    return timedsend(L, s, 0, "write");
+}
+
+/**
+ * sock:timedsend(str [, offset [, deadline [, flag, ...]]]) -> same as
+ * timedwrite()
+ */
+static int timedsend_lua(lua_State *L)
+{
+    net_socket_t *s = lauxh_checkudata(L, 1, SOCKET_MT);
+    int flg         = net_check_msgflags(L, 5);
+
+    return timedsend(L, s, flg, "send");
+}
+
+/**
+ * sock:writev(arr [, i [, j [, offset [, deadline]]]]) ->
+ *     (len, idx, offset) | (len, idx, offset, err) |
+ *     (len, idx, offset, nil, true) |
+ *     (len, idx, offset, nil, nil, sec, deadline)
+ *
+ * Writes the strings from arr[i] at offset to arr[j] in batches with
+ * sendmsg(2).  len is the number of bytes written by this call, and idx and
+ * offset are the position to resume from; idx is j + 1 once all of them are
+ * written.
+ */
+static int writev_lua(lua_State *L)
+{
+    net_socket_t *s = lauxh_checkudata(L, 1, SOCKET_MT);
+    lua_Integer i   = 0;
+    lua_Integer j   = 0;
+    lua_Integer off = 0;
+    double deadl    = 0;
+    size_t sent     = 0;
+    struct iovec iov[NET_IOVMAX];
+    lua_Integer idx[NET_IOVMAX];
+    size_t base[NET_IOVMAX];
+    struct msghdr msg = {.msg_iov = iov};
+
+    lauxh_checktable(L, 2);
+    i     = lauxh_optinteger(L, 3, 1);
+    j     = lauxh_optinteger(L, 4, (lua_Integer)lauxh_rawlen(L, 2));
+    off   = lauxh_optinteger(L, 5, 0);
+    deadl = check_deadline(L, 6);
+    if (i < 1) {
+        return luaL_argerror(L, 3, "i must be greater than 0");
+    } else if (off < 0) {
+        return luaL_argerror(L, 5, "offset must be unsigned integer");
+    }
+
+    while (i <= j) {
+        lua_Integer k = i;
+        size_t skip   = (size_t)off;
+        size_t n      = 0;
+        ssize_t rv    = 0;
+
+        // the strings are kept alive by the table
+        for (; k <= j && n < NET_IOVMAX; k++) {
+            size_t len      = 0;
+            const char *str = NULL;
+
+            lua_rawgeti(L, 2, k);
+            if (lua_type(L, -1) != LUA_TSTRING) {
+                return luaL_argerror(
+                    L, 2, lua_pushfstring(L, "arr[%d] must be string", (int)k));
+            }
+            str = lua_tolstring(L, -1, &len);
+            lua_pop(L, 1);
+            if (skip > len) {
+                return luaL_argerror(L, 5,
+                                     "offset must be in the range of arr[i]");
+            } else if (len > skip) {
+                iov[n].iov_base = (void *)(str + skip);
+                iov[n].iov_len  = len - skip;
+                idx[n]          = k;
+                base[n]         = skip;
+                n++;
+            }
+            skip = 0;
+        }
+        if (!n) {
+            // only empty strings
+            i   = k;
+            off = 0;
+            continue;
+        }
+
+        msg.msg_iovlen = n;
+        rv             = sendmsg(s->fd, &msg, MSG_NOSIGNAL);
+        if (rv > 0) {
+            size_t m = 0;
+
+            sent += (size_t)rv;
+            // find the position to resume from
+            while (m < n && (size_t)rv >= iov[m].iov_len) {
+                rv -= (ssize_t)iov[m].iov_len;
+                m++;
+            }
+            if (m == n) {
+                i   = k;
+                off = 0;
+            } else {
+                i   = idx[m];
+                off = (lua_Integer)(base[m] + (size_t)rv);
+            }
+            continue;
+        } else if (rv == -1 && errno == EINTR) {
+            continue;
+        }
+
+        lua_pushinteger(L, (lua_Integer)sent);
+        lua_pushinteger(L, i);
+        lua_pushinteger(L, off);
+        if (rv == 0 || errno == EAGAIN || errno == EWOULDBLOCK) {
+            // no space in the send buffer
+            return 2 + push_wait(L, &s->wdeadl, deadl);
+        }
+        lua_errno_new(L, errno, "writev");
+        return 4;
+    }
+
+    lua_pushinteger(L, (lua_Integer)sent);
+    lua_pushinteger(L, i);
+    lua_pushinteger(L, 0);
+    return 3;
+}
+
+/**
+ * sock:deadline(writable [, deadline]) -> sec, deadline
+ *
+ * Returns the seconds left until the deadline of the receive or send
+ * operation and the deadline to pass to the next call, for the loops that
+ * are not implemented by the timed methods.  Returns nil if the deadline has
+ * passed.
+ */
+static int deadline_lua(lua_State *L)
+{
+    net_socket_t *s = lauxh_checkudata(L, 1, SOCKET_MT);
+    int writable    = lauxh_checkboolean(L, 2);
+    double deadl    = check_deadline(L, 3);
+    double sec = deadline_remain(writable ? &s->wdeadl : &s->rdeadl, &deadl);
+
+    if (sec <= 0) {
+        return 0;
+    }
+    lua_pushnumber(L, sec);
+    lua_pushnumber(L, deadl);
+    return 2;
+}
+
+// buffered read methods
+//
+// readline(), readuntil(), readexact() and peekbuf() return data from a
+// receive buffer that is refilled with one large read(2), so that line- and
+// length-framed protocols can be parsed without concatenating and searching
+// strings in Lua.  They return the same values as timedread(); at
+// end-of-file they return nothing, and incomplete data stays in the buffer
+// where read() and recv() without flags return it first.
+
+// get the receive buffer of the socket, allocating it on first use
+static inline net_rbuf_t *getrbuf(net_socket_t *s)
+{
+    if (!s->rbuf) {
+        s->rbuf = net_rbuf_new(NET_RBUF_DEFAULT_SIZE);
+    }
+    return s->rbuf;
+}
+
+#define BUFREAD_PEEK  0x1 // do not consume the data
+#define BUFREAD_CHOMP 0x2 // remove the trailing LF or CRLF
+
+/**
+ * @brief Refill the receive buffer until it holds `n` bytes, or until it
+ * holds one of the `ndelim` delimiters when `delims` is not NULL, and push
+ * the data up to there.
+ */
+static int bufread(lua_State *L, net_socket_t *s, const net_delim_t *delims,
+                   int ndelim, size_t n, int flg, double deadl, const char *op)
+{
+    net_rbuf_t *b   = getrbuf(s);
+    const char *buf = NULL;
+    size_t len      = 0;
+    int resume      = deadl != 0;
+
+    if (!b) {
+        lua_pushnil(L);
+        lua_errno_new(L, errno, op);
+        return 2;
+    }
+
+    while (1) {
+        if (delims) {
+            n = net_rbuf_find(b, delims, ndelim, resume);
+            if (n) {
+                break;
+            }
+            // search only the data read after this
+            resume = 1;
+        } else if (b->ring.count >= n) {
+            break;
+        }
+
+        switch (net_rbuf_fill(b, s->fd)) {
+        case -1:
+            lua_pushnil(L);
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return push_wait(L, &s->rdeadl, deadl);
+            }
+            lua_errno_new(L, errno, op);
+            return 2;
+
+        case 0:
+            // close by peer
+            return 0;
+        }
+    }
+
+    buf = net_rbuf_data(b, &len);
+    len = n;
+    if (flg & BUFREAD_CHOMP) {
+        len--;
+        if (len && buf[len - 1] == '\r') {
+            len--;
+        }
+    }
+    lua_pushlstring(L, buf, len);
+    if (!(flg & BUFREAD_PEEK)) {
+        net_rbuf_consume(b, n);
+    }
+    return 1;
+}
+
+/**
+ * sock:readline([keepeol [, deadline]]) -> line | (nil, err) |
+ *                                          (nil, nil, true) |
+ *                                          (nil, nil, nil, sec, deadline)
+ */
+static int readline_lua(lua_State *L)
+{
+    net_socket_t *s = lauxh_checkudata(L, 1, SOCKET_MT);
+    int keepeol     = lauxh_optboolean(L, 2, 0);
+    double deadl    = check_deadline(L, 3);
+    net_delim_t lf  = {"\n", 1};
+
+    return bufread(L, s, &lf, 1, 0, keepeol ? 0 : BUFREAD_CHOMP, deadl,
+                   "readline");
+}
+
+/**
+ * sock:readuntil(delim [, deadline]) -> same as readline()
+ *  delim: string | string[]
+ */
+static int readuntil_lua(lua_State *L)
+{
+    net_socket_t *s                   = lauxh_checkudata(L, 1, SOCKET_MT);
+    double deadl                      = check_deadline(L, 3);
+    net_delim_t delims[NET_DELIM_MAX] = {0};
+    int n                             = 1;
+
+    if (!lua_istable(L, 2)) {
+        delims[0].str = lauxh_checklstring(L, 2, &delims[0].len);
+    } else {
+        n = (int)lauxh_rawlen(L, 2);
+        if (n < 1 || n > NET_DELIM_MAX) {
+            return luaL_argerror(
+                L, 2,
+                lua_pushfstring(L, "delim must have 1 to %d delimiters",
+                                NET_DELIM_MAX));
+        }
+        for (int i = 0; i < n; i++) {
+            // the strings are kept alive by the table
+            lua_rawgeti(L, 2, i + 1);
+            if (lua_type(L, -1) != LUA_TSTRING) {
+                return luaL_argerror(L, 2, "delim must be string[]");
+            }
+            delims[i].str = lua_tolstring(L, -1, &delims[i].len);
+            lua_pop(L, 1);
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        if (!delims[i].len) {
+            return luaL_argerror(L, 2, "delim must not be empty");
+        }
+    }
+    return bufread(L, s, delims, n, 0, 0, deadl, "readuntil");
+}
+
+static int bufread_exact(lua_State *L, int flg, const char *op)
+{
+    net_socket_t *s = lauxh_checkudata(L, 1, SOCKET_MT);
+    lua_Integer n   = lauxh_checkinteger(L, 2);
+    double deadl    = check_deadline(L, 3);
+
+    // invalid length
+    if (n <= 0) {
+        lua_pushnil(L);
+        errno = EINVAL;
+        lua_errno_new(L, errno, op);
+        return 2;
+    }
+    return bufread(L, s, NULL, 0, (size_t)n, flg, deadl, op);
+}
+
+/**
+ * sock:readexact(n [, deadline]) -> same as readline()
+ */
+static int readexact_lua(lua_State *L)
+{
+    return bufread_exact(L, 0, "readexact");
+}
+
+/**
+ * sock:peekbuf(n [, deadline]) -> same as readline()
+ */
+static int peekbuf_lua(lua_State *L)
+{
+    return bufread_exact(L, BUFREAD_PEEK, "peekbuf");
+}
+
+/**
+ * sock:rbufsize([size]) -> size | (nil, err)
+ */
+static int rbufsize_lua(lua_State *L)
+{
+    net_socket_t *s  = lauxh_checkudata(L, 1, SOCKET_MT);
+    lua_Integer size = lauxh_optinteger(L, 2, 0);
+    net_rbuf_t *b    = NULL;
+
+    if (size < 0) {
+        return luaL_argerror(L, 2, "size must be unsigned integer");
+    } else if (!(b = getrbuf(s))) {
+        lua_pushnil(L);
+        lua_errno_new(L, errno, "rbufsize");
+        return 2;
+    }
+    // returns the size before the change
+    lua_pushinteger(L, (lua_Integer)b->ring.cap);
+    if (size && net_rbuf_resize(&s->rbuf, (size_t)size) != 0) {
+        lua_pushnil(L);
+        lua_errno_new(L, errno, "rbufsize");
+        return 2;
+    }
+    return 1;
+}
+
+/**
+ * sock:buffered() -> len
+ */
+static int buffered_lua(lua_State *L)
+{
+    net_socket_t *s = lauxh_checkudata(L, 1, SOCKET_MT);
+
+    lua_pushinteger(L, s->rbuf ? (lua_Integer)s->rbuf->ring.count : 0);
+    return 1;
+}
+
+// recvfile
+//
+// recvfile() is the reverse of sendfile(); it writes the data received from
+// the socket to a file at an offset.  On Linux the data is moved with
+// splice(2) through a pipe of the socket, so it is never copied to user
+// space.  Otherwise, or if the socket does not support splice(2), it is
+// read into the receive buffer of the buffered read methods and written
+// from there with pwrite(2).
+//
+// The data that has been read from the socket but could not be written to
+// the file is left in the receive buffer, and is written first by the next
+// call or returned by the next read.  When a splice(2) from the pipe to the
+// file fails, the data left in the pipe is moved back into the receive
+// buffer, since no other read method looks into the pipe.
+
+#if defined(__linux__)
+
+static net_spipe_t *get_spipe(net_socket_t *s)
+{
+    net_spipe_t *p = s->spipe;
+
+    if (!p) {
+        if (!(p = malloc(sizeof(net_spipe_t)))) {
+            return NULL;
+        } else if (pipe2(p->fds, O_NONBLOCK | O_CLOEXEC) == -1) {
+            free(p);
+            return NULL;
+        }
+        p->len   = 0;
+        s->spipe = p;
+    }
+    return p;
+}
+
+/**
+ * @brief Move the data left in the pipe into the receive buffer, growing
+ * the buffer if it cannot hold it.  On failure, the data stays in the pipe
+ * and is written first by the next recvfile().
+ */
+static void drain_spipe(net_socket_t *s)
+{
+    net_spipe_t *p = s->spipe;
+    net_rbuf_t *b  = NULL;
+    int err        = errno;
+
+    if (!p || !p->len || !(b = getrbuf(s))) {
+        goto DONE;
+    } else if (b->ring.cap - b->ring.count < p->len &&
+               net_rbuf_resize(&s->rbuf, b->ring.count + p->len) != 0) {
+        goto DONE;
+    }
+
+    while (p->len) {
+        ssize_t n = net_rbuf_fill(s->rbuf, p->fds[0]);
+
+        if (n <= 0) {
+            break;
+        }
+        p->len -= (size_t)n;
+    }
+
+DONE:
+    errno = err;
+}
+
+#endif
+
+/**
+ * sock:recvfile(fd, bytes [, offset [, deadline]]) ->
+ *     len | (len, err) | (len, nil, true) | (len, nil, nil, sec, deadline)
+ *
+ * Writes up to bytes of the received data to fd at offset.  len is the
+ * number of bytes written, and it is less than bytes without err if the
+ * peer has closed the connection.
+ */
+static int recvfile_lua(lua_State *L)
+{
+    net_socket_t *s = lauxh_checkudata(L, 1, SOCKET_MT);
+    double deadl    = check_deadline(L, 5);
+    int fd          = 0;
+    size_t len      = 0;
+    off_t offset    = 0;
+    size_t nw       = 0;
+    int nerr        = check_sendfile_args(L, &fd, &len, &offset, "recvfile");
+#if defined(__linux__)
+    int copy = 0;
+#else
+    int copy = 1;
+#endif
+
+    if (nerr) {
+        return nerr;
+    }
+
+    while (nw < len) {
+        size_t rest = len - nw;
+        ssize_t rv  = 0;
+
+#if defined(__linux__)
+        if (s->spipe && s->spipe->len) {
+            // write the data left in the pipe first
+            net_spipe_t *p = s->spipe;
+            loff_t off     = (loff_t)offset + (loff_t)nw;
+
+            rv = splice(p->fds[0], NULL, fd, &off,
+                        p->len < rest ? p->len : rest, SPLICE_F_MOVE);
+            if (rv > 0) {
+                p->len -= (size_t)rv;
+                nw += (size_t)rv;
+                continue;
+            } else if (rv == -1 && errno == EINTR) {
+                continue;
+            } else if (rv == 0) {
+                errno = EIO;
+            }
+            goto FAILED;
+        }
+#endif
+        if (s->rbuf && s->rbuf->ring.count) {
+            // write the data left in the receive buffer
+            size_t n        = 0;
+            const char *ptr = net_rbuf_data(s->rbuf, &n);
+
+            rv = pwrite(fd, ptr, n < rest ? n : rest, offset + (off_t)nw);
+            if (rv > 0) {
+                net_rbuf_consume(s->rbuf, (size_t)rv);
+                nw += (size_t)rv;
+                continue;
+            } else if (rv == -1 && errno == EINTR) {
+                continue;
+            } else if (rv == 0) {
+                errno = EIO;
+            }
+            goto FAILED;
+        }
+
+        if (!copy) {
+#if defined(__linux__)
+            net_spipe_t *p = get_spipe(s);
+
+            if (!p) {
+                goto FAILED;
+            }
+            rv = splice(s->fd, NULL, p->fds[1], NULL, rest,
+                        SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (rv > 0) {
+                p->len = (size_t)rv;
+                continue;
+            } else if (rv == -1 && errno == EINVAL) {
+                // the socket does not support splice(2)
+                copy = 1;
+                continue;
+            }
+#endif
+        } else if (!getrbuf(s)) {
+            goto FAILED;
+        } else {
+            rv = net_rbuf_fill(s->rbuf, s->fd);
+            if (rv > 0) {
+                continue;
+            }
+        }
+
+        if (rv == 0) {
+            // closed by peer
+            break;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            lua_pushinteger(L, (lua_Integer)nw);
+            return push_wait(L, &s->rdeadl, deadl);
+        }
+        goto FAILED;
+    }
+
+    lua_pushinteger(L, (lua_Integer)nw);
+    return 1;
+
+FAILED:
+#if defined(__linux__)
+    drain_spipe(s);
+#endif
+    lua_pushinteger(L, (lua_Integer)nw);
+    lua_errno_new(L, errno, "recvfile");
+    return 2;
+}
+
+// outbound queue
+//
+// enqueue() copies a buffer into the queue of the socket, and flushq() writes
+// the queued buffers in batches with sendmsg(2) until no more than `low`
+// bytes remain.  flushq() returns the same values as timedsend(), so that
+// any number of producers can share one queue and flush it in turn.
+
+/**
+ * sock:enqueue(str) -> len | (nil, err)
+ */
+static int enqueue_lua(lua_State *L)
+{
+    net_socket_t *s = lauxh_checkudata(L, 1, SOCKET_MT);
+    size_t len      = 0;
+    const char *str = lauxh_checklstring(L, 2, &len);
+
+    if (len && net_wqueue_push(&s->wq, str, len) != 0) {
+        lua_pushnil(L);
+        lua_errno_new(L, errno, "enqueue");
+        return 2;
+    }
+    lua_pushinteger(L, (lua_Integer)s->wq.len);
+    return 1;
+}
+
+/**
+ * sock:flushq([low [, deadline]]) -> len | (len, err) | (len, nil, true) |
+ *                                    (len, nil, nil, sec, deadline)
+ */
+static int flushq_lua(lua_State *L)
+{
+    net_socket_t *s = lauxh_checkudata(L, 1, SOCKET_MT);
+    lua_Integer low = lauxh_optinteger(L, 2, 0);
+    double deadl    = check_deadline(L, 3);
+    int stream      = s->socktype == SOCK_STREAM;
+    size_t sent     = 0;
+
+    if (low < 0) {
+        return luaL_argerror(L, 2, "low must be unsigned integer");
+    }
+    while (s->wq.len > (size_t)low) {
+        ssize_t n = net_wqueue_send(&s->wq, s->fd, stream);
+
+        if (n == -1) {
+            lua_pushinteger(L, (lua_Integer)sent);
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return push_wait(L, &s->wdeadl, deadl);
+            }
+            lua_errno_new(L, errno, "flushq");
+            return 2;
+        }
+        sent += (size_t)n;
+    }
+    lua_pushinteger(L, (lua_Integer)sent);
+    return 1;
+}
+
+/**
+ * sock:queued() -> len
+ */
+static int queued_lua(lua_State *L)
+{
+    net_socket_t *s = lauxh_checkudata(L, 1, SOCKET_MT);
+
+    lua_pushinteger(L, (lua_Integer)s->wq.len);
+    return 1;
+}
+
+// length-prefixed frames
+//
+// readframe() and readframes() decode the frames in the receive buffer of
+// the buffered read methods and return the same values as readline().
+
+/**
+ * @brief Check whether the receive buffer holds a complete frame.
+ *
+ * @return 1 if it holds one of `hlen` + `flen` bytes, 0 if more data is
+ *         required (`hlen` is set to 0 until the prefix has been decoded), or
+ *         -1 with errno set.
+ */
+static inline int frame_next(net_rbuf_t *b, net_frame_format_t fmt,
+                             uint64_t maxsize, size_t *hlen, uint64_t *flen)
+{
+    size_t len             = 0;
+    const unsigned char *p = (const unsigned char *)net_rbuf_data(b, &len);
+    int rv                 = net_frame_decode(fmt, p, len, hlen, flen);
+
+    if (rv <= 0) {
+        *hlen = 0;
+        return rv;
+    } else if (*flen > maxsize) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    return len - *hlen >= *flen;
+}
+
+static int frameread(lua_State *L, int batch, const char *op)
+{
+    net_socket_t *s = lauxh_checkudata(L, 1, SOCKET_MT);
+    net_frame_format_t fmt =
+        (net_frame_format_t)luaL_checkoption(L, 2, "u32be", NET_FRAME_FORMATS);
+    lua_Integer maxsize = lauxh_optinteger(L, 3, NET_RBUF_DEFAULT_SIZE);
+    double deadl        = check_deadline(L, 4);
+    net_rbuf_t *b       = getrbuf(s);
+    const char *buf     = NULL;
+    size_t len          = 0;
+    size_t hlen         = 0;
+    uint64_t flen       = 0;
+    int rv              = 0;
+    int n               = 0;
+
+    if (maxsize < 0) {
+        return luaL_argerror(L, 3, "maxsize must be unsigned integer");
+    } else if (!b) {
+        lua_pushnil(L);
+        lua_errno_new(L, errno, op);
+        return 2;
+    }
+
+    while (!(rv = frame_next(b, fmt, (uint64_t)maxsize, &hlen, &flen))) {
+        // make room for the whole frame
+        if (hlen && hlen + flen > b->ring.cap) {
+            if (net_rbuf_resize(&s->rbuf, hlen + flen) != 0) {
+                break;
+            }
+            b = s->rbuf;
+        }
+
+        switch (net_rbuf_fill(b, s->fd)) {
+        case -1:
+            lua_pushnil(L);
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return push_wait(L, &s->rdeadl, deadl);
+            }
+            lua_errno_new(L, errno, op);
+            return 2;
+
+        case 0:
+            // close by peer
+            return 0;
+        }
+    }
+    if (rv != 1) {
+        lua_pushnil(L);
+        lua_errno_new(L, errno, op);
+        return 2;
+    }
+
+    if (batch) {
+        lua_createtable(L, 4, 0);
+    }
+    // push the complete frames; readframe() takes only the first one
+    do {
+        buf = net_rbuf_data(b, &len);
+        lua_pushlstring(L, buf + hlen, (size_t)flen);
+        net_rbuf_consume(b, hlen + (size_t)flen);
+        if (!batch) {
+            return 1;
+        }
+        lua_rawseti(L, -2, ++n);
+    } while (frame_next(b, fmt, (uint64_t)maxsize, &hlen, &flen) == 1);
+    return 1;
+}
+
+/**
+ * sock:readframe([fmt [, maxsize [, deadline]]]) -> same as readline()
+ */
+static int readframe_lua(lua_State *L)
+{
+    return frameread(L, 0, "readframe");
+}
+
+/**
+ * sock:readframes([fmt [, maxsize [, deadline]]]) ->
+ *     frames | (nil, err) | (nil, nil, true) | (nil, nil, nil, sec, deadline)
+ */
+static int readframes_lua(lua_State *L)
+{
+    return frameread(L, 1, "readframes");
+}
+
+static void addframe(lua_State *L, luaL_Buffer *b, net_frame_format_t fmt,
+                     const char *str, size_t len, size_t i)
+{
+    unsigned char hdr[NET_FRAME_PREFIX_MAXLEN];
+    size_t hlen = net_frame_encode(fmt, len, hdr);
+
+    if (!hlen) {
+        luaL_error(L, "the length of frame #%d is too long for %s", (int)i,
+                   NET_FRAME_FORMATS[fmt]);
+    }
+    luaL_addlstring(b, (const char *)hdr, hlen);
+    luaL_addlstring(b, str, len);
+}
+
+/**
+ * socket.encode_frame(fmt, str | str[]) -> frames
+ */
+static int encode_frame_lua(lua_State *L)
+{
+    net_frame_format_t fmt =
+        (net_frame_format_t)luaL_checkoption(L, 1, NULL, NET_FRAME_FORMATS);
+    const char *str = NULL;
+    size_t len      = 0;
+    luaL_Buffer b;
+
+    lua_settop(L, 2);
+    if (!lua_istable(L, 2)) {
+        str = lauxh_checklstring(L, 2, &len);
+        luaL_buffinit(L, &b);
+        addframe(L, &b, fmt, str, len, 1);
+        luaL_pushresult(&b);
+        return 1;
+    }
+
+    luaL_buffinit(L, &b);
+    for (size_t i = 1, n = lauxh_rawlen(L, 2); i <= n; i++) {
+        lua_rawgeti(L, 2, (int)i);
+        if (lua_type(L, -1) != LUA_TSTRING) {
+            return luaL_argerror(L, 2, "frames must be string[]");
+        }
+        // the string is kept alive by the table, and the stack must be
+        // balanced between the buffer operations
+        str = lua_tolstring(L, -1, &len);
+        lua_pop(L, 1);
+        addframe(L, &b, fmt, str, len, i);
+    }
+    luaL_pushresult(&b);
+    return 1;
+}
+
 static int connect_lua(lua_State *L)
 {
     net_socket_t *s      = lauxh_checkudata(L, 1, SOCKET_MT);
@@ -2461,6 +3521,10 @@ static int gc_lua(lua_State *L)
     // the registry; gating this on fd != -1 leaked one gc thread per
     // failed constructor attempt.
     net_gcthread_close(L, s);
+    free(s->rbuf);
+    s->rbuf = NULL;
+    net_wqueue_clear(&s->wq);
+    free_spipe(s);
 
     if (s->fd != -1) {
         close(s->fd);
@@ -3276,6 +4340,9 @@ LUALIB_API int luaopen_net_socket(lua_State *L)
     lua_errno_loadlib(L);
     dostring(L, "require('net.addrinfo')", 0, 0);
 
+    // select the delimiter scanning kernel of the buffered read methods
+    net_memscan_init();
+
     // create socket metatable
     if (luaL_newmetatable(L, SOCKET_MT)) {
         struct luaL_Reg mmethod[] = {
@@ -3306,11 +4373,30 @@ LUALIB_API int luaopen_net_socket(lua_State *L)
             {"sendfd",            sendfd_lua           },
             {"sendmsg",           sendmsg_lua          },
             {"sendfile",          sendfile_lua         },
+            {"recvfile",          recvfile_lua         },
             {"recv",              recv_lua             },
             {"recvfrom",          recvfrom_lua         },
+            {"timedread",         timedread_lua        },
+            {"timedrecv",         timedrecv_lua        },
+            {"timedwrite",        timedwrite_lua       },
+            {"timedsend",         timedsend_lua        },
+            {"readline",          readline_lua         },
+            {"readuntil",         readuntil_lua        },
+            {"readexact",         readexact_lua        },
+            {"peekbuf",           peekbuf_lua          },
+            {"rbufsize",          rbufsize_lua         },
+            {"buffered",          buffered_lua         },
+            {"readframe",         readframe_lua        },
+            {"readframes",        readframes_lua       },
+            {"enqueue",           enqueue_lua          },
+            {"flushq",            flushq_lua           },
+            {"queued",            queued_lua           },
+            {"deadline",          deadline_lua         },
+            {"clienthello",       clienthello_lua      },
             {"recvfd",            recvfd_lua           },
             {"recvmsg",           recvmsg_lua          },
             {"write",             write_lua            },
+            {"writev",            writev_lua           },
             {"read",              read_lua             },
 
             // state
@@ -3402,6 +4488,9 @@ LUALIB_API int luaopen_net_socket(lua_State *L)
 
     lauxh_pushfn2tbl(L, "pair", pair_lua);
 
+    // length-prefixed framing
+    lauxh_pushfn2tbl(L, "encode_frame", encode_frame_lua);
+
     // socket creation
     lauxh_pushfn2tbl(L, "wrap", wrap_lua);
     lauxh_pushfn2tbl(L, "close", closefd_lua);
@@ -32,14 +32,63 @@
 #include <lua.h>
 // system
 #include <openssl/err.h>
+#include <openssl/ocsp.h>
+#include <openssl/sha.h>
 #include <openssl/ssl.h>
+#include <pthread.h>
 #include <stddef.h>
+#include <time.h>
+#if defined(__aarch64__) && defined(__linux__)
+# include <asm/hwcap.h>
+# include <sys/auxv.h>
+#endif
 
 #include "tls_bio.h"
+#include "tls_certstore.h"
+#include "tls_crlindex.h"
+#include "tls_digest.h"
+#include "tls_offload.h"
+#include "tls_sslpool.h"
+#include "tls_staple.h"
+#include "tls_x509cache.h"
+
+// Handshakes offloaded to worker threads (see tls_offload.h) hold config for
+// reading while they run; Lua methods that change the SSL_CTX or the state
+// read by its callbacks hold it for writing.  cache guards the caches that
+// the callbacks update, since handshakes of one server or client may run on
+// several threads at once.
+typedef struct {
+    pthread_rwlock_t config;
+    pthread_mutex_t cache;
+} tls_lock_t;
+
+static inline int tls_lock_init(tls_lock_t *lock)
+{
+    if (pthread_rwlock_init(&lock->config, NULL) != 0) {
+        return -1;
+    } else if (pthread_mutex_init(&lock->cache, NULL) != 0) {
+        pthread_rwlock_destroy(&lock->config);
+        return -1;
+    }
+    return 0;
+}
+
+static inline void tls_lock_destroy(tls_lock_t *lock)
+{
+    pthread_rwlock_destroy(&lock->config);
+    pthread_mutex_destroy(&lock->cache);
+}
 
 typedef struct {
     lua_State *L;
     SSL_CTX *ctx;
+    tls_lock_t lock;
+    int offload;       // run handshakes on the worker threads
+    int shutdown_mode; // tls_shutdown_mode_t of the accepted connections
+    tls_sslpool_t pool;         // SSL objects reused by accept()
+    tls_certstore_t *certstore; // created by the first add_sni_cert()
+    tls_staple_t *staple;       // OCSP responses stapled by this server
+    int ocsp_callback_ref;
     int sni_callback_ref;
     int ref_alpn;
     unsigned char *alpn;
@@ -48,9 +97,30 @@ typedef struct {
 
 #define NET_TLS_SERVER_MT "net.tls.server"
 
+// maximum number of OCSP verification results cached per client
+#define TLS_OCSP_RESULT_CACHE_SIZE 256
+
+// result of a stapled OCSP response that has been verified
+typedef struct tls_ocsp_result_t {
+    struct tls_ocsp_result_t *next;
+    OCSP_CERTID *certid;
+    unsigned char digest[SHA256_DIGEST_LENGTH]; // digest of the response
+    const tls_x509store_t *store;               // verified against
+    time_t expires;
+    int status;
+} tls_ocsp_result_t;
+
 typedef struct {
     lua_State *L;
     SSL_CTX *ctx;
+    tls_lock_t lock;
+    int offload;       // run handshakes on the worker threads
+    int shutdown_mode; // tls_shutdown_mode_t of the connections
+    tls_sslpool_t pool;             // SSL objects reused by connect()
+    const tls_x509store_t *castore; // shared; see tls_x509cache.h
+    tls_ocsp_result_t *ocsp_results;
+    size_t nocsp_result;
+    tls_crlindex_t *crlindex; // swapped by tls_crlindex_swap()
     int error_cb_ref;
 } tls_client_t;
 
@@ -154,11 +224,13 @@ typedef struct {
     int (*handshake_cb)(SSL *);
     void *parent; // tls_server_t* / tls_client_t*; kept alive by parent_ref
     int parent_ref;
+    tls_offload_job_t *job; // non-NULL while the handshake is offloaded
+    int shutdown_mode;      // tls_shutdown_mode_t
 } tls_ctx_t;
 
 #define NET_TLS_CONTEXT_MT "net.tls.context"
 
-static inline void tls_init(lua_State *L)
+static inline void tls_openssl_init_once(void)
 {
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
     SSL_library_init();
@@ -168,7 +240,19 @@ static inline void tls_init(lua_State *L)
     OPENSSL_init_ssl(
         OPENSSL_INIT_LOAD_SSL_STRINGS | OPENSSL_INIT_LOAD_CRYPTO_STRINGS, NULL);
 #endif
+}
+
+// OpenSSL is initialized by the first SSL_CTX of the module instead of when
+// the module is loaded, since the TLS modules are often loaded by programs
+// that only use plain sockets.  call this before SSL_CTX_new().
+static inline void tls_openssl_init(void)
+{
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, tls_openssl_init_once);
+}
 
+static inline void tls_init(lua_State *L)
+{
     // initilize dependent modules
     lua_error_loadlib(L, 1);
 }
@@ -184,24 +268,58 @@ static inline void tls_init(lua_State *L)
 // #endif
 // }
 
+typedef enum {
+    NET_TLS_SHUTDOWN_FULL = 0, // exchange close_notify with the peer
+    NET_TLS_SHUTDOWN_FAST,     // send close_notify without waiting for the
+                               // peer's one
+    NET_TLS_SHUTDOWN_QUIET,    // send nothing (SSL_set_quiet_shutdown)
+} tls_shutdown_mode_t;
+
+static const char *const TLS_SHUTDOWN_MODES[] = {
+    "full",
+    "fast",
+    "quiet",
+    NULL,
+};
+
 typedef enum {
     NET_TLS_CIPHER_SUITE_DEFAULT = 0,
     NET_TLS_CIPHER_SUITE_SECURE,
     NET_TLS_CIPHER_SUITE_LEGACY,
     NET_TLS_CIPHER_SUITE_ALL,
+    NET_TLS_CIPHER_SUITE_PERFORMANCE,
 } tls_cipher_suite_t;
 
 static const char *const TLS_CIPHER_SUITES[] = {
-    "default", // HIGH:!aNULL
-    "secure",  // same as default
-    "legacy",  // HIGH:MEDIUM:!aNULL
-    "all",     // ALL:!aNULL:!eNULL
+    "default",     // HIGH:!aNULL
+    "secure",      // same as default
+    "legacy",      // HIGH:MEDIUM:!aNULL
+    "all",         // ALL:!aNULL:!eNULL
+    "performance", // same as default, ordered by the speed on this CPU
     NULL,
 };
 
+// AES-GCM is faster than ChaCha20-Poly1305 only with AES instructions
+static inline int tls_has_aes_hw(void)
+{
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    return __builtin_cpu_supports("aes");
+#elif defined(__aarch64__) && defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_AES) != 0;
+#elif defined(__aarch64__) && defined(__APPLE__)
+    return 1;
+#else
+    return 0;
+#endif
+}
+
 static inline int tls_set_cipher_suite(SSL_CTX *ctx, tls_cipher_suite_t suite)
 {
     const char *ciphers = NULL;
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    const char *suites = "TLS_AES_256_GCM_SHA384:TLS_CHACHA20_POLY1305_SHA256:"
+                         "TLS_AES_128_GCM_SHA256";
+#endif
 
     switch (suite) {
     default:
@@ -217,6 +335,29 @@ static inline int tls_set_cipher_suite(SSL_CTX *ctx, tls_cipher_suite_t suite)
     case NET_TLS_CIPHER_SUITE_ALL:
         ciphers = "ALL:!aNULL:!eNULL";
         break;
+
+    case NET_TLS_CIPHER_SUITE_PERFORMANCE:
+        // forward secret AEAD ciphers first; AES-128-GCM where the CPU
+        // accelerates AES, ChaCha20-Poly1305 otherwise.  a client that
+        // lists ChaCha20 first (typically a mobile device without AES
+        // instructions) gets it even on an AES capable server.
+        if (tls_has_aes_hw()) {
+            ciphers = "ECDHE+AESGCM:ECDHE+CHACHA20:HIGH:!aNULL";
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+            suites = "TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384:"
+                     "TLS_CHACHA20_POLY1305_SHA256";
+#endif
+        } else {
+            ciphers = "ECDHE+CHACHA20:ECDHE+AESGCM:HIGH:!aNULL";
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+            suites = "TLS_CHACHA20_POLY1305_SHA256:TLS_AES_128_GCM_SHA256:"
+                     "TLS_AES_256_GCM_SHA384";
+#endif
+        }
+#ifdef SSL_OP_PRIORITIZE_CHACHA
+        SSL_CTX_set_options(ctx, SSL_OP_PRIORITIZE_CHACHA);
+#endif
+        break;
     }
 
     if (SSL_CTX_set_cipher_list(ctx, ciphers) != 1) {
@@ -227,15 +368,26 @@ static inline int tls_set_cipher_suite(SSL_CTX *ctx, tls_cipher_suite_t suite)
     // TLS 1.3 ciphersuites are configured separately from the cipher list
     // for TLS 1.2 and below; set them explicitly so that the cipher policy
     // does not depend on the OpenSSL defaults. All TLS 1.3 ciphersuites are
-    // AEAD with equivalent strength, so every policy shares this list.
-    return SSL_CTX_set_ciphersuites(
-        ctx, "TLS_AES_256_GCM_SHA384:TLS_CHACHA20_POLY1305_SHA256:"
-             "TLS_AES_128_GCM_SHA256");
+    // AEAD with equivalent strength, so the policies only change the order.
+    return SSL_CTX_set_ciphersuites(ctx, suites);
 #else
     return 1;
 #endif
 }
 
+// set the TLS 1.3 ciphersuites explicitly, e.g. "TLS_AES_128_GCM_SHA256"
+static inline int tls_set_ciphersuites(SSL_CTX *ctx, const char *suites)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    return SSL_CTX_set_ciphersuites(ctx, suites);
+#else
+    // TLS 1.3 is not supported
+    (void)ctx;
+    (void)suites;
+    return 0;
+#endif
+}
+
 typedef enum {
     NET_TLS_PROTO_DEFAULT = 0,
     NET_TLS_PROTO_TLSv1,
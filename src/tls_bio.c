@@ -23,6 +23,7 @@
 #include <errno.h>
 #include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/socket.h>
 
 #include "lua_errno.h"
@@ -597,12 +598,59 @@ static BIO_METHOD *bio_tx_method_new(int type)
     return method;
 }
 
-tls_bio_t *tls_bio_new(lua_State *L, int fd, size_t cap)
+tls_biomem_t *tls_bio_detach(tls_bio_t *bio)
 {
-    int type       = bio_method_type();
+    tls_biomem_t *m = NULL;
+
+    if (!bio->rx.mem || !bio->tx.mem || !bio->rx_method || !bio->tx_method ||
+        !(m = malloc(sizeof(tls_biomem_t)))) {
+        return NULL;
+    }
+    *m = (tls_biomem_t){
+        .cap       = bio->rx.buf.cap,
+        .rx_method = bio->rx_method,
+        .tx_method = bio->tx_method,
+        .rx        = bio->rx.mem,
+        .tx        = bio->tx.mem,
+    };
+    bio->rx_method = NULL;
+    bio->tx_method = NULL;
+    bio->rx.mem    = NULL;
+    bio->tx.mem    = NULL;
+    zring_init(&bio->rx.buf, NULL, 0);
+    zring_init(&bio->tx.buf, NULL, 0);
+    return m;
+}
+
+static tls_bio_t *bio_adopt(lua_State *L, int fd, tls_biomem_t *m)
+{
+    tls_bio_t *bio = lua_newuserdata(L, sizeof(tls_bio_t));
+
+    *bio = (tls_bio_t){
+        .fd        = fd,
+        .ref       = LUA_NOREF,
+        .rx_method = m->rx_method,
+        .tx_method = m->tx_method,
+        .rx.mem    = m->rx,
+        .tx.mem    = m->tx,
+    };
+    // the previous connection may have left data in the rings
+    zring_init(&bio->rx.buf, m->rx->data, m->cap);
+    zring_init(&bio->tx.buf, m->tx->data, m->cap);
+    free(m);
+    lauxh_setmetatable(L, NET_TLS_BIO_MT);
+    bio->ref = lauxh_ref(L);
+    return bio;
+}
+
+tls_bio_t *tls_bio_new(lua_State *L, int fd, size_t cap, tls_biomem_t *m)
+{
+    int type       = 0;
     tls_bio_t *bio = NULL;
 
-    if (type == -1) {
+    if (m) {
+        return bio_adopt(L, fd, m);
+    } else if ((type = bio_method_type()) == -1) {
         // BIO type budget exhausted; the failure is not cached, so the
         // caller may retry with a later connection.
         return NULL;
@@ -32,6 +32,7 @@
 #include "lauxhlib.h"
 
 // local
+#include "tls_sslpool.h"
 #include "zring.h"
 
 #define NET_TLS_BIO_MT "net.tls.bio"
@@ -87,9 +88,25 @@ int tls_bio_setup(SSL *ssl, tls_bio_t *bio);
  * @param fd  Network socket file descriptor.
  * @param cap Capacity in bytes for both rx and tx buffers; must be > 0.  An
  *            unallocatable capacity yields NULL.
+ * @param m   Pooled rings of @p cap bytes to adopt instead of allocating new
+ *            ones, or NULL.  Ownership passes to the new instance, even on
+ *            failure.
  * @return    Pointer to the allocated tls_bio_t on success, or NULL on failure.
  */
-tls_bio_t *tls_bio_new(lua_State *L, int fd, size_t cap);
+tls_bio_t *tls_bio_new(lua_State *L, int fd, size_t cap, tls_biomem_t *m);
+
+/**
+ * @brief Move the buffers and BIO_METHODs out of @p bio so that another
+ * connection can adopt them with tls_bio_new().
+ *
+ * The SSL object using the BIOs must have released them first.  @p bio keeps
+ * its registry reference and must still be freed with tls_bio_free().
+ *
+ * @param bio BIO to detach the resources from.
+ * @return    Detached resources, or NULL if there are none or on allocation
+ *            failure, in which case @p bio is left untouched.
+ */
+tls_biomem_t *tls_bio_detach(tls_bio_t *bio);
 
 /**
  * @brief Free the BIO's associated buffers and release the Lua registry
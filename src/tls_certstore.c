@@ -0,0 +1,415 @@
+/**
+ *  Copyright (C) 2026 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * Registering a hostname only copies its certificate/key sources; the
+ * SSL_CTX is built by the first SNI lookup that hits it.  Loaded contexts
+ * are kept on an LRU list that is trimmed whenever the number of loaded
+ * contexts or their accounted size exceeds the configured limits.
+ */
+#include "tls_certstore.h"
+#include "tls_x509cache.h"
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+// a DNS name is at most 253 characters; leave room for a trailing dot
+#define CERTSTORE_MAX_NAME_LEN 255
+#define CERTSTORE_MIN_BUCKETS  64
+// approximate memory of an SSL_CTX without certificates, and of each parsed
+// certificate or key beyond its DER length (measured with OpenSSL 3.0)
+#define CERTSTORE_CTX_OVERHEAD 16384
+#define CERTSTORE_OBJ_OVERHEAD 3072
+
+static uint32_t hash_name(const char *name, size_t len)
+{
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * @brief Copy @p name into @p buf in lowercase without the trailing dot.
+ *
+ * @return Length of the normalised name, or 0 if it is empty or too long.
+ */
+static size_t normalize_name(char *buf, const char *name)
+{
+    size_t len = strlen(name);
+
+    if (len && name[len - 1] == '.') {
+        len--;
+    }
+    if (len == 0 || len > CERTSTORE_MAX_NAME_LEN) {
+        return 0;
+    }
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (char)tolower((unsigned char)name[i]);
+    }
+    buf[len] = 0;
+    return len;
+}
+
+static tls_certstore_entry_t **find_slot(tls_certstore_t *store,
+                                         const char *name, uint32_t hash)
+{
+    tls_certstore_entry_t **slot =
+        &store->buckets[hash & (store->nbucket - 1)];
+
+    while (*slot) {
+        if ((*slot)->hash == hash && strcmp((*slot)->name, name) == 0) {
+            break;
+        }
+        slot = &(*slot)->next;
+    }
+    return slot;
+}
+
+static int grow_buckets(tls_certstore_t *store)
+{
+    size_t nbucket                  = store->nbucket * 2;
+    tls_certstore_entry_t **buckets = NULL;
+
+    if (nbucket < store->nbucket) {
+        errno = ENOMEM;
+        return -1;
+    }
+    buckets = calloc(nbucket, sizeof(*buckets));
+    if (!buckets) {
+        return -1;
+    }
+
+    // rehash every entry into the new buckets
+    for (size_t i = 0; i < store->nbucket; i++) {
+        tls_certstore_entry_t *e = store->buckets[i];
+        while (e) {
+            tls_certstore_entry_t *next = e->next;
+            size_t idx                  = e->hash & (nbucket - 1);
+            e->next                     = buckets[idx];
+            buckets[idx]                = e;
+            e                           = next;
+        }
+    }
+    free(store->buckets);
+    store->buckets = buckets;
+    store->nbucket = nbucket;
+    return 0;
+}
+
+static void lru_unlink(tls_certstore_t *store, tls_certstore_entry_t *e)
+{
+    if (e->lru_prev) {
+        e->lru_prev->lru_next = e->lru_next;
+    } else if (store->lru_head == e) {
+        store->lru_head = e->lru_next;
+    }
+    if (e->lru_next) {
+        e->lru_next->lru_prev = e->lru_prev;
+    } else if (store->lru_tail == e) {
+        store->lru_tail = e->lru_prev;
+    }
+    e->lru_prev = NULL;
+    e->lru_next = NULL;
+}
+
+static void lru_push_front(tls_certstore_t *store, tls_certstore_entry_t *e)
+{
+    e->lru_prev = NULL;
+    e->lru_next = store->lru_head;
+    if (store->lru_head) {
+        store->lru_head->lru_prev = e;
+    }
+    store->lru_head = e;
+    if (!store->lru_tail) {
+        store->lru_tail = e;
+    }
+}
+
+static void unload_entry(tls_certstore_t *store, tls_certstore_entry_t *e)
+{
+    if (e->ctx) {
+        // SSL objects that switched to this context hold their own
+        // reference, so in-flight connections are not affected.
+        SSL_CTX_free(e->ctx);
+        e->ctx = NULL;
+        lru_unlink(store, e);
+        store->nloaded--;
+        store->loaded_bytes -= e->cost;
+        e->cost = 0;
+    }
+}
+
+static void free_entry(tls_certstore_t *store, tls_certstore_entry_t *e)
+{
+    unload_entry(store, e);
+    free(e->cert);
+    free(e->key);
+    free(e);
+}
+
+/**
+ * @brief Evict the least recently used contexts until the store fits its
+ * limits.  @p keep is never evicted so that the context being returned to
+ * the caller stays valid.
+ */
+static void evict(tls_certstore_t *store, tls_certstore_entry_t *keep)
+{
+    tls_certstore_entry_t *e = store->lru_tail;
+
+    while (e &&
+           ((store->max_contexts && store->nloaded > store->max_contexts) ||
+            (store->max_bytes && store->loaded_bytes > store->max_bytes))) {
+        tls_certstore_entry_t *prev = e->lru_prev;
+        if (e != keep) {
+            unload_entry(store, e);
+        }
+        e = prev;
+    }
+}
+
+// estimate the memory of a loaded context from the DER lengths of its
+// certificate, chain and key, since OpenSSL does not report it
+static size_t context_size(SSL_CTX *ctx)
+{
+    X509 *cert            = SSL_CTX_get0_certificate(ctx);
+    EVP_PKEY *pkey        = SSL_CTX_get0_privatekey(ctx);
+    STACK_OF(X509) *chain = NULL;
+    size_t size           = CERTSTORE_CTX_OVERHEAD;
+    int len               = 0;
+
+    if (cert && (len = i2d_X509(cert, NULL)) > 0) {
+        size += CERTSTORE_OBJ_OVERHEAD + (size_t)len;
+    }
+    if (pkey && (len = i2d_PrivateKey(pkey, NULL)) > 0) {
+        size += CERTSTORE_OBJ_OVERHEAD + (size_t)len;
+    }
+    if (SSL_CTX_get0_chain_certs(ctx, &chain) == 1) {
+        for (int i = 0; i < sk_X509_num(chain); i++) {
+            if ((len = i2d_X509(sk_X509_value(chain, i), NULL)) > 0) {
+                size += CERTSTORE_OBJ_OVERHEAD + (size_t)len;
+            }
+        }
+    }
+    return size;
+}
+
+static SSL_CTX *load_entry(tls_certstore_t *store, tls_certstore_entry_t *e)
+{
+    SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+
+    if (!ctx) {
+        return NULL;
+    } else if (tls_x509cache_use_chain(ctx, e->cert, e->cert_len) != 1 ||
+               tls_x509cache_use_key(ctx, e->key, e->key_len) != 1 ||
+               SSL_CTX_check_private_key(ctx) != 1 ||
+               (store->init_cb && store->init_cb(ctx, store->init_arg) != 1)) {
+        SSL_CTX_free(ctx);
+        return NULL;
+    }
+
+    e->ctx  = ctx;
+    e->cost = context_size(ctx);
+    store->nloaded++;
+    store->loaded_bytes += e->cost;
+    return ctx;
+}
+
+static char *dupmem(const char *src, size_t len)
+{
+    char *dst = malloc(len + 1);
+    if (dst) {
+        memcpy(dst, src, len);
+        dst[len] = 0;
+    }
+    return dst;
+}
+
+tls_certstore_t *tls_certstore_new(tls_certstore_init_cb init_cb,
+                                   void *init_arg)
+{
+    tls_certstore_t *store = calloc(1, sizeof(tls_certstore_t));
+
+    if (!store) {
+        return NULL;
+    }
+    store->buckets = calloc(CERTSTORE_MIN_BUCKETS, sizeof(*store->buckets));
+    if (!store->buckets) {
+        free(store);
+        return NULL;
+    }
+    store->nbucket  = CERTSTORE_MIN_BUCKETS;
+    store->init_cb  = init_cb;
+    store->init_arg = init_arg;
+    return store;
+}
+
+void tls_certstore_free(tls_certstore_t *store)
+{
+    if (!store) {
+        return;
+    }
+    for (size_t i = 0; i < store->nbucket; i++) {
+        tls_certstore_entry_t *e = store->buckets[i];
+        while (e) {
+            tls_certstore_entry_t *next = e->next;
+            free_entry(store, e);
+            e = next;
+        }
+    }
+    free(store->buckets);
+    free(store);
+}
+
+int tls_certstore_add(tls_certstore_t *store, const char *name,
+                      const char *cert, size_t cert_len, const char *key,
+                      size_t key_len)
+{
+    char buf[CERTSTORE_MAX_NAME_LEN + 1];
+    size_t len                   = normalize_name(buf, name);
+    uint32_t hash                = 0;
+    tls_certstore_entry_t **slot = NULL;
+    tls_certstore_entry_t *e     = NULL;
+
+    if (!len || !cert_len || !key_len) {
+        errno = EINVAL;
+        return -1;
+    }
+    hash = hash_name(buf, len);
+
+    e = calloc(1, sizeof(tls_certstore_entry_t) + len + 1);
+    if (!e) {
+        return -1;
+    }
+    e->hash     = hash;
+    e->cert     = dupmem(cert, cert_len);
+    e->cert_len = cert_len;
+    e->key      = dupmem(key, key_len);
+    e->key_len  = key_len;
+    memcpy(e->name, buf, len + 1);
+    if (!e->cert || !e->key) {
+        free_entry(store, e);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    slot = find_slot(store, buf, hash);
+    if (*slot) {
+        // replace the existing registration; its loaded context (if any) is
+        // released so the next lookup picks up the new certificate.
+        tls_certstore_entry_t *old = *slot;
+        e->next                    = old->next;
+        *slot                      = e;
+        free_entry(store, old);
+        return 0;
+    }
+
+    if (store->nentry >= store->nbucket) {
+        // a failed resize only makes the chains longer; keep going with the
+        // current buckets
+        grow_buckets(store);
+    }
+    slot    = &store->buckets[hash & (store->nbucket - 1)];
+    e->next = *slot;
+    *slot   = e;
+    store->nentry++;
+    return 0;
+}
+
+int tls_certstore_remove(tls_certstore_t *store, const char *name)
+{
+    char buf[CERTSTORE_MAX_NAME_LEN + 1];
+    size_t len                   = normalize_name(buf, name);
+    tls_certstore_entry_t **slot = NULL;
+    tls_certstore_entry_t *e     = NULL;
+
+    if (!len) {
+        return 0;
+    }
+    slot = find_slot(store, buf, hash_name(buf, len));
+    if (!(e = *slot)) {
+        return 0;
+    }
+    *slot = e->next;
+    free_entry(store, e);
+    store->nentry--;
+    return 1;
+}
+
+void tls_certstore_set_limits(tls_certstore_t *store, size_t max_contexts,
+                              size_t max_bytes)
+{
+    store->max_contexts = max_contexts;
+    store->max_bytes    = max_bytes;
+    evict(store, NULL);
+}
+
+static tls_certstore_entry_t *lookup(tls_certstore_t *store, const char *name)
+{
+    char buf[CERTSTORE_MAX_NAME_LEN + 1];
+    size_t len               = normalize_name(buf, name);
+    tls_certstore_entry_t *e = NULL;
+    char *dot                = NULL;
+
+    if (!len) {
+        return NULL;
+    } else if ((e = *find_slot(store, buf, hash_name(buf, len)))) {
+        return e;
+    }
+
+    // fall back to "*.<parent domain>"; the asterisk replaces exactly one
+    // label, so "a.b.example.com" does not match "*.example.com".
+    dot = strchr(buf, '.');
+    if (dot && dot != buf) {
+        size_t wlen = len - (size_t)(dot - buf) + 1;
+        memmove(buf + 1, dot, wlen);
+        buf[0] = '*';
+        e      = *find_slot(store, buf, hash_name(buf, wlen));
+    }
+    return e;
+}
+
+SSL_CTX *tls_certstore_get(tls_certstore_t *store, const char *name,
+                           int *found)
+{
+    tls_certstore_entry_t *e = lookup(store, name);
+
+    *found = e != NULL;
+    if (!e) {
+        return NULL;
+    } else if (e->ctx) {
+        // hot path: move to the front of the LRU list
+        if (store->lru_head != e) {
+            lru_unlink(store, e);
+            lru_push_front(store, e);
+        }
+        return e->ctx;
+    } else if (!load_entry(store, e)) {
+        return NULL;
+    }
+    lru_push_front(store, e);
+    evict(store, e);
+    return e->ctx;
+}
@@ -0,0 +1,145 @@
+/**
+ *  Copyright (C) 2026 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef net_tls_certstore_h
+#define net_tls_certstore_h
+
+#include <openssl/ssl.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief One hostname registered in a certificate store.
+ *
+ * The certificate and key sources are kept as registered (a file path or a
+ * PEM/DER blob); the SSL_CTX is only built on the first lookup that hits this
+ * entry and may be released again by the LRU eviction.
+ */
+typedef struct tls_certstore_entry_t {
+    struct tls_certstore_entry_t *next;     /**< hash chain */
+    struct tls_certstore_entry_t *lru_prev; /**< more recently used */
+    struct tls_certstore_entry_t *lru_next; /**< less recently used */
+    SSL_CTX *ctx;    /**< loaded context; NULL until first use */
+    size_t cost;     /**< estimated memory of ctx while loaded */
+    uint32_t hash;   /**< hash of name */
+    char *cert;      /**< certificate chain path or PEM/DER blob */
+    size_t cert_len; /**< length of cert */
+    char *key;       /**< private key path or PEM/DER blob */
+    size_t key_len;  /**< length of key */
+    char name[];     /**< lowercased hostname */
+} tls_certstore_entry_t;
+
+/**
+ * @brief Callback that applies the owner's per-context settings to a context
+ * that was just loaded by the store.
+ *
+ * @return 1 on success, 0 on failure.
+ */
+typedef int (*tls_certstore_init_cb)(SSL_CTX *ctx, void *arg);
+
+/**
+ * @brief Hostname to certificate map whose SSL_CTX objects are loaded on
+ * demand and bounded by an LRU list.
+ */
+typedef struct {
+    tls_certstore_entry_t **buckets; /**< hash buckets */
+    size_t nbucket;                  /**< number of buckets (power of two) */
+    size_t nentry;                   /**< number of registered hostnames */
+    size_t nloaded;                  /**< number of loaded contexts */
+    size_t loaded_bytes;             /**< sum of cost of loaded contexts */
+    size_t max_contexts;             /**< 0 means unlimited */
+    size_t max_bytes;                /**< 0 means unlimited */
+    tls_certstore_entry_t *lru_head; /**< most recently used */
+    tls_certstore_entry_t *lru_tail; /**< least recently used */
+    tls_certstore_init_cb init_cb;   /**< context initialiser */
+    void *init_arg;                  /**< argument of init_cb */
+} tls_certstore_t;
+
+/**
+ * @brief Allocate an empty certificate store.
+ *
+ * @param init_cb  Called for every context the store loads; may be NULL.
+ * @param init_arg Argument passed to init_cb.
+ * @return         New store, or NULL on allocation failure.
+ */
+tls_certstore_t *tls_certstore_new(tls_certstore_init_cb init_cb,
+                                   void *init_arg);
+
+/**
+ * @brief Release every entry and loaded context, then the store itself.
+ *
+ * Contexts that are still referenced by an SSL object stay alive until that
+ * SSL object is freed.
+ *
+ * @param store Store to free; may be NULL.
+ */
+void tls_certstore_free(tls_certstore_t *store);
+
+/**
+ * @brief Register (or replace) the certificate chain and private key for a
+ * hostname.  Nothing is parsed at this point.
+ *
+ * @p cert and @p key are treated as PEM/DER blobs when they look like one
+ * (see tls_x509cache_is_blob()), otherwise as file paths.  A hostname of the
+ * form "*.example.com" matches any single label in place of the asterisk.
+ *
+ * @return 0 on success, -1 with errno set on failure.
+ */
+int tls_certstore_add(tls_certstore_t *store, const char *name,
+                      const char *cert, size_t cert_len, const char *key,
+                      size_t key_len);
+
+/**
+ * @brief Remove the registration for a hostname.
+ *
+ * @return 1 if the hostname was registered, 0 otherwise.
+ */
+int tls_certstore_remove(tls_certstore_t *store, const char *name);
+
+/**
+ * @brief Update the LRU bounds and evict contexts that exceed them.
+ *
+ * @param max_contexts Maximum number of loaded contexts (0: unlimited).
+ * @param max_bytes    Maximum estimated memory of loaded contexts
+ *                     (0: unlimited).
+ */
+void tls_certstore_set_limits(tls_certstore_t *store, size_t max_contexts,
+                              size_t max_bytes);
+
+/**
+ * @brief Find the context for a hostname, loading it on first use.
+ *
+ * Falls back to a wildcard registration when there is no exact match.  The
+ * returned context is owned by the store; callers that keep it must take
+ * their own reference (SSL_set_SSL_CTX() does).
+ *
+ * @param store Store to search.
+ * @param name  Hostname sent by the client.
+ * @param found Set to 1 if the hostname is registered, even if loading
+ *              its context failed.
+ * @return      Loaded context, or NULL if not registered or not loadable.
+ *              In the latter case the OpenSSL error queue holds the reason.
+ */
+SSL_CTX *tls_certstore_get(tls_certstore_t *store, const char *name,
+                           int *found);
+
+#endif /* net_tls_certstore_h */
@@ -25,112 +25,209 @@
 #include "tls.h"
 // depend
 #include "lauxhlib.h"
+#include "lua_errno.h"
 // lua
 #include <lauxlib.h>
 // system
+#include <errno.h>
 #include <limits.h>
 #include <openssl/asn1.h>
 #include <openssl/bio.h>
 #include <openssl/err.h>
 #include <openssl/evp.h>
 #include <openssl/ocsp.h>
-#include <openssl/pem.h>
 #include <openssl/ssl.h>
 #include <openssl/x509.h>
 #include <openssl/x509_vfy.h>
 #include <openssl/x509v3.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 // set callback for ALPN (Application-Layer Protocol Negotiation) support
 // SSL_CTX_set_alpn_select_cb(ctx->sslctx, alpn_select_cb, ctx);
 // set callback for NPN (Next Protocol Negotiation) support
 // SSL_CTX_set_next_protos_advertised_cb(ctx->sslctx, npn_advertise_cb, ctx);
 
+static void free_ocsp_results(tls_client_t *c)
+{
+    while (c->ocsp_results) {
+        tls_ocsp_result_t *r = c->ocsp_results;
+        c->ocsp_results      = r->next;
+        OCSP_CERTID_free(r->certid);
+        free(r);
+    }
+    c->nocsp_result = 0;
+}
+
+// replace the certificate store while no offloaded handshake is verifying
+// a peer with it.  the reference to the store is taken over by the client.
+static int use_store(tls_client_t *c, const tls_x509store_t *store)
+{
+    int rv = 0;
+
+    pthread_rwlock_wrlock(&c->lock.config);
+    if ((rv = tls_x509cache_use_store(c->ctx, store)) == 1) {
+        // the results verified against the previous store are dropped before
+        // it is released, since a new store may reuse its address
+        free_ocsp_results(c);
+        tls_x509cache_release(c->castore);
+        c->castore = store;
+    } else {
+        tls_x509cache_release(store);
+    }
+    pthread_rwlock_unlock(&c->lock.config);
+    return rv;
+}
+
 static int set_crls(lua_State *L)
 {
-    tls_client_t *c          = luaL_checkudata(L, 1, NET_TLS_CLIENT_MT);
-    size_t len               = 0;
-    const char *crls         = luaL_checklstring(L, 2, &len);
-    X509_STORE *store        = SSL_CTX_get_cert_store(c->ctx);
-    BIO *bio                 = NULL;
-    STACK_OF(X509_INFO) *inf = NULL;
-    const char *errop        = NULL;
-    const char *errmsg       = NULL;
+    tls_client_t *c              = luaL_checkudata(L, 1, NET_TLS_CLIENT_MT);
+    size_t len                   = 0;
+    const char *crls             = luaL_checklstring(L, 2, &len);
+    const tls_x509store_t *store = NULL;
 
     // BIO_new_mem_buf takes int; refuse >INT_MAX to prevent truncation.
     // Not exercised by tests: allocating a 2GB PEM in CI is impractical.
     if (len > INT_MAX) {
-        errop  = "BIO_new_mem_buf";
-        errmsg = "CRL PEM buffer exceeds INT_MAX";
-        goto FAIL;
+        lua_pushboolean(L, 0);
+        tls_push_error(L, "BIO_new_mem_buf", "CRL PEM buffer exceeds INT_MAX");
+        return 2;
     }
-    bio = BIO_new_mem_buf((void *)crls, (int)len);
-    if (!bio) {
-        errop  = "BIO_new_mem_buf";
-        errmsg = "failed to create BIO";
-        goto FAIL;
+
+    // the store is shared with other clients, so a store that also holds
+    // the CRLs (PEM or DER) is derived from it instead of modifying it.
+    store = tls_x509cache_add_crl(c->castore, crls, len);
+    if (!store) {
+        lua_pushboolean(L, 0);
+        tls_push_error(L, "tls_x509cache_add_crl", "failed to add CRLs");
+        return 2;
+    } else if (use_store(c, store) != 1) {
+        lua_pushboolean(L, 0);
+        tls_push_error(L, "tls_x509cache_use_store",
+                       "failed to set certificate store");
+        return 2;
     }
+    lua_pushboolean(L, 1);
+    return 1;
+}
 
-    // read CRLs from PEM format
-    inf = PEM_X509_INFO_read_bio(bio, NULL, NULL, NULL);
-    if (!inf) {
-        errop  = "PEM_X509_INFO_read_bio";
-        errmsg = "failed to read CRLs";
-        goto FAIL;
+// verify the chain, then look up the revoked serial numbers in the CRL index
+static int crlindex_verify_cb(X509_STORE_CTX *x, void *arg)
+{
+    tls_client_t *c     = arg;
+    tls_crlindex_t *idx = NULL;
+    int rv              = X509_verify_cert(x);
+
+    if (rv > 0 && (idx = tls_crlindex_acquire(&c->crlindex))) {
+        rv = tls_crlindex_check(idx, x);
+        tls_crlindex_release(idx);
     }
+    return rv;
+}
 
-    // Add CRLs to the store.  X509_STORE_add_crl's failure branch is not
-    // covered from Lua: OpenSSL 3.x accepts duplicates, and other triggers
-    // (internal malloc failure, specially crafted CRLs) are not reachable
-    // from userspace.
-    for (int i = 0; i < sk_X509_INFO_num(inf); i++) {
-        X509_INFO *it = sk_X509_INFO_value(inf, i);
-        if (!it->crl) {
-            continue;
-        } else if (X509_STORE_add_crl(store, it->crl) != 1) {
-            errop  = "X509_STORE_add_crl";
-            errmsg = "failed to add CRL";
-            goto FAIL;
+static int add_crl_index(lua_State *L)
+{
+    tls_client_t *c          = luaL_checkudata(L, 1, NET_TLS_CLIENT_MT);
+    size_t len               = 0;
+    const char *src          = luaL_checklstring(L, 2, &len);
+    size_t ilen              = 0;
+    const char *isrc         = lauxh_optlstring(L, 3, NULL, &ilen);
+    STACK_OF(X509_CRL) *crls = sk_X509_CRL_new_null();
+    STACK_OF(X509) *issuers  = sk_X509_new_null();
+    tls_crlindex_t *base     = NULL;
+    tls_crlindex_t *idx      = NULL;
+    const char *errop        = NULL;
+    const char *errmsg       = NULL;
+
+    if (!crls || !issuers) {
+        errop  = "sk_new_null";
+        errmsg = "failed to allocate memory for CRLs";
+    } else if (tls_x509cache_read(src, len, NULL, crls) != 1) {
+        errop  = "tls_x509cache_read";
+        errmsg = "failed to read CRLs";
+    } else if (sk_X509_CRL_num(crls) == 0) {
+        errop  = "tls_x509cache_read";
+        errmsg = "no CRL found";
+    } else if (isrc && tls_x509cache_read(isrc, ilen, issuers, NULL) != 1) {
+        errop  = "tls_x509cache_read";
+        errmsg = "failed to read issuer certificates";
+    } else {
+        // the CRLs are parsed and indexed while verifications keep using
+        // the current index; the new index replaces it at once.
+        base = tls_crlindex_acquire(&c->crlindex);
+        idx  = tls_crlindex_add(base, crls, issuers,
+                                SSL_CTX_get_cert_store(c->ctx), &errmsg);
+        tls_crlindex_release(base);
+        if (!idx) {
+            errop = "tls_crlindex_add";
+        } else {
+            pthread_rwlock_wrlock(&c->lock.config);
+            tls_crlindex_swap(&c->crlindex, idx);
+            SSL_CTX_set_cert_verify_callback(c->ctx, crlindex_verify_cb, c);
+            pthread_rwlock_unlock(&c->lock.config);
         }
     }
+    sk_X509_CRL_pop_free(crls, X509_CRL_free);
+    sk_X509_pop_free(issuers, X509_free);
 
-    // enable CRL checking for the entire certificate chain and also enable CRL
-    // checking for leaf certificate
-    if (X509_STORE_set_flags(store, X509_V_FLAG_CRL_CHECK |
-                                        X509_V_FLAG_CRL_CHECK_ALL) != 1) {
-        errop  = "X509_STORE_set_flags";
-        errmsg = "failed to set CRL flags";
-        goto FAIL;
+    if (errop) {
+        lua_pushboolean(L, 0);
+        tls_push_error(L, errop, errmsg);
+        return 2;
     }
-
-    sk_X509_INFO_pop_free(inf, X509_INFO_free);
-    BIO_free(bio);
     lua_pushboolean(L, 1);
     return 1;
+}
 
-FAIL:
-    if (inf) {
-        sk_X509_INFO_pop_free(inf, X509_INFO_free);
-    }
-    if (bio) {
-        BIO_free(bio);
-    }
-    lua_pushboolean(L, 0);
-    tls_push_error(L, errop, errmsg);
-    return 2;
+static int clear_crl_index(lua_State *L)
+{
+    tls_client_t *c = luaL_checkudata(L, 1, NET_TLS_CLIENT_MT);
+
+    tls_crlindex_swap(&c->crlindex, NULL);
+    return 0;
+}
+
+static int get_crl_index_stats(lua_State *L)
+{
+    tls_client_t *c     = luaL_checkudata(L, 1, NET_TLS_CLIENT_MT);
+    tls_crlindex_t *idx = tls_crlindex_acquire(&c->crlindex);
+    size_t nissuer      = 0;
+    size_t nserial      = 0;
+
+    tls_crlindex_stats(idx, &nissuer, &nserial);
+    tls_crlindex_release(idx);
+    lua_createtable(L, 0, 2);
+    lauxh_pushint2tbl(L, "issuers", nissuer);
+    lauxh_pushint2tbl(L, "serials", nserial);
+    return 1;
 }
 
 static int load_verify_locations(lua_State *L)
 {
-    tls_client_t *c    = luaL_checkudata(L, 1, NET_TLS_CLIENT_MT);
-    const char *cafile = luaL_checkstring(L, 2);
-    const char *capath = luaL_checkstring(L, 3);
+    tls_client_t *c              = luaL_checkudata(L, 1, NET_TLS_CLIENT_MT);
+    size_t len                   = 0;
+    const char *cafile           = lauxh_optlstring(L, 2, NULL, &len);
+    const char *capath           = lauxh_optstring(L, 3, NULL);
+    const tls_x509store_t *store = NULL;
 
-    if (SSL_CTX_load_verify_locations(c->ctx, cafile, capath) != 1) {
+    if (!cafile && !capath) {
+        return lauxh_argerror(L, 2, "cafile or capath must be specified");
+    }
+
+    // CA files (or PEM/DER blobs) are parsed once per process and shared
+    store = tls_x509cache_add_ca(c->castore, cafile, len, capath);
+    if (!store) {
         lua_pushboolean(L, 0);
-        tls_push_error(L, "SSL_CTX_load_verify_locations",
+        tls_push_error(L, "tls_x509cache_add_ca",
                        "failed to load verify locations");
         return 2;
+    } else if (use_store(c, store) != 1) {
+        lua_pushboolean(L, 0);
+        tls_push_error(L, "tls_x509cache_use_store",
+                       "failed to set certificate store");
+        return 2;
     }
     lua_pushboolean(L, 1);
     return 1;
@@ -140,10 +237,111 @@ static int set_verify_depth_lua(lua_State *L)
 {
     tls_client_t *c = luaL_checkudata(L, 1, NET_TLS_CLIENT_MT);
     int depth       = lauxh_checkuinteger(L, 2);
+
+    pthread_rwlock_wrlock(&c->lock.config);
     SSL_CTX_set_verify_depth(c->ctx, depth);
+    pthread_rwlock_unlock(&c->lock.config);
+    tls_sslpool_flush(&c->pool);
     return 0;
 }
 
+static int set_groups_lua(lua_State *L)
+{
+    tls_client_t *c    = luaL_checkudata(L, 1, NET_TLS_CLIENT_MT);
+    const char *groups = luaL_checkstring(L, 2);
+    int rv             = 0;
+
+    // e.g. "X25519:P-256"; a key share is sent for the first group
+    pthread_rwlock_wrlock(&c->lock.config);
+    rv = SSL_CTX_set1_groups_list(c->ctx, groups);
+    pthread_rwlock_unlock(&c->lock.config);
+    tls_sslpool_flush(&c->pool);
+    if (rv != 1) {
+        lua_pushboolean(L, 0);
+        tls_push_error(L, "SSL_CTX_set1_groups_list",
+                       "failed to set key exchange groups");
+        return 2;
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+static int set_ciphersuites_lua(lua_State *L)
+{
+    tls_client_t *c    = luaL_checkudata(L, 1, NET_TLS_CLIENT_MT);
+    const char *suites = luaL_checkstring(L, 2);
+    int rv             = 0;
+
+    // replaces the TLS 1.3 ciphersuites of the cipher suite policy
+    pthread_rwlock_wrlock(&c->lock.config);
+    rv = tls_set_ciphersuites(c->ctx, suites);
+    pthread_rwlock_unlock(&c->lock.config);
+    tls_sslpool_flush(&c->pool);
+    if (rv != 1) {
+        lua_pushboolean(L, 0);
+        tls_push_error(L, "SSL_CTX_set_ciphersuites",
+                       "failed to set TLS 1.3 ciphersuites");
+        return 2;
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+static int set_sigalgs_lua(lua_State *L)
+{
+    tls_client_t *c     = luaL_checkudata(L, 1, NET_TLS_CLIENT_MT);
+    const char *sigalgs = luaL_checkstring(L, 2);
+    int rv              = 0;
+
+    // e.g. "ECDSA+SHA256:RSA-PSS+SHA256"
+    pthread_rwlock_wrlock(&c->lock.config);
+    rv = SSL_CTX_set1_sigalgs_list(c->ctx, sigalgs);
+    pthread_rwlock_unlock(&c->lock.config);
+    tls_sslpool_flush(&c->pool);
+    if (rv != 1) {
+        lua_pushboolean(L, 0);
+        tls_push_error(L, "SSL_CTX_set1_sigalgs_list",
+                       "failed to set signature algorithms");
+        return 2;
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+static int set_handshake_offload_lua(lua_State *L)
+{
+    tls_client_t *c = luaL_checkudata(L, 1, NET_TLS_CLIENT_MT);
+
+    // applies to the connections created afterwards
+    c->offload = lauxh_optboolean(L, 2, 1);
+    return 0;
+}
+
+static int set_shutdown_mode_lua(lua_State *L)
+{
+    tls_client_t *c = luaL_checkudata(L, 1, NET_TLS_CLIENT_MT);
+
+    // applies to the connections created afterwards
+    c->shutdown_mode = luaL_checkoption(L, 2, NULL, TLS_SHUTDOWN_MODES);
+    return 0;
+}
+
+static int set_ssl_pool_size_lua(lua_State *L)
+{
+    tls_client_t *c = luaL_checkudata(L, 1, NET_TLS_CLIENT_MT);
+    size_t n        = (size_t)lauxh_checkuinteger(L, 2);
+
+    // SSL objects and BIO buffers of closed connections are kept for the
+    // connections created afterwards; 0 disables the pool
+    if (tls_sslpool_set_max(&c->pool, n) != 0) {
+        lua_pushboolean(L, 0);
+        lua_errno_new(L, errno, "set_ssl_pool_size");
+        return 2;
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
 static int tostring_lua(lua_State *L)
 {
     lua_pushfstring(L, NET_TLS_CLIENT_MT ": %p", lua_touserdata(L, 1));
@@ -153,8 +351,14 @@ static int tostring_lua(lua_State *L)
 static int gc_lua(lua_State *L)
 {
     tls_client_t *c = luaL_checkudata(L, 1, NET_TLS_CLIENT_MT);
+    tls_sslpool_free(&c->pool);
     SSL_CTX_free(c->ctx);
     lauxh_unref(L, c->error_cb_ref);
+    free_ocsp_results(c);
+    tls_x509cache_release(c->castore);
+    c->castore = NULL;
+    tls_crlindex_swap(&c->crlindex, NULL);
+    tls_lock_destroy(&c->lock);
     return 0;
 }
 
@@ -171,6 +375,7 @@ typedef struct {
     ASN1_GENERALIZEDTIME *revtime;
     ASN1_GENERALIZEDTIME *thisupd;
     ASN1_GENERALIZEDTIME *nextupd;
+    unsigned char digest[SHA256_DIGEST_LENGTH];
     const char *errop;
     const char *errmsg;
 } ocsp_verify_ctx_t;
@@ -241,10 +446,95 @@ static int check_ocsp_response(ocsp_verify_ctx_t *ctx)
     return 0;
 }
 
-static int verify_ocsp_response(ocsp_verify_ctx_t *ctx, SSL *ssl)
+static time_t asn1_to_time(const ASN1_GENERALIZEDTIME *t, time_t now)
+{
+    int days = 0;
+    int secs = 0;
+
+    if (!t || !ASN1_TIME_diff(&days, &secs, NULL, t)) {
+        return 0;
+    }
+    return now + (time_t)days * 86400 + secs;
+}
+
+// find the result of the same response that was verified for the same
+// certificate against the same trust store.
+static int find_ocsp_result(tls_client_t *c, ocsp_verify_ctx_t *ctx,
+                            time_t now)
+{
+    tls_ocsp_result_t **slot = &c->ocsp_results;
+
+    while (*slot) {
+        tls_ocsp_result_t *r = *slot;
+
+        if (now >= r->expires || r->store != c->castore) {
+            // expired or verified against a replaced store
+            *slot = r->next;
+            OCSP_CERTID_free(r->certid);
+            free(r);
+            c->nocsp_result--;
+            continue;
+        } else if (memcmp(r->digest, ctx->digest, sizeof(r->digest)) == 0 &&
+                   OCSP_id_cmp(r->certid, ctx->certid) == 0) {
+            // move to front
+            *slot           = r->next;
+            r->next         = c->ocsp_results;
+            c->ocsp_results = r;
+            ctx->status     = r->status;
+            return 1;
+        }
+        slot = &r->next;
+    }
+    return 0;
+}
+
+static void save_ocsp_result(tls_client_t *c, ocsp_verify_ctx_t *ctx,
+                             time_t now)
+{
+    const long maxage    = 14 * 24 * 60 * 60;
+    time_t thisupd       = asn1_to_time(ctx->thisupd, now);
+    time_t expires       = asn1_to_time(ctx->nextupd, now);
+    tls_ocsp_result_t *r = NULL;
+
+    // a response without nextUpdate must be checked every time
+    if (!expires || !thisupd || (ctx->status != V_OCSP_CERTSTATUS_GOOD &&
+                                 ctx->status != V_OCSP_CERTSTATUS_REVOKED)) {
+        return;
+    } else if (expires > thisupd + maxage) {
+        expires = thisupd + maxage;
+    }
+    if (expires <= now || !(r = malloc(sizeof(tls_ocsp_result_t)))) {
+        return;
+    } else if (!(r->certid = OCSP_CERTID_dup(ctx->certid))) {
+        free(r);
+        return;
+    }
+    memcpy(r->digest, ctx->digest, sizeof(r->digest));
+    r->store        = c->castore;
+    r->expires      = expires;
+    r->status       = ctx->status;
+    r->next         = c->ocsp_results;
+    c->ocsp_results = r;
+
+    // drop the least recently used result
+    if (++c->nocsp_result > TLS_OCSP_RESULT_CACHE_SIZE) {
+        tls_ocsp_result_t **slot = &c->ocsp_results;
+        while ((*slot)->next) {
+            slot = &(*slot)->next;
+        }
+        OCSP_CERTID_free((*slot)->certid);
+        free(*slot);
+        *slot = NULL;
+        c->nocsp_result--;
+    }
+}
+
+static int verify_ocsp_response(ocsp_verify_ctx_t *ctx, SSL *ssl,
+                                tls_client_t *c)
 {
     const unsigned char *raw = NULL;
     int size                 = SSL_get_tlsext_status_ocsp_resp(ssl, &raw);
+    time_t now               = time(NULL);
 
     ctx->ssl = ssl;
     if (size <= 0) {
@@ -252,13 +542,6 @@ static int verify_ocsp_response(ocsp_verify_ctx_t *ctx, SSL *ssl)
         return 1;
     }
 
-    ctx->resp = d2i_OCSP_RESPONSE(NULL, &raw, size);
-    if (!ctx->resp) {
-        ctx->errop  = "d2i_OCSP_RESPONSE";
-        ctx->errmsg = "failed to decode OCSP response";
-        return -1;
-    }
-
     ctx->store = SSL_CTX_get_cert_store(SSL_get_SSL_CTX(ssl));
     ctx->cert  = SSL_get_peer_certificate(ssl);
     if (!ctx->cert) {
@@ -277,14 +560,41 @@ static int verify_ocsp_response(ocsp_verify_ctx_t *ctx, SSL *ssl)
     for (int i = 0; i < sk_X509_num(ctx->chain); i++) {
         X509 *issuer = sk_X509_value(ctx->chain, i);
         if (X509_check_issued(issuer, ctx->cert) == X509_V_OK) {
-            ctx->certid = OCSP_cert_to_id(EVP_sha1(), ctx->cert, issuer);
+            ctx->certid = OCSP_cert_to_id(tls_digest_sha1(), ctx->cert, issuer);
             if (!ctx->certid) {
                 int err     = ERR_get_error();
                 ctx->errop  = "OCSP_cert_to_id";
                 ctx->errmsg = ERR_error_string(err, NULL);
                 return -1;
             }
-            return check_ocsp_response(ctx);
+
+            // skip parsing and verifying a response that has already been
+            // verified until its nextUpdate
+            if (EVP_Digest(raw, size, ctx->digest, NULL, tls_digest_sha256(),
+                           NULL) == 1) {
+                int found = 0;
+
+                pthread_mutex_lock(&c->lock.cache);
+                found = find_ocsp_result(c, ctx, now);
+                pthread_mutex_unlock(&c->lock.cache);
+                if (found) {
+                    return 0;
+                }
+            }
+            ERR_clear_error();
+
+            ctx->resp = d2i_OCSP_RESPONSE(NULL, &raw, size);
+            if (!ctx->resp) {
+                ctx->errop  = "d2i_OCSP_RESPONSE";
+                ctx->errmsg = "failed to decode OCSP response";
+                return -1;
+            } else if (check_ocsp_response(ctx) != 0) {
+                return -1;
+            }
+            pthread_mutex_lock(&c->lock.cache);
+            save_ocsp_result(c, ctx, now);
+            pthread_mutex_unlock(&c->lock.cache);
+            return 0;
         }
     }
     ctx->errop  = "X509_check_issued";
@@ -318,7 +628,7 @@ static int ocsp_verify_cb(SSL *ssl, void *arg)
 {
     tls_client_t *c       = arg;
     ocsp_verify_ctx_t ctx = {0};
-    int rc                = verify_ocsp_response(&ctx, ssl);
+    int rc                = verify_ocsp_response(&ctx, ssl, c);
 
     if (rc == 0) {
         switch (ctx.status) {
@@ -384,14 +694,28 @@ static int new_lua(lua_State *L)
     }
 
     // create context
-    c               = lua_newuserdata(L, sizeof(tls_client_t));
-    c->L            = L;
-    c->error_cb_ref = LUA_NOREF;
+    c                = lua_newuserdata(L, sizeof(tls_client_t));
+    c->L             = L;
+    c->error_cb_ref  = LUA_NOREF;
+    c->castore       = NULL;
+    c->ocsp_results  = NULL;
+    c->nocsp_result  = 0;
+    c->crlindex      = NULL;
+    c->offload       = 0;
+    c->shutdown_mode = NET_TLS_SHUTDOWN_FULL;
+    tls_sslpool_init(&c->pool);
+    tls_openssl_init();
     c->ctx          = SSL_CTX_new(TLS_client_method());
     if (!c->ctx) {
         errop  = "SSL_CTX_new";
         errmsg = "failed to create SSL_CTX";
         goto FAIL;
+    } else if (tls_lock_init(&c->lock) != 0) {
+        SSL_CTX_free(c->ctx);
+        c->ctx = NULL;
+        errop  = "tls_lock_init";
+        errmsg = "failed to initialize locks";
+        goto FAIL;
     }
 
     // set mode
@@ -429,9 +753,11 @@ static int new_lua(lua_State *L)
         SSL_CTX_set_num_tickets(c->ctx, 2);
     }
 
-    // set default verify certificate locations
-    if (SSL_CTX_set_default_verify_paths(c->ctx) != 1) {
-        errop  = "SSL_CTX_set_default_verify_paths";
+    // set default verify certificate locations; the default CA bundle is
+    // parsed once and its store is shared by every client.
+    c->castore = tls_x509cache_default_store();
+    if (!c->castore || tls_x509cache_use_store(c->ctx, c->castore) != 1) {
+        errop  = "tls_x509cache_default_store";
         errmsg = "failed to set default verify paths";
         goto FAIL;
     }
@@ -468,6 +794,8 @@ static int new_lua(lua_State *L)
 FAIL:
     if (c && c->ctx) {
         SSL_CTX_free(c->ctx);
+        tls_x509cache_release(c->castore);
+        tls_lock_destroy(&c->lock);
     }
     lua_pushnil(L);
     tls_push_error(L, errop, errmsg);
@@ -482,10 +810,19 @@ LUALIB_API int luaopen_net_tls_client(lua_State *L)
         {NULL,         NULL        }
     };
     struct luaL_Reg method[] = {
-        {"set_verify_depth",      set_verify_depth_lua },
-        {"load_verify_locations", load_verify_locations},
-        {"set_crls",              set_crls             },
-        {NULL,                    NULL                 }
+        {"set_verify_depth",      set_verify_depth_lua     },
+        {"load_verify_locations", load_verify_locations    },
+        {"set_crls",              set_crls                 },
+        {"add_crl_index",         add_crl_index            },
+        {"clear_crl_index",       clear_crl_index          },
+        {"get_crl_index_stats",   get_crl_index_stats      },
+        {"set_groups",            set_groups_lua           },
+        {"set_sigalgs",           set_sigalgs_lua          },
+        {"set_ciphersuites",      set_ciphersuites_lua     },
+        {"set_handshake_offload", set_handshake_offload_lua},
+        {"set_shutdown_mode",     set_shutdown_mode_lua    },
+        {"set_ssl_pool_size",     set_ssl_pool_size_lua    },
+        {NULL,                    NULL                     }
     };
 
     luaL_newmetatable(L, NET_TLS_CLIENT_MT);
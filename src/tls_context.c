@@ -45,6 +45,8 @@
 #include <openssl/x509_vfy.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 
 static int do_handshake(lua_State *L, tls_ctx_t *ctx)
@@ -112,6 +114,191 @@ static int handshake_bio_lua(lua_State *L, tls_ctx_t *ctx)
     }
 }
 
+/**
+ * @brief Handshake step run on a worker thread of tls_offload.h.  The result
+ * is kept in the job, since the OpenSSL error queue is per thread.
+ */
+typedef struct {
+    tls_offload_job_t job;
+    tls_ctx_t *ctx;
+    int rv;
+    int sslerr;
+    int inline_only; // the step needs a Lua callback; run it inline instead
+    char errmsg[256];
+} handshake_job_t;
+
+// handshakes that may call a Lua callback function must run on the thread
+// of the Lua state, so they are never offloaded.  the OCSP status callback
+// does not call Lua, but it records certificates in the response cache that
+// refresh_ocsp() walks without the lock.
+static int is_offloadable(tls_ctx_t *ctx)
+{
+    if (ctx->handshake_cb == SSL_accept) {
+        tls_server_t *s = (tls_server_t *)ctx->parent;
+        return s->sni_callback_ref == LUA_NOREF &&
+               s->ocsp_callback_ref == LUA_NOREF;
+    }
+    return ((tls_client_t *)ctx->parent)->error_cb_ref == LUA_NOREF;
+}
+
+static tls_lock_t *get_parent_lock(tls_ctx_t *ctx)
+{
+    if (ctx->handshake_cb == SSL_accept) {
+        return &((tls_server_t *)ctx->parent)->lock;
+    }
+    return &((tls_client_t *)ctx->parent)->lock;
+}
+
+static tls_sslpool_t *get_parent_pool(tls_ctx_t *ctx, SSL_CTX **sslctx)
+{
+    if (ctx->handshake_cb == SSL_accept) {
+        tls_server_t *s = (tls_server_t *)ctx->parent;
+        *sslctx         = s->ctx;
+        return &s->pool;
+    }
+    *sslctx = ((tls_client_t *)ctx->parent)->ctx;
+    return &((tls_client_t *)ctx->parent)->pool;
+}
+
+static void handshake_job_run(tls_offload_job_t *job)
+{
+    handshake_job_t *hj = (handshake_job_t *)job;
+    tls_ctx_t *ctx      = hj->ctx;
+    tls_lock_t *lock    = get_parent_lock(ctx);
+
+    // the configuration of the parent may not change during the step
+    pthread_rwlock_rdlock(&lock->config);
+    hj->errmsg[0] = 0;
+    if (!(hj->inline_only = !is_offloadable(ctx))) {
+        ERR_clear_error();
+        errno      = 0;
+        hj->rv     = ctx->handshake_cb(ctx->ssl);
+        hj->sslerr = (hj->rv == 1) ? SSL_ERROR_NONE :
+                                     SSL_get_error(ctx->ssl, hj->rv);
+        if (hj->sslerr == SSL_ERROR_SSL || hj->sslerr == SSL_ERROR_SYSCALL) {
+            unsigned long err = ERR_peek_last_error();
+
+            if (err) {
+                ERR_error_string_n(err, hj->errmsg, sizeof(hj->errmsg));
+            } else if (errno) {
+                snprintf(hj->errmsg, sizeof(hj->errmsg), "%s",
+                         strerror(errno));
+            }
+        }
+        ERR_clear_error();
+    }
+    pthread_rwlock_unlock(&lock->config);
+}
+
+// the step was running when the process forked; the worker that held the
+// locks of the parent does not exist in the child
+static void handshake_job_reset(tls_offload_job_t *job)
+{
+    tls_lock_init(get_parent_lock(((handshake_job_t *)job)->ctx));
+}
+
+static void free_handshake_job(tls_ctx_t *ctx)
+{
+    if (ctx->job) {
+        tls_offload_job_destroy(ctx->job);
+        free(ctx->job);
+        ctx->job = NULL;
+    }
+}
+
+static int new_handshake_job(tls_ctx_t *ctx)
+{
+    handshake_job_t *hj = malloc(sizeof(handshake_job_t));
+
+    if (!hj) {
+        return -1;
+    }
+    tls_offload_job_init(&hj->job, handshake_job_run, handshake_job_reset);
+    hj->ctx  = ctx;
+    ctx->job = &hj->job;
+    return 0;
+}
+
+// returns the number of values pushed, or -1 to run the step inline
+static int handshake_offload_lua(lua_State *L, tls_ctx_t *ctx)
+{
+    handshake_job_t *hj = (handshake_job_t *)ctx->job;
+    const char *op      = NULL;
+    const char *msg     = NULL;
+
+    switch (tls_offload_collect(ctx->job)) {
+    case TLS_OFFLOAD_QUEUED:
+    case TLS_OFFLOAD_RUNNING:
+        // wait for the async fd to become readable
+        lua_pushboolean(L, 0);
+        lua_pushnil(L);
+        lua_pushinteger(L, SSL_ERROR_WANT_ASYNC);
+        return 3;
+
+    case TLS_OFFLOAD_DONE:
+        if (hj->inline_only) {
+            break;
+        }
+        switch (hj->sslerr) {
+        case SSL_ERROR_NONE:
+            // handshake success; the remaining I/O runs on this thread
+            free_handshake_job(ctx);
+            ctx->handshake_cb = NULL;
+            lua_pushboolean(L, 1);
+            return 1;
+
+        case SSL_ERROR_WANT_READ:
+        case SSL_ERROR_WANT_WRITE:
+            lua_pushboolean(L, 0);
+            lua_pushnil(L);
+            lua_pushinteger(L, hj->sslerr);
+            return 3;
+
+        case SSL_ERROR_ZERO_RETURN:
+            // connection closed
+            return 0;
+        }
+
+        // error occurred; use the same operation names and default messages
+        // as the handshake on this thread
+        lua_pushboolean(L, 0);
+        if (ctx->handshake_cb == SSL_connect) {
+            op  = ctx->bio ? "SSL_connect" : "handshake.SSL_connect";
+            msg = "failed to initiate SSL/TLS handshake with server";
+        } else {
+            op  = ctx->bio ? "SSL_accept" : "handshake.SSL_accept";
+            msg = "failed to initiate SSL/TLS handshake with client";
+        }
+        tls_push_error(L, op, hj->errmsg[0] ? hj->errmsg : msg);
+        return 2;
+
+    case TLS_OFFLOAD_FAILED:
+        // the process forked while the step was queued or running, so the
+        // state of the SSL object is unknown in this process
+        lua_pushboolean(L, 0);
+        lua_errno_new(L, ECANCELED, "handshake");
+        return 2;
+
+    default:
+        if (!is_offloadable(ctx)) {
+            break;
+        } else if (tls_offload_submit(ctx->job) != 0) {
+            lua_pushboolean(L, 0);
+            lua_errno_new(L, errno, "handshake");
+            return 2;
+        }
+        lua_pushboolean(L, 0);
+        lua_pushnil(L);
+        lua_pushinteger(L, SSL_ERROR_WANT_ASYNC);
+        return 3;
+    }
+
+    // a Lua callback function was set after the context was created; the
+    // rest of the handshake runs on this thread
+    free_handshake_job(ctx);
+    return -1;
+}
+
 static int handshake_lua(lua_State *L)
 {
     tls_ctx_t *ctx = luaL_checkudata(L, 1, NET_TLS_CONTEXT_MT);
@@ -124,6 +311,8 @@ static int handshake_lua(lua_State *L)
     } else if (!ctx->handshake_cb) {
         lua_pushboolean(L, 1);
         return 1;
+    } else if (ctx->job && (rv = handshake_offload_lua(L, ctx)) >= 0) {
+        return rv;
     }
 
     ERR_clear_error();
@@ -165,6 +354,17 @@ static int handshake_lua(lua_State *L)
     return 1;
 }
 
+// the SSL object is owned by a worker thread while the handshake is queued
+// or running
+static inline int is_busy(tls_ctx_t *ctx)
+{
+    if (ctx->job) {
+        tls_offload_state_t state = tls_offload_get_state(ctx->job);
+        return state == TLS_OFFLOAD_QUEUED || state == TLS_OFFLOAD_RUNNING;
+    }
+    return 0;
+}
+
 static int write_bio_lua(lua_State *L, tls_ctx_t *ctx, const char *buf,
                          size_t len)
 {
@@ -226,6 +426,10 @@ static int write_lua(lua_State *L)
         lua_pushnil(L);
         lua_errno_new(L, EINVAL, "write");
         return 2;
+    } else if (is_busy(ctx)) {
+        lua_pushnil(L);
+        lua_errno_new(L, EBUSY, "write");
+        return 2;
     } else if (len == 0) {
         // nothing to write
         lua_pushinteger(L, 0);
@@ -311,6 +515,10 @@ static int read_lua(lua_State *L)
         lua_pushnil(L);
         lua_errno_new(L, EINVAL, "read");
         return 2;
+    } else if (is_busy(ctx)) {
+        lua_pushnil(L);
+        lua_errno_new(L, EBUSY, "read");
+        return 2;
     }
 
     // bufsiz < 0 means "use the default buffer size"
@@ -358,11 +566,21 @@ static int read_lua(lua_State *L)
 /**
  * @brief Release the SSL object after a completed shutdown.  The BIO buffers
  * are kept so the caller can drain the final close_notify ciphertext before
- * disposing of the context with close().
+ * disposing of the context with close().  The SSL object is returned to the
+ * pool of the parent if it has one.
  */
 static void cleanup_ssl(tls_ctx_t *ctx)
 {
-    SSL_free(ctx->ssl); /* also frees rxbio and txbio */
+    // wait for the worker thread to release the SSL object
+    free_handshake_job(ctx);
+    if (ctx->ssl && ctx->parent) {
+        SSL_CTX *sslctx     = NULL;
+        tls_sslpool_t *pool = get_parent_pool(ctx, &sslctx);
+        /* also frees rxbio and txbio */
+        tls_sslpool_put_ssl(pool, sslctx, ctx->ssl);
+    } else {
+        SSL_free(ctx->ssl); /* also frees rxbio and txbio */
+    }
     ctx->ssl = NULL;
 }
 
@@ -370,6 +588,16 @@ static void cleanup_context(lua_State *L, tls_ctx_t *ctx)
 {
     cleanup_ssl(ctx);
     if (ctx->bio) {
+        SSL_CTX *sslctx     = NULL;
+        tls_sslpool_t *pool = NULL;
+        tls_biomem_t *m     = NULL;
+
+        if (ctx->parent) {
+            pool = get_parent_pool(ctx, &sslctx);
+            if (pool->max && (m = tls_bio_detach(ctx->bio))) {
+                tls_sslpool_put_bio(pool, m);
+            }
+        }
         tls_bio_free(L, ctx->bio);
         ctx->bio = NULL;
     }
@@ -392,6 +620,15 @@ static int close_lua(lua_State *L)
     return 1;
 }
 
+// the fast and quiet modes close without waiting for the peer
+static int shutdown_done_lua(lua_State *L, tls_ctx_t *ctx)
+{
+    ERR_clear_error();
+    cleanup_ssl(ctx);
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
 static int shutdown_bio_lua(lua_State *L, tls_ctx_t *ctx)
 {
     // SSL was fully connected — exchange close_notify with the peer.
@@ -415,6 +652,11 @@ RETRY:
         // Our close_notify was written to txbuf
         // user needs to send it to the peer and wait for the peer's
         // close_notify then retry SSL_shutdown to complete the shutdown
+        if (ctx->shutdown_mode != NET_TLS_SHUTDOWN_FULL) {
+            // the caller drains the close_notify without waiting for the
+            // peer's one
+            return shutdown_done_lua(L, ctx);
+        }
         lua_pushboolean(L, 0);
         lua_pushnil(L);
         lua_pushinteger(L, SSL_ERROR_WANT_WRITE);
@@ -423,6 +665,12 @@ RETRY:
 
     // rv < 0 indicates an error; determine if it's retryable or fatal
     rv = SSL_get_error(ctx->ssl, rv);
+    if (ctx->shutdown_mode != NET_TLS_SHUTDOWN_FULL &&
+        (rv == SSL_ERROR_WANT_WRITE || rv == SSL_ERROR_WANT_READ)) {
+        // do not wait for the socket or the peer; the close_notify may
+        // not have been written if the TX ring is full
+        return shutdown_done_lua(L, ctx);
+    }
     switch (rv) {
     case SSL_ERROR_WANT_WRITE:
         lua_pushboolean(L, 0);
@@ -473,12 +721,20 @@ static int shutdown_lua(lua_State *L)
     } else if (ctx->handshake_cb) {
         // if handshake_cb is not NULL, the handshake is not complete and the
         // peer has no state about this connection, so there is nothing to
-        // shut down; the caller disposes of the context with close().
+        // shut down even if an offloaded handshake is still running; the
+        // caller disposes of the context with close().
         lua_pushboolean(L, 1);
         return 1;
+    } else if (is_busy(ctx)) {
+        lua_pushboolean(L, 0);
+        lua_errno_new(L, EBUSY, "shutdown");
+        return 2;
     }
 
     ERR_clear_error();
+    // set on every call since pooled SSL objects keep the previous mode
+    SSL_set_quiet_shutdown(ctx->ssl,
+                           ctx->shutdown_mode == NET_TLS_SHUTDOWN_QUIET);
     if (ctx->bio) {
         return shutdown_bio_lua(L, ctx);
     }
@@ -496,6 +752,10 @@ static int shutdown_lua(lua_State *L)
     switch (rv) {
     case SSL_ERROR_WANT_READ:
     case SSL_ERROR_WANT_WRITE:
+        if (ctx->shutdown_mode != NET_TLS_SHUTDOWN_FULL) {
+            // do not wait for the socket; the close_notify is dropped
+            return shutdown_done_lua(L, ctx);
+        }
         lua_pushboolean(L, 0);
         lua_pushnil(L);
         lua_pushinteger(L, rv);
@@ -509,6 +769,22 @@ static int shutdown_lua(lua_State *L)
     }
 }
 
+static int set_shutdown_mode_lua(lua_State *L)
+{
+    tls_ctx_t *ctx = lauxh_checkudata(L, 1, NET_TLS_CONTEXT_MT);
+
+    ctx->shutdown_mode = luaL_checkoption(L, 2, NULL, TLS_SHUTDOWN_MODES);
+    return 0;
+}
+
+static int get_shutdown_mode_lua(lua_State *L)
+{
+    tls_ctx_t *ctx = lauxh_checkudata(L, 1, NET_TLS_CONTEXT_MT);
+
+    lua_pushstring(L, TLS_SHUTDOWN_MODES[ctx->shutdown_mode]);
+    return 1;
+}
+
 static int get_bio_lua(lua_State *L)
 {
     tls_ctx_t *ctx = lauxh_checkudata(L, 1, NET_TLS_CONTEXT_MT);
@@ -546,6 +822,36 @@ static int get_alpn_lua(lua_State *L)
     return 1;
 }
 
+static int get_cipher_lua(lua_State *L)
+{
+    tls_ctx_t *ctx         = lauxh_checkudata(L, 1, NET_TLS_CONTEXT_MT);
+    const SSL_CIPHER *ciph = NULL;
+
+    if (!ctx->ssl) {
+        lua_pushnil(L);
+        lua_errno_new(L, EINVAL, "get_cipher");
+        return 2;
+    } else if (is_busy(ctx) || !(ciph = SSL_get_current_cipher(ctx->ssl))) {
+        // no cipher is negotiated yet
+        return 0;
+    }
+    lua_pushstring(L, SSL_CIPHER_get_name(ciph));
+    return 1;
+}
+
+static int get_async_fd_lua(lua_State *L)
+{
+    tls_ctx_t *ctx = lauxh_checkudata(L, 1, NET_TLS_CONTEXT_MT);
+
+    // readable when the offloaded handshake step has finished; a job holds
+    // the descriptor only while a step is in flight
+    if (ctx->job && ctx->job->fd[0] != -1) {
+        lua_pushinteger(L, ctx->job->fd[0]);
+        return 1;
+    }
+    return 0;
+}
+
 static int tostring_lua(lua_State *L)
 {
     lua_pushfstring(L, NET_TLS_CONTEXT_MT ": %p", lua_touserdata(L, 1));
@@ -630,24 +936,33 @@ static int accept_lua(lua_State *L)
     }
     fd = (int)fdarg;
 
-    ctx               = lua_newuserdata(L, sizeof(tls_ctx_t));
-    ctx->handshake_cb = SSL_accept;
-    ctx->parent       = s;
-    ctx->ssl          = SSL_new(s->ctx);
-    ctx->bio          = NULL;
-    ctx->parent_ref   = LUA_NOREF;
+    ctx                = lua_newuserdata(L, sizeof(tls_ctx_t));
+    ctx->handshake_cb  = SSL_accept;
+    ctx->parent        = s;
+    ctx->ssl           = tls_sslpool_get_ssl(&s->pool, s->ctx);
+    ctx->bio           = NULL;
+    ctx->parent_ref    = LUA_NOREF;
+    ctx->job           = NULL;
+    ctx->shutdown_mode = s->shutdown_mode;
     lauxh_setmetatable(L, NET_TLS_CONTEXT_MT);
     ctx->parent_ref = lauxh_refat(L, 1);
 
     if (!ctx->ssl) {
         errop  = "accept.SSL_new";
         errmsg = "failed to create SSL context";
+    } else if (s->offload && new_handshake_job(ctx) != 0) {
+        lua_pushnil(L);
+        lua_errno_new(L, errno, "accept");
+        cleanup_context(L, ctx);
+        return 2;
     } else if (use_bio) {
-        size_t cap = get_bio_bufcap(ctx->ssl, bufcap);
+        size_t cap      = get_bio_bufcap(ctx->ssl, bufcap);
+        tls_biomem_t *m = tls_sslpool_get_bio(&s->pool, cap);
 
         // if BIOs are used, SSL won't touch the fd directly, so we need to set
         // up the BIOs to enable the handshake and data exchange to work
-        if (!(ctx->bio = tls_bio_new(L, fd, cap))) {
+
+        if (!(ctx->bio = tls_bio_new(L, fd, cap, m))) {
             errop  = "accept.tls_bio_new";
             errmsg = "failed to create tls_bio for SSL context";
         } else if (tls_bio_setup(ctx->ssl, ctx->bio) != 0) {
@@ -685,6 +1000,14 @@ static int noverify_time_cb(int preverify_ok, X509_STORE_CTX *x509_ctx)
     return preverify_ok;
 }
 
+// same as the default verification; SSL_set_verify() keeps the callback if
+// NULL is passed, so a pooled SSL object would keep noverify_time_cb
+static int verify_cb(int preverify_ok, X509_STORE_CTX *x509_ctx)
+{
+    (void)x509_ctx;
+    return preverify_ok;
+}
+
 static int connect_lua(lua_State *L)
 {
     tls_client_t *c        = luaL_checkudata(L, 1, NET_TLS_CLIENT_MT);
@@ -721,12 +1044,14 @@ static int connect_lua(lua_State *L)
     }
     fd = (int)fdarg;
 
-    ctx               = lua_newuserdata(L, sizeof(tls_ctx_t));
-    ctx->handshake_cb = SSL_connect;
-    ctx->parent       = c;
-    ctx->ssl          = SSL_new(c->ctx);
-    ctx->bio          = NULL;
-    ctx->parent_ref   = LUA_NOREF;
+    ctx                = lua_newuserdata(L, sizeof(tls_ctx_t));
+    ctx->handshake_cb  = SSL_connect;
+    ctx->parent        = c;
+    ctx->ssl           = tls_sslpool_get_ssl(&c->pool, c->ctx);
+    ctx->bio           = NULL;
+    ctx->parent_ref    = LUA_NOREF;
+    ctx->job           = NULL;
+    ctx->shutdown_mode = c->shutdown_mode;
     lauxh_setmetatable(L, NET_TLS_CONTEXT_MT);
     ctx->parent_ref = lauxh_refat(L, 1);
 
@@ -734,6 +1059,11 @@ static int connect_lua(lua_State *L)
         errop  = "connect.SSL_new";
         errmsg = "failed to create SSL context";
         goto FAIL;
+    } else if (c->offload && new_handshake_job(ctx) != 0) {
+        lua_pushnil(L);
+        lua_errno_new(L, errno, "connect");
+        cleanup_context(L, ctx);
+        return 2;
     }
 
     // The caller asked for hostname verification (noverify_name=0) but did
@@ -771,20 +1101,23 @@ static int connect_lua(lua_State *L)
         }
     }
 
+    // the SSL object may come from the pool, so always set the callback
     if (noverify_cert) {
         // ignore server certificate error
-        SSL_set_verify(ctx->ssl, SSL_VERIFY_NONE, NULL);
+        SSL_set_verify(ctx->ssl, SSL_VERIFY_NONE, verify_cb);
     } else if (noverify_time) {
         // ignore server certificate expired error by callback
         SSL_set_verify(ctx->ssl, SSL_VERIFY_PEER, noverify_time_cb);
     } else {
         // verify server certificate
-        SSL_set_verify(ctx->ssl, SSL_VERIFY_PEER, NULL);
+        SSL_set_verify(ctx->ssl, SSL_VERIFY_PEER, verify_cb);
     }
 
     if (use_bio) {
-        size_t cap = get_bio_bufcap(ctx->ssl, bufcap);
-        if (!(ctx->bio = tls_bio_new(L, fd, cap))) {
+        size_t cap      = get_bio_bufcap(ctx->ssl, bufcap);
+        tls_biomem_t *m = tls_sslpool_get_bio(&c->pool, cap);
+
+        if (!(ctx->bio = tls_bio_new(L, fd, cap, m))) {
             errop  = "connect.tls_bio_new";
             errmsg = "failed to create tls_bio for SSL context";
         } else if (tls_bio_setup(ctx->ssl, ctx->bio) != 0) {
@@ -810,6 +1143,27 @@ FAIL:
     return 2;
 }
 
+static int set_offload_threads_lua(lua_State *L)
+{
+    lua_Integer n = lauxh_checkinteger(L, 1);
+
+    if (n < 0) {
+        return lauxh_argerror(L, 1, "threads must be >= 0");
+    } else if (tls_offload_set_threads((size_t)n) != 0) {
+        lua_pushboolean(L, 0);
+        lua_errno_new(L, errno, "set_offload_threads");
+        return 2;
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+static int get_offload_threads_lua(lua_State *L)
+{
+    lua_pushinteger(L, (lua_Integer)tls_offload_get_threads());
+    return 1;
+}
+
 LUALIB_API int luaopen_net_tls_context(lua_State *L)
 {
     struct luaL_Reg mmethod[] = {
@@ -818,14 +1172,18 @@ LUALIB_API int luaopen_net_tls_context(lua_State *L)
         {NULL,         NULL        }
     };
     struct luaL_Reg method[] = {
-        {"get_alpn",  get_alpn_lua },
-        {"get_bio",   get_bio_lua  },
-        {"read",      read_lua     },
-        {"write",     write_lua    },
-        {"close",     close_lua    },
-        {"shutdown",  shutdown_lua },
-        {"handshake", handshake_lua},
-        {NULL,        NULL         }
+        {"get_alpn",          get_alpn_lua         },
+        {"get_cipher",        get_cipher_lua       },
+        {"get_bio",           get_bio_lua          },
+        {"get_async_fd",      get_async_fd_lua     },
+        {"read",              read_lua             },
+        {"write",             write_lua            },
+        {"close",             close_lua            },
+        {"shutdown",          shutdown_lua         },
+        {"set_shutdown_mode", set_shutdown_mode_lua},
+        {"get_shutdown_mode", get_shutdown_mode_lua},
+        {"handshake",         handshake_lua        },
+        {NULL,                NULL                 }
     };
 
     luaL_newmetatable(L, NET_TLS_CONTEXT_MT);
@@ -843,12 +1201,16 @@ LUALIB_API int luaopen_net_tls_context(lua_State *L)
     tls_init(L);
     tls_bio_init(L);
 
-    lua_createtable(L, 0, 5);
+    lua_createtable(L, 0, 8);
     lauxh_pushfn2tbl(L, "accept", accept_lua);
     lauxh_pushfn2tbl(L, "connect", connect_lua);
     lauxh_pushfn2tbl(L, "encrypted_length", encrypted_length_lua);
+    lauxh_pushfn2tbl(L, "set_offload_threads", set_offload_threads_lua);
+    lauxh_pushfn2tbl(L, "get_offload_threads", get_offload_threads_lua);
     /* keep constants for backward compatibility with lib/tls.lua */
     lauxh_pushint2tbl(L, "WANT_READ", SSL_ERROR_WANT_READ);
     lauxh_pushint2tbl(L, "WANT_WRITE", SSL_ERROR_WANT_WRITE);
+    // the handshake is running on a worker thread; see get_async_fd()
+    lauxh_pushint2tbl(L, "WANT_ASYNC", SSL_ERROR_WANT_ASYNC);
     return 1;
 }
@@ -0,0 +1,485 @@
+/**
+ *  Copyright (C) 2026 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * Each issuer set is an open addressing hash table of serial numbers whose
+ * bytes live in one pool, so a set of hundreds of thousands of entries costs
+ * two allocations and a lookup touches one or two slots.  The parsed CRLs
+ * are released as soon as their serial numbers have been copied.
+ */
+#include "tls_crlindex.h"
+#include "tls_digest.h"
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/x509v3.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// SHA-256 of the issuer public key
+#define CRLINDEX_KEYLEN    32
+#define CRLINDEX_MIN_SLOTS 16
+
+typedef struct {
+    uint64_t hash;
+    size_t off;    /**< offset of the serial number in the pool */
+    uint32_t len;  /**< length of the serial number */
+    uint32_t used; /**< non-zero if the slot holds a serial number */
+} crlslot_t;
+
+typedef struct {
+    size_t refs;
+    X509_NAME *issuer;
+    unsigned char keyid[CRLINDEX_KEYLEN];
+    time_t next_update; /**< earliest nextUpdate of the CRLs; 0 if absent */
+    size_t nserial;
+    size_t mask; /**< number of slots - 1 */
+    crlslot_t *slots;
+    unsigned char *pool;
+} crlset_t;
+
+struct tls_crlindex_t {
+    size_t refs;
+    size_t nset;
+    size_t nserial;
+    crlset_t **sets;
+};
+
+/** @brief CRLs of one issuer key that are merged into one set. */
+typedef struct {
+    X509_NAME *issuer; /**< borrowed from the first CRL */
+    unsigned char keyid[CRLINDEX_KEYLEN];
+    STACK_OF(X509_CRL) *crls;
+} crlgroup_t;
+
+// guards the reference counts of indexes and sets
+static pthread_mutex_t IndexLock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t hash_serial(const unsigned char *data, size_t len)
+{
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static time_t to_time(const ASN1_TIME *t, time_t now)
+{
+    int days = 0;
+    int secs = 0;
+
+    if (!t || !ASN1_TIME_diff(&days, &secs, NULL, t)) {
+        return 0;
+    }
+    return now + (time_t)days * 86400 + secs;
+}
+
+static void free_set(crlset_t *set)
+{
+    X509_NAME_free(set->issuer);
+    free(set->slots);
+    free(set->pool);
+    free(set);
+}
+
+static int find_serial(const crlset_t *set, const unsigned char *data,
+                       size_t len, uint64_t hash, size_t *pos)
+{
+    size_t i = hash & set->mask;
+
+    for (; set->slots[i].used; i = (i + 1) & set->mask) {
+        const crlslot_t *s = set->slots + i;
+        if (s->hash == hash && s->len == len &&
+            memcmp(set->pool + s->off, data, len) == 0) {
+            return 1;
+        }
+    }
+    *pos = i;
+    return 0;
+}
+
+static void add_serial(crlset_t *set, const ASN1_INTEGER *serial,
+                       size_t *used)
+{
+    const unsigned char *data = ASN1_STRING_get0_data(serial);
+    size_t len                = (size_t)ASN1_STRING_length(serial);
+    uint64_t hash             = hash_serial(data, len);
+    size_t pos                = 0;
+
+    // partitioned CRLs may list the same serial number more than once
+    if (!find_serial(set, data, len, hash, &pos)) {
+        crlslot_t *s = set->slots + pos;
+        memcpy(set->pool + *used, data, len);
+        s->hash = hash;
+        s->off  = *used;
+        s->len  = (uint32_t)len;
+        s->used = 1;
+        *used += len;
+        set->nserial++;
+    }
+}
+
+static crlset_t *new_set(const crlgroup_t *g, time_t now)
+{
+    crlset_t *set = calloc(1, sizeof(crlset_t));
+    size_t total  = 0;
+    size_t poolsz = 0;
+    size_t nslot  = CRLINDEX_MIN_SLOTS;
+    size_t used   = 0;
+
+    if (!set) {
+        return NULL;
+    }
+    set->refs = 1;
+    memcpy(set->keyid, g->keyid, CRLINDEX_KEYLEN);
+
+    for (int i = 0; i < sk_X509_CRL_num(g->crls); i++) {
+        X509_CRL *crl                   = sk_X509_CRL_value(g->crls, i);
+        STACK_OF(X509_REVOKED) *revoked = X509_CRL_get_REVOKED(crl);
+        time_t nextupd                  = 0;
+
+        for (int j = 0; j < sk_X509_REVOKED_num(revoked); j++) {
+            X509_REVOKED *r = sk_X509_REVOKED_value(revoked, j);
+            poolsz += (size_t)ASN1_STRING_length(
+                X509_REVOKED_get0_serialNumber(r));
+            total++;
+        }
+        nextupd = to_time(X509_CRL_get0_nextUpdate(crl), now);
+        if (nextupd && (!set->next_update || nextupd < set->next_update)) {
+            set->next_update = nextupd;
+        }
+    }
+
+    // keep the load factor at most 1/2
+    while (nslot < total * 2) {
+        nslot <<= 1;
+    }
+    set->mask = nslot - 1;
+    if (!(set->issuer = X509_NAME_dup(g->issuer)) ||
+        !(set->slots = calloc(nslot, sizeof(crlslot_t))) ||
+        (poolsz && !(set->pool = malloc(poolsz)))) {
+        free_set(set);
+        return NULL;
+    }
+
+    for (int i = 0; i < sk_X509_CRL_num(g->crls); i++) {
+        STACK_OF(X509_REVOKED) *revoked =
+            X509_CRL_get_REVOKED(sk_X509_CRL_value(g->crls, i));
+        for (int j = 0; j < sk_X509_REVOKED_num(revoked); j++) {
+            X509_REVOKED *r = sk_X509_REVOKED_value(revoked, j);
+            add_serial(set, X509_REVOKED_get0_serialNumber(r), &used);
+        }
+    }
+    return set;
+}
+
+static int verify_crl(X509_CRL *crl, STACK_OF(X509) *certs,
+                      unsigned char *keyid)
+{
+    X509_NAME *name = X509_CRL_get_issuer(crl);
+
+    for (int i = 0; i < sk_X509_num(certs); i++) {
+        X509 *cert       = sk_X509_value(certs, i);
+        EVP_PKEY *pkey   = NULL;
+        unsigned int len = 0;
+
+        if (X509_NAME_cmp(X509_get_subject_name(cert), name) == 0 &&
+            (pkey = X509_get0_pubkey(cert)) &&
+            X509_CRL_verify(crl, pkey) == 1 &&
+            X509_pubkey_digest(cert, tls_digest_sha256(), keyid, &len) == 1) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Verify the signature of @p crl with a certificate of its issuer and
+ * get the digest of the public key of that certificate.
+ */
+static int find_signer(X509_CRL *crl, STACK_OF(X509) *issuers,
+                       X509_STORE *store, unsigned char *keyid)
+{
+    int found = issuers && verify_crl(crl, issuers, keyid);
+
+    if (!found && store) {
+        X509_STORE_CTX *sctx  = X509_STORE_CTX_new();
+        STACK_OF(X509) *certs = NULL;
+
+        if (sctx && X509_STORE_CTX_init(sctx, store, NULL, NULL) == 1 &&
+            (certs = X509_STORE_CTX_get1_certs(sctx,
+                                               X509_CRL_get_issuer(crl)))) {
+            found = verify_crl(crl, certs, keyid);
+            sk_X509_pop_free(certs, X509_free);
+        }
+        X509_STORE_CTX_free(sctx);
+    }
+    if (found) {
+        // discard the errors of the candidates that did not match
+        ERR_clear_error();
+    }
+    return found;
+}
+
+static crlgroup_t *get_group(crlgroup_t *groups, size_t *ngroup,
+                             X509_CRL *crl, const unsigned char *keyid)
+{
+    X509_NAME *name = X509_CRL_get_issuer(crl);
+    crlgroup_t *g   = NULL;
+
+    for (size_t i = 0; i < *ngroup; i++) {
+        g = groups + i;
+        if (memcmp(g->keyid, keyid, CRLINDEX_KEYLEN) == 0 &&
+            X509_NAME_cmp(g->issuer, name) == 0) {
+            return g;
+        }
+    }
+    g = groups + *ngroup;
+    if (!(g->crls = sk_X509_CRL_new_null())) {
+        return NULL;
+    }
+    g->issuer = name;
+    memcpy(g->keyid, keyid, CRLINDEX_KEYLEN);
+    (*ngroup)++;
+    return g;
+}
+
+static int is_replaced(const crlset_t *set, const crlgroup_t *groups,
+                       size_t ngroup)
+{
+    for (size_t i = 0; i < ngroup; i++) {
+        if (memcmp(set->keyid, groups[i].keyid, CRLINDEX_KEYLEN) == 0 &&
+            X509_NAME_cmp(set->issuer, groups[i].issuer) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+tls_crlindex_t *tls_crlindex_add(const tls_crlindex_t *base,
+                                 STACK_OF(X509_CRL) *crls,
+                                 STACK_OF(X509) *issuers, X509_STORE *store,
+                                 const char **errmsg)
+{
+    int ncrl            = sk_X509_CRL_num(crls);
+    size_t nbase        = base ? base->nset : 0;
+    crlgroup_t *groups  = calloc(ncrl > 0 ? (size_t)ncrl : 1,
+                                 sizeof(crlgroup_t));
+    size_t ngroup       = 0;
+    tls_crlindex_t *idx = NULL;
+    time_t now          = time(NULL);
+
+    *errmsg = "failed to allocate memory for CRL index";
+    if (!groups) {
+        return NULL;
+    }
+
+    for (int i = 0; i < ncrl; i++) {
+        X509_CRL *crl = sk_X509_CRL_value(crls, i);
+        unsigned char keyid[CRLINDEX_KEYLEN];
+        crlgroup_t *g = NULL;
+
+        if (X509_CRL_get_ext_by_NID(crl, NID_delta_crl, -1) >= 0) {
+            *errmsg = "delta CRLs are not supported";
+            goto DONE;
+        } else if (!find_signer(crl, issuers, store, keyid)) {
+            *errmsg = "failed to verify CRL with its issuer certificate";
+            goto DONE;
+        } else if (!(g = get_group(groups, &ngroup, crl, keyid)) ||
+                   sk_X509_CRL_push(g->crls, crl) <= 0) {
+            goto DONE;
+        }
+    }
+
+    if (!(idx = calloc(1, sizeof(tls_crlindex_t))) ||
+        !(idx->sets = calloc(nbase + ngroup + 1, sizeof(crlset_t *)))) {
+        free(idx);
+        idx = NULL;
+        goto DONE;
+    }
+    idx->refs = 1;
+
+    // share the sets of the issuers that are not reloaded
+    pthread_mutex_lock(&IndexLock);
+    for (size_t i = 0; i < nbase; i++) {
+        crlset_t *set = base->sets[i];
+        if (!is_replaced(set, groups, ngroup)) {
+            set->refs++;
+            idx->sets[idx->nset++] = set;
+            idx->nserial += set->nserial;
+        }
+    }
+    pthread_mutex_unlock(&IndexLock);
+
+    for (size_t i = 0; i < ngroup; i++) {
+        crlset_t *set = new_set(groups + i, now);
+        if (!set) {
+            tls_crlindex_release(idx);
+            idx = NULL;
+            goto DONE;
+        }
+        idx->sets[idx->nset++] = set;
+        idx->nserial += set->nserial;
+    }
+    *errmsg = NULL;
+
+DONE:
+    for (size_t i = 0; i < ngroup; i++) {
+        sk_X509_CRL_free(groups[i].crls);
+    }
+    free(groups);
+    return idx;
+}
+
+void tls_crlindex_release(tls_crlindex_t *idx)
+{
+    size_t nfree = 0;
+    size_t refs  = 0;
+
+    if (!idx) {
+        return;
+    }
+
+    pthread_mutex_lock(&IndexLock);
+    refs = --idx->refs;
+    if (refs == 0) {
+        // move the sets that are no longer shared to the front
+        for (size_t i = 0; i < idx->nset; i++) {
+            if (--idx->sets[i]->refs == 0) {
+                idx->sets[nfree++] = idx->sets[i];
+            }
+        }
+    }
+    pthread_mutex_unlock(&IndexLock);
+
+    if (refs == 0) {
+        for (size_t i = 0; i < nfree; i++) {
+            free_set(idx->sets[i]);
+        }
+        free(idx->sets);
+        free(idx);
+    }
+}
+
+void tls_crlindex_swap(tls_crlindex_t **slot, tls_crlindex_t *idx)
+{
+    tls_crlindex_t *old = NULL;
+
+    pthread_mutex_lock(&IndexLock);
+    old   = *slot;
+    *slot = idx;
+    pthread_mutex_unlock(&IndexLock);
+    tls_crlindex_release(old);
+}
+
+tls_crlindex_t *tls_crlindex_acquire(tls_crlindex_t **slot)
+{
+    tls_crlindex_t *idx = NULL;
+
+    pthread_mutex_lock(&IndexLock);
+    if ((idx = *slot)) {
+        idx->refs++;
+    }
+    pthread_mutex_unlock(&IndexLock);
+    return idx;
+}
+
+static const crlset_t *find_set(const tls_crlindex_t *idx, X509 *issuer)
+{
+    X509_NAME *name = X509_get_subject_name(issuer);
+    unsigned char keyid[CRLINDEX_KEYLEN];
+    int has_keyid = 0;
+
+    for (size_t i = 0; i < idx->nset; i++) {
+        const crlset_t *set = idx->sets[i];
+        if (X509_NAME_cmp(set->issuer, name) == 0) {
+            if (!has_keyid) {
+                const EVP_MD *md = tls_digest_sha256();
+                unsigned int len = 0;
+                if (X509_pubkey_digest(issuer, md, keyid, &len) != 1) {
+                    return NULL;
+                }
+                has_keyid = 1;
+            }
+            if (memcmp(set->keyid, keyid, CRLINDEX_KEYLEN) == 0) {
+                return set;
+            }
+        }
+    }
+    return NULL;
+}
+
+int tls_crlindex_check(const tls_crlindex_t *idx, X509_STORE_CTX *x)
+{
+    STACK_OF(X509) *chain = X509_STORE_CTX_get0_chain(x);
+    int n                 = sk_X509_num(chain);
+    time_t now            = time(NULL);
+
+    for (int i = 0; i < n; i++) {
+        X509 *cert          = sk_X509_value(chain, i);
+        X509 *issuer        = (i + 1 < n) ? sk_X509_value(chain, i + 1) : cert;
+        const crlset_t *set = NULL;
+        int err             = X509_V_OK;
+
+        if (i + 1 == n && X509_check_issued(cert, cert) != X509_V_OK) {
+            // the issuer of the top of a partial chain is unknown
+            break;
+        } else if (!(set = find_set(idx, issuer))) {
+            continue;
+        } else if (set->next_update && now >= set->next_update) {
+            err = X509_V_ERR_CRL_HAS_EXPIRED;
+        } else {
+            const ASN1_INTEGER *serial = X509_get0_serialNumber(cert);
+            const unsigned char *data  = ASN1_STRING_get0_data(serial);
+            size_t len                 = (size_t)ASN1_STRING_length(serial);
+            size_t pos                 = 0;
+
+            if (find_serial(set, data, len, hash_serial(data, len), &pos)) {
+                err = X509_V_ERR_CERT_REVOKED;
+            }
+        }
+
+        if (err != X509_V_OK) {
+            // let the verify callback decide, as the built-in CRL check does
+            X509_STORE_CTX_verify_cb cb = X509_STORE_CTX_get_verify_cb(x);
+            X509_STORE_CTX_set_error_depth(x, i);
+            X509_STORE_CTX_set_current_cert(x, cert);
+            X509_STORE_CTX_set_error(x, err);
+            if (!cb || !cb(0, x)) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+void tls_crlindex_stats(const tls_crlindex_t *idx, size_t *nissuer,
+                        size_t *nserial)
+{
+    *nissuer = idx ? idx->nset : 0;
+    *nserial = idx ? idx->nserial : 0;
+}
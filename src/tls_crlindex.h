@@ -0,0 +1,95 @@
+/**
+ *  Copyright (C) 2026 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef net_tls_crlindex_h
+#define net_tls_crlindex_h
+
+#include <openssl/x509.h>
+#include <stddef.h>
+
+/**
+ * @brief Immutable index of revoked serial numbers, one hash set per CRL
+ * issuer.
+ *
+ * An index is never modified once built; loading more CRLs derives a new
+ * index that shares the unchanged issuer sets with its base, and the new
+ * index is published by tls_crlindex_swap().  Indexes are reference counted
+ * so that a verification in progress keeps using the index it acquired.
+ */
+typedef struct tls_crlindex_t tls_crlindex_t;
+
+/**
+ * @brief Derive a new index from @p base plus the CRLs in @p crls.
+ *
+ * The signature of each CRL is verified with a certificate of its issuer
+ * found in @p issuers or @p store, and the set is bound to the public key of
+ * that certificate.  CRLs of the same issuer in @p crls are merged, and
+ * replace the set of that issuer in @p base.
+ *
+ * @param base    Index to start from; may be NULL.
+ * @param issuers Certificates used to verify the CRLs; may be NULL.
+ * @param store   Store to look up the issuers in; may be NULL.
+ * @param errmsg  Set to the reason on failure.
+ * @return        New index with one reference, or NULL on failure.
+ */
+tls_crlindex_t *tls_crlindex_add(const tls_crlindex_t *base,
+                                 STACK_OF(X509_CRL) *crls,
+                                 STACK_OF(X509) *issuers, X509_STORE *store,
+                                 const char **errmsg);
+
+/**
+ * @brief Publish @p idx in @p slot and release the previous index.
+ *
+ * @param idx Index whose reference is moved to @p slot; may be NULL.
+ */
+void tls_crlindex_swap(tls_crlindex_t **slot, tls_crlindex_t *idx);
+
+/**
+ * @brief Take a reference to the index published in @p slot.
+ *
+ * @return Index, or NULL if none is published.
+ */
+tls_crlindex_t *tls_crlindex_acquire(tls_crlindex_t **slot);
+
+/**
+ * @brief Release a reference taken by tls_crlindex_acquire().
+ */
+void tls_crlindex_release(tls_crlindex_t *idx);
+
+/**
+ * @brief Check the verified chain of @p x against @p idx.
+ *
+ * A revoked certificate, or a certificate whose issuer set has passed its
+ * nextUpdate, is reported to the verify callback of @p x as
+ * X509_V_ERR_CERT_REVOKED or X509_V_ERR_CRL_HAS_EXPIRED.
+ *
+ * @return 1 if the chain is accepted, 0 otherwise.
+ */
+int tls_crlindex_check(const tls_crlindex_t *idx, X509_STORE_CTX *x);
+
+/**
+ * @brief Get the number of issuers and revoked serial numbers in @p idx.
+ */
+void tls_crlindex_stats(const tls_crlindex_t *idx, size_t *nissuer,
+                        size_t *nserial);
+
+#endif /* net_tls_crlindex_h */
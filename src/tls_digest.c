@@ -0,0 +1,66 @@
+/**
+ *  Copyright (C) 2026 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * Digests fetched once from the default providers.  The fetched objects are
+ * kept for the lifetime of the process, like the certificate stores of
+ * tls_x509cache.c.
+ */
+#include "tls_digest.h"
+#include <pthread.h>
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+
+static pthread_once_t FetchOnce = PTHREAD_ONCE_INIT;
+static EVP_MD *SHA1             = NULL;
+static EVP_MD *SHA256           = NULL;
+
+static void fetch_digests(void)
+{
+    SHA1   = EVP_MD_fetch(NULL, "SHA1", NULL);
+    SHA256 = EVP_MD_fetch(NULL, "SHA2-256", NULL);
+}
+
+const EVP_MD *tls_digest_sha1(void)
+{
+    pthread_once(&FetchOnce, fetch_digests);
+    return SHA1 ? SHA1 : EVP_sha1();
+}
+
+const EVP_MD *tls_digest_sha256(void)
+{
+    pthread_once(&FetchOnce, fetch_digests);
+    return SHA256 ? SHA256 : EVP_sha256();
+}
+
+#else
+
+const EVP_MD *tls_digest_sha1(void)
+{
+    return EVP_sha1();
+}
+
+const EVP_MD *tls_digest_sha256(void)
+{
+    return EVP_sha256();
+}
+
+#endif
@@ -0,0 +1,43 @@
+/**
+ *  Copyright (C) 2026 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef net_tls_digest_h
+#define net_tls_digest_h
+
+#include <openssl/evp.h>
+
+/**
+ * @brief Return the SHA-1 message digest.
+ *
+ * On OpenSSL 3, EVP_sha1() and its friends make every operation that uses
+ * them fetch the implementation from the providers again.  These functions
+ * fetch it once per process instead, and fall back to the built-in objects
+ * when the fetch fails or on older versions.
+ */
+const EVP_MD *tls_digest_sha1(void);
+
+/**
+ * @brief Return the SHA-256 message digest.  See tls_digest_sha1().
+ */
+const EVP_MD *tls_digest_sha256(void);
+
+#endif /* net_tls_digest_h */
@@ -0,0 +1,389 @@
+/**
+ *  Copyright (C) 2026 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * Process-wide pool of detached worker threads fed from a FIFO queue.  The
+ * workers block every signal so that signal handling stays on the threads
+ * that run Lua.  After fork(2) the child has no workers, so the pool is
+ * reset and restarted by the next submission; the jobs that were queued or
+ * running in the parent fail with TLS_OFFLOAD_FAILED in the child.
+ *
+ * A job holds a notification descriptor (an eventfd on Linux, a pipe
+ * elsewhere) only from its submission until its result is collected, and
+ * the descriptors are recycled, so that the number of descriptors follows
+ * the number of steps in flight rather than the number of connections.
+ */
+#define _GNU_SOURCE
+#include "tls_offload.h"
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <unistd.h>
+#if defined(__linux__)
+# include <sys/eventfd.h>
+#endif
+
+// number of idle notification descriptors kept for reuse
+#define TLS_OFFLOAD_MAX_SPARE 64
+
+static pthread_mutex_t PoolLock   = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t PoolReady   = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t PoolDone    = PTHREAD_COND_INITIALIZER;
+static tls_offload_job_t *Head    = NULL;
+static tls_offload_job_t *Tail    = NULL;
+static tls_offload_job_t *Running = NULL; // jobs taken by the workers
+static size_t NThread             = 0; // configured; 0 for the CPU count
+static size_t NStarted            = 0;
+static int AtforkRegistered       = 0;
+static int Spare[TLS_OFFLOAD_MAX_SPARE][2]; // idle notification descriptors
+static size_t NSpare = 0;
+
+// make fd readable; must be called with PoolLock held
+static void notify(int fd)
+{
+#if defined(__linux__)
+    uint64_t v = 1;
+#else
+    char v = 0;
+#endif
+
+    while (write(fd, &v, sizeof(v)) == -1 && errno == EINTR) {
+    }
+}
+
+static void atfork_prepare(void)
+{
+    pthread_mutex_lock(&PoolLock);
+}
+
+static void atfork_parent(void)
+{
+    pthread_mutex_unlock(&PoolLock);
+}
+
+// must be called with PoolLock held
+static void fail_jobs(tls_offload_job_t *job)
+{
+    while (job) {
+        tls_offload_job_t *next = job->next;
+
+        job->next  = NULL;
+        job->state = TLS_OFFLOAD_FAILED;
+        notify(job->fd[1]);
+        job = next;
+    }
+}
+
+static void atfork_child(void)
+{
+    tls_offload_job_t *job = Running;
+
+    // the workers of the parent do not exist in the child, so the locks that
+    // they held are never released and their jobs never finish
+    for (; job; job = job->next) {
+        if (job->reset) {
+            job->reset(job);
+        }
+    }
+    fail_jobs(Running);
+    fail_jobs(Head);
+    Running  = NULL;
+    Head     = NULL;
+    Tail     = NULL;
+    NStarted = 0;
+    pthread_cond_init(&PoolReady, NULL);
+    pthread_cond_init(&PoolDone, NULL);
+    pthread_mutex_unlock(&PoolLock);
+}
+
+static void *worker(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&PoolLock);
+    while (1) {
+        tls_offload_job_t *job   = NULL;
+        tls_offload_job_t **slot = NULL;
+
+        while (!Head) {
+            pthread_cond_wait(&PoolReady, &PoolLock);
+        }
+        job  = Head;
+        Head = job->next;
+        if (!Head) {
+            Tail = NULL;
+        }
+        job->next  = Running;
+        job->state = TLS_OFFLOAD_RUNNING;
+        Running    = job;
+        pthread_mutex_unlock(&PoolLock);
+
+        job->run(job);
+
+        pthread_mutex_lock(&PoolLock);
+        for (slot = &Running; *slot != job; slot = &(*slot)->next) {
+        }
+        *slot      = job->next;
+        job->next  = NULL;
+        job->state = TLS_OFFLOAD_DONE;
+        // the descriptor is released only after the job has left the
+        // running state, so it is still held here
+        notify(job->fd[1]);
+        pthread_cond_broadcast(&PoolDone);
+    }
+    return NULL;
+}
+
+static size_t default_threads(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (size_t)n : 1;
+}
+
+// the atfork handlers and the detached workers refer to the code of this
+// module, so it must stay mapped after lua_close() unloads it.  dlopen(3)
+// with RTLD_NOLOAD only fails if the module is linked into the executable,
+// which is never unloaded.
+static void pin_module(void)
+{
+    Dl_info info;
+
+    if (dladdr((void *)pin_module, &info) && info.dli_fname) {
+        dlopen(info.dli_fname, RTLD_NOW | RTLD_NOLOAD | RTLD_NODELETE);
+    }
+}
+
+// must be called with PoolLock held
+static int start_workers(void)
+{
+    size_t n = NThread ? NThread : default_threads();
+    sigset_t all;
+    sigset_t old;
+    int rv = 0;
+
+    if (!AtforkRegistered) {
+        pin_module();
+        if ((rv = pthread_atfork(atfork_prepare, atfork_parent,
+                                 atfork_child)) != 0) {
+            errno = rv;
+            return -1;
+        }
+        AtforkRegistered = 1;
+    }
+
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    while (NStarted < n) {
+        pthread_t tid;
+        if ((rv = pthread_create(&tid, NULL, worker, NULL)) != 0) {
+            break;
+        }
+        pthread_detach(tid);
+        NStarted++;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (NStarted == 0) {
+        errno = rv;
+        return -1;
+    }
+    return 0;
+}
+
+int tls_offload_set_threads(size_t n)
+{
+    int rv = 0;
+
+    pthread_mutex_lock(&PoolLock);
+    NThread = n;
+    if (NStarted && NStarted < NThread) {
+        rv = start_workers();
+    }
+    pthread_mutex_unlock(&PoolLock);
+    return rv;
+}
+
+size_t tls_offload_get_threads(void)
+{
+    size_t n = 0;
+
+    pthread_mutex_lock(&PoolLock);
+    n = NThread ? NThread : default_threads();
+    if (n < NStarted) {
+        n = NStarted;
+    }
+    pthread_mutex_unlock(&PoolLock);
+    return n;
+}
+
+#if !defined(__linux__)
+static int set_pipe_flags(int fd)
+{
+    int flags = fcntl(fd, F_GETFL);
+
+    return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1 &&
+           fcntl(fd, F_SETFD, FD_CLOEXEC) != -1;
+}
+#endif
+
+// take an idle notification descriptor, or open a new one; must be called
+// with PoolLock held
+static int open_notifier(int fd[2])
+{
+    if (NSpare) {
+        NSpare--;
+        fd[0] = Spare[NSpare][0];
+        fd[1] = Spare[NSpare][1];
+        return 0;
+    }
+
+#if defined(__linux__)
+    if ((fd[0] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+        return -1;
+    }
+    fd[1] = fd[0];
+#else
+    if (pipe(fd) != 0) {
+        return -1;
+    } else if (!set_pipe_flags(fd[0]) || !set_pipe_flags(fd[1])) {
+        int err = errno;
+        close(fd[0]);
+        close(fd[1]);
+        errno = err;
+        return -1;
+    }
+#endif
+    return 0;
+}
+
+// consume the notification and keep the descriptor for reuse, or close it;
+// must be called with PoolLock held
+static void close_notifier(int fd[2])
+{
+    char buf[8];
+
+    if (fd[0] == -1) {
+        return;
+    }
+    while (read(fd[0], buf, sizeof(buf)) > 0) {
+    }
+    if (NSpare < TLS_OFFLOAD_MAX_SPARE) {
+        Spare[NSpare][0] = fd[0];
+        Spare[NSpare][1] = fd[1];
+        NSpare++;
+    } else {
+        close(fd[0]);
+        if (fd[1] != fd[0]) {
+            close(fd[1]);
+        }
+    }
+    fd[0] = fd[1] = -1;
+}
+
+void tls_offload_job_init(tls_offload_job_t *job,
+                          void (*run)(tls_offload_job_t *job),
+                          void (*reset)(tls_offload_job_t *job))
+{
+    job->next  = NULL;
+    job->run   = run;
+    job->reset = reset;
+    job->state = TLS_OFFLOAD_IDLE;
+    job->fd[0] = job->fd[1] = -1;
+}
+
+void tls_offload_job_destroy(tls_offload_job_t *job)
+{
+    pthread_mutex_lock(&PoolLock);
+    if (job->state == TLS_OFFLOAD_QUEUED) {
+        tls_offload_job_t **slot = &Head;
+        tls_offload_job_t *prev  = NULL;
+
+        while (*slot && *slot != job) {
+            prev = *slot;
+            slot = &prev->next;
+        }
+        if (*slot) {
+            *slot = job->next;
+            if (Tail == job) {
+                Tail = prev;
+            }
+        }
+    }
+    while (job->state == TLS_OFFLOAD_RUNNING) {
+        pthread_cond_wait(&PoolDone, &PoolLock);
+    }
+    job->state = TLS_OFFLOAD_IDLE;
+    close_notifier(job->fd);
+    pthread_mutex_unlock(&PoolLock);
+}
+
+int tls_offload_submit(tls_offload_job_t *job)
+{
+    int rv = 0;
+
+    pthread_mutex_lock(&PoolLock);
+    if (job->state != TLS_OFFLOAD_IDLE) {
+        errno = EBUSY;
+        rv    = -1;
+    } else if (NStarted == 0 && start_workers() != 0) {
+        rv = -1;
+    } else if (job->fd[0] == -1 && open_notifier(job->fd) != 0) {
+        rv = -1;
+    } else {
+        job->next  = NULL;
+        job->state = TLS_OFFLOAD_QUEUED;
+        if (Tail) {
+            Tail->next = job;
+        } else {
+            Head = job;
+        }
+        Tail = job;
+        pthread_cond_signal(&PoolReady);
+    }
+    pthread_mutex_unlock(&PoolLock);
+    return rv;
+}
+
+tls_offload_state_t tls_offload_get_state(tls_offload_job_t *job)
+{
+    tls_offload_state_t state = TLS_OFFLOAD_IDLE;
+
+    pthread_mutex_lock(&PoolLock);
+    state = job->state;
+    pthread_mutex_unlock(&PoolLock);
+    return state;
+}
+
+tls_offload_state_t tls_offload_collect(tls_offload_job_t *job)
+{
+    tls_offload_state_t state = TLS_OFFLOAD_IDLE;
+
+    pthread_mutex_lock(&PoolLock);
+    state = job->state;
+    if (state == TLS_OFFLOAD_DONE || state == TLS_OFFLOAD_FAILED) {
+        close_notifier(job->fd);
+        job->state = TLS_OFFLOAD_IDLE;
+    }
+    pthread_mutex_unlock(&PoolLock);
+    return state;
+}
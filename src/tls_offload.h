@@ -0,0 +1,103 @@
+/**
+ *  Copyright (C) 2026 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef net_tls_offload_h
+#define net_tls_offload_h
+
+#include <stddef.h>
+
+/** @brief State of a job. */
+typedef enum {
+    TLS_OFFLOAD_IDLE = 0, /**< not submitted, or the result was collected */
+    TLS_OFFLOAD_QUEUED,   /**< waiting for a worker */
+    TLS_OFFLOAD_RUNNING,  /**< running on a worker */
+    TLS_OFFLOAD_DONE,     /**< finished; the notification fd is readable */
+    TLS_OFFLOAD_FAILED,   /**< lost by fork(2); the fd is readable as well */
+} tls_offload_state_t;
+
+/**
+ * @brief Unit of work run on a worker thread.
+ *
+ * A job is embedded in the caller's own structure and is reused for every
+ * submission.  Completion is signalled by making fd[0] readable, so that an
+ * event loop can wait for it like any other descriptor.  The descriptor is
+ * assigned by tls_offload_submit() and released when the result is
+ * collected; fd[0] is -1 while the job is idle.
+ */
+typedef struct tls_offload_job_t {
+    struct tls_offload_job_t *next;
+    void (*run)(struct tls_offload_job_t *job); /**< called on a worker */
+    /** called in the child of fork(2) if the job was running, to
+     * re-initialize the locks that run() may have held */
+    void (*reset)(struct tls_offload_job_t *job);
+    tls_offload_state_t state;
+    int fd[2]; /**< fd[0] becomes readable when done; fd[1] is written */
+} tls_offload_job_t;
+
+/**
+ * @brief Set the number of worker threads.  Workers are started by the first
+ * submission; once started, the pool can grow but never shrinks.
+ *
+ * @return 0 on success, -1 on failure with errno set.
+ */
+int tls_offload_set_threads(size_t n);
+
+/**
+ * @brief Return the number of worker threads, including those not started
+ * yet.
+ */
+size_t tls_offload_get_threads(void);
+
+/**
+ * @brief Initialize @p job.  @p reset may be NULL if @p run takes no lock.
+ */
+void tls_offload_job_init(tls_offload_job_t *job,
+                          void (*run)(tls_offload_job_t *job),
+                          void (*reset)(tls_offload_job_t *job));
+
+/**
+ * @brief Withdraw @p job from the queue, or wait for it to finish if it is
+ * running, then release its notification descriptor.
+ */
+void tls_offload_job_destroy(tls_offload_job_t *job);
+
+/**
+ * @brief Queue an idle @p job, assign its notification descriptor and start
+ * the workers if needed.
+ *
+ * @return 0 on success, -1 on failure with errno set.
+ */
+int tls_offload_submit(tls_offload_job_t *job);
+
+/**
+ * @brief Return the state of @p job without consuming its result.
+ */
+tls_offload_state_t tls_offload_get_state(tls_offload_job_t *job);
+
+/**
+ * @brief Return the state of @p job.  A finished or failed job is reset to
+ * idle and its notification is consumed, so TLS_OFFLOAD_DONE or
+ * TLS_OFFLOAD_FAILED is returned only once per submission.
+ */
+tls_offload_state_t tls_offload_collect(tls_offload_job_t *job);
+
+#endif /* net_tls_offload_h */
@@ -25,13 +25,17 @@
 #include "tls.h"
 // depend
 #include "lauxhlib.h"
+#include "lua_errno.h"
 // lua
 #include <lauxlib.h>
 // system
 #include <arpa/inet.h>
+#include <errno.h>
 #include <netinet/in.h>
+#include <openssl/pem.h>
 #include <openssl/ssl.h>
 #include <stdio.h>
+#include <time.h>
 
 static int sni_callback(SSL *ssl, int *al, void *arg)
 {
@@ -50,6 +54,36 @@ static int sni_callback(SSL *ssl, int *al, void *arg)
         return SSL_TLSEXT_ERR_NOACK;
     }
 
+    // registered certificates take precedence over the callback function
+    if (s->certstore) {
+        int found    = 0;
+        SSL_CTX *ctx = NULL;
+
+        // the lookup updates the LRU list and may load a certificate, and
+        // offloaded handshakes of this server may run on other threads
+        pthread_mutex_lock(&s->lock.cache);
+        if ((ctx = tls_certstore_get(s->certstore, name, &found))) {
+            // SSL_set_SSL_CTX() takes its own reference, so the store may
+            // evict the context while this connection is still using it.
+            SSL_set_SSL_CTX(ssl, ctx);
+        }
+        pthread_mutex_unlock(&s->lock.cache);
+
+        if (ctx) {
+            return SSL_TLSEXT_ERR_OK;
+        } else if (found) {
+            unsigned long err = ERR_get_error();
+            fprintf(stderr, "failed to load certificate for %s: %s\n", name,
+                    err ? ERR_error_string(err, NULL) : "unknown error");
+            ERR_clear_error();
+            *al = SSL_AD_INTERNAL_ERROR;
+            return SSL_TLSEXT_ERR_ALERT_FATAL;
+        }
+    }
+    if (s->sni_callback_ref == LUA_NOREF) {
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+
     // call closure
     lauxh_pushref(s->L, s->sni_callback_ref);
     lua_pushstring(s->L, name);
@@ -108,19 +142,28 @@ static int set_sni_callback_lua(lua_State *L)
         lua_insert(L, 2);
         lua_pushcclosure(L, sni_callback_closure, narg);
 
-        // remove previous reference
-        s->sni_callback_ref = lauxh_unref(L, s->sni_callback_ref);
-        s->sni_callback_ref = lauxh_ref(L);
+        int ref = lauxh_ref(L);
+        int old = s->sni_callback_ref;
 
+        pthread_rwlock_wrlock(&s->lock.config);
+        s->sni_callback_ref = ref;
         // set callback for SNI extension (Server Name Indication) support
         SSL_CTX_set_tlsext_servername_callback(s->ctx, sni_callback);
         SSL_CTX_set_tlsext_servername_arg(s->ctx, s);
+        pthread_rwlock_unlock(&s->lock.config);
+        // remove previous reference
+        lauxh_unref(L, old);
         return 0;
     } else if (lua_isnil(L, 2)) {
-        // remove previous reference
-        SSL_CTX_set_tlsext_servername_callback(s->ctx, NULL);
-        SSL_CTX_set_tlsext_servername_arg(s->ctx, NULL);
+        // remove previous reference; keep the SNI handler installed while
+        // certificates are registered by add_sni_cert().
+        pthread_rwlock_wrlock(&s->lock.config);
+        if (!s->certstore) {
+            SSL_CTX_set_tlsext_servername_callback(s->ctx, NULL);
+            SSL_CTX_set_tlsext_servername_arg(s->ctx, NULL);
+        }
         s->sni_callback_ref = lauxh_unref(L, s->sni_callback_ref);
+        pthread_rwlock_unlock(&s->lock.config);
         return 0;
     }
 
@@ -151,17 +194,640 @@ static int alpn_select_cb(SSL *ssl, const unsigned char **out,
     return SSL_TLSEXT_ERR_NOACK;
 }
 
+// call the OCSP callback function to get a new response for cert.  the
+// callback function receives the PEM encoded certificate and must return a
+// DER encoded OCSP response or nil.  returns NULL if no new response is
+// available; the failure is recorded to retry later.
+static tls_staple_entry_t *fetch_ocsp_response(tls_server_t *s, X509 *cert,
+                                               X509 *issuer, time_t now)
+{
+    lua_State *L          = s->L;
+    int top               = lua_gettop(L);
+    BIO *bio              = BIO_new(BIO_s_mem());
+    char *pem             = NULL;
+    long len              = 0;
+    tls_staple_entry_t *e = NULL;
+
+    if (!bio || PEM_write_bio_X509(bio, cert) != 1 ||
+        (len = BIO_get_mem_data(bio, &pem)) <= 0) {
+        BIO_free(bio);
+        ERR_clear_error();
+        tls_staple_set_failed(s->staple, cert, now);
+        return NULL;
+    }
+
+    // call closure
+    lauxh_pushref(L, s->ocsp_callback_ref);
+    lua_pushlstring(L, pem, (size_t)len);
+    BIO_free(bio);
+    if (lua_pcall(L, 1, 1, 0) != 0) {
+        // the error value may be a non-string, in which case
+        // lua_tostring() returns NULL and must not reach fprintf("%s").
+        const char *err = lua_tostring(L, -1);
+        fprintf(stderr, "call closure failed: %s\n",
+                err ? err : "(non-string error value)");
+    } else if (lua_type(L, -1) == LUA_TSTRING) {
+        size_t dlen     = 0;
+        const char *der = lua_tolstring(L, -1, &dlen);
+
+        e = tls_staple_set(s->staple, cert, issuer, (const unsigned char *)der,
+                           dlen, now);
+        if (!e) {
+            unsigned long err = ERR_get_error();
+            fprintf(stderr, "invalid OCSP response: %s\n",
+                    err ? ERR_error_string(err, NULL) :
+                          "no current status of the certificate");
+            ERR_clear_error();
+        }
+    }
+    lua_settop(L, top);
+
+    if (!e) {
+        tls_staple_set_failed(s->staple, cert, now);
+    }
+    return e;
+}
+
+// status request callback of the server; staples the cached OCSP response
+// of the certificate selected for the connection.  the callback function is
+// never called here; a certificate without a cached entry is recorded so
+// that the next refresh_ocsp() fetches its response.
+static int ocsp_status_cb(SSL *ssl, void *arg)
+{
+    tls_server_t *s       = (tls_server_t *)arg;
+    X509 *cert            = SSL_get_certificate(ssl);
+    STACK_OF(X509) *chain = NULL;
+    time_t now            = time(NULL);
+    tls_staple_entry_t *e = NULL;
+    unsigned char *resp   = NULL;
+
+    if (!cert || !s->staple) {
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+
+    e = tls_staple_find(s->staple, cert);
+    if ((!e || !e->issuer) && s->ocsp_callback_ref != LUA_NOREF) {
+        SSL_get0_chain_certs(ssl, &chain);
+        e = tls_staple_request(s->staple, cert,
+                               tls_staple_find_issuer(cert, chain));
+    }
+    if (!tls_staple_is_valid(e, now) ||
+        !(resp = OPENSSL_memdup(e->der, e->len))) {
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+    // the SSL object takes ownership of resp
+    SSL_set_tlsext_status_ocsp_resp(ssl, resp, (long)e->len);
+    return SSL_TLSEXT_ERR_OK;
+}
+
+static int new_staple(tls_server_t *s)
+{
+    if (!s->staple) {
+        s->staple = tls_staple_new();
+        if (!s->staple) {
+            return 0;
+        }
+        SSL_CTX_set_tlsext_status_cb(s->ctx, ocsp_status_cb);
+        SSL_CTX_set_tlsext_status_arg(s->ctx, s);
+    }
+    return 1;
+}
+
+static int set_ocsp_response_lua(lua_State *L)
+{
+    tls_server_t *s       = luaL_checkudata(L, 1, NET_TLS_SERVER_MT);
+    size_t len            = 0;
+    const char *der       = luaL_checklstring(L, 2, &len);
+    STACK_OF(X509) *chain = NULL;
+    tls_staple_entry_t *e = NULL;
+    time_t now            = time(NULL);
+    int rv                = 0;
+
+    // the cached responses are read by offloaded handshakes
+    pthread_rwlock_wrlock(&s->lock.config);
+    if (!new_staple(s)) {
+        pthread_rwlock_unlock(&s->lock.config);
+        lua_pushboolean(L, 0);
+        lua_errno_new(L, errno, "set_ocsp_response");
+        return 2;
+    }
+    // the response must contain the status of one of the server
+    // certificates; it is stapled for that certificate only
+    rv = SSL_CTX_set_current_cert(s->ctx, SSL_CERT_SET_FIRST);
+    for (; rv == 1 && !e;
+         rv = SSL_CTX_set_current_cert(s->ctx, SSL_CERT_SET_NEXT)) {
+        X509 *cert = SSL_CTX_get0_certificate(s->ctx);
+
+        ERR_clear_error();
+        SSL_CTX_get0_chain_certs(s->ctx, &chain);
+        e = tls_staple_set(s->staple, cert,
+                           tls_staple_find_issuer(cert, chain),
+                           (const unsigned char *)der, len, now);
+    }
+    pthread_rwlock_unlock(&s->lock.config);
+
+    if (!e) {
+        lua_pushboolean(L, 0);
+        tls_push_error(L, "tls_staple_set", "invalid OCSP response");
+        return 2;
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+static int ocsp_callback_closure(lua_State *L)
+{
+    int narg = lua_tointeger(L, lua_upvalueindex(1));
+
+    lua_settop(L, 1);
+    // push callback function and arguments
+    for (int i = 0; i <= narg; i++) {
+        lua_pushvalue(L, lua_upvalueindex(2 + i));
+    }
+    // push the certificate argument from fetch_ocsp_response() function
+    lua_pushvalue(L, 1);
+    lua_call(L, narg + 1, 1);
+    return 1;
+}
+
+static int set_ocsp_callback_lua(lua_State *L)
+{
+    tls_server_t *s = luaL_checkudata(L, 1, NET_TLS_SERVER_MT);
+
+    if (lua_isfunction(L, 2)) {
+        int narg = lua_gettop(L);
+        int ref  = LUA_NOREF;
+        int old  = s->ocsp_callback_ref;
+        int ok   = 0;
+
+        lua_pushinteger(L, narg - 2);
+        lua_insert(L, 2);
+        lua_pushcclosure(L, ocsp_callback_closure, narg);
+        ref = lauxh_ref(L);
+
+        // handshakes that call the callback function are not offloaded, so
+        // wait for the offloaded ones that are running
+        pthread_rwlock_wrlock(&s->lock.config);
+        if ((ok = new_staple(s))) {
+            s->ocsp_callback_ref = ref;
+        }
+        pthread_rwlock_unlock(&s->lock.config);
+
+        if (!ok) {
+            lauxh_unref(L, ref);
+            lua_pushboolean(L, 0);
+            lua_errno_new(L, errno, "set_ocsp_callback");
+            return 2;
+        }
+        // remove previous reference
+        lauxh_unref(L, old);
+    } else if (lua_isnil(L, 2)) {
+        // cached responses are still stapled until they expire
+        pthread_rwlock_wrlock(&s->lock.config);
+        s->ocsp_callback_ref = lauxh_unref(L, s->ocsp_callback_ref);
+        pthread_rwlock_unlock(&s->lock.config);
+    } else {
+        return lauxh_argerror(L, 2, "function or nil expected, got %s",
+                              luaL_typename(L, 2));
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+static int refresh_ocsp_lua(lua_State *L)
+{
+    tls_server_t *s = luaL_checkudata(L, 1, NET_TLS_SERVER_MT);
+    time_t now      = time(NULL);
+    lua_Integer n   = 0;
+
+    // fetch the responses that are due for refresh, including those of the
+    // certificates recorded by the handshakes.  no handshake is offloaded
+    // while the callback function is set, so the cache is updated without
+    // the lock.
+    if (s->staple && s->ocsp_callback_ref != LUA_NOREF) {
+        for (tls_staple_entry_t *e = s->staple->head; e; e = e->next) {
+            if (now >= e->refresh_at &&
+                fetch_ocsp_response(s, e->cert, e->issuer, now)) {
+                n++;
+            }
+        }
+    }
+    lua_pushinteger(L, n);
+    return 1;
+}
+
+// apply the settings of the parent server to a context loaded by the
+// certificate store.  SSL_set_SSL_CTX() only swaps the certificate of the
+// connection; protocol versions, ciphers and session cache stay with the
+// parent, but ALPN selection is resolved against the new context.
+static int init_sni_ctx(SSL_CTX *ctx, void *arg)
+{
+    tls_server_t *s = (tls_server_t *)arg;
+
+    SSL_CTX_clear_mode(ctx, SSL_MODE_AUTO_RETRY);
+    SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE);
+    SSL_CTX_set_mode(ctx, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    if (s->alpn) {
+        SSL_CTX_set_alpn_select_cb(ctx, alpn_select_cb, s);
+    }
+    // responses are cached per certificate, so the parent server staples
+    // for every loaded certificate
+    SSL_CTX_set_tlsext_status_cb(ctx, ocsp_status_cb);
+    SSL_CTX_set_tlsext_status_arg(ctx, s);
+    return 1;
+}
+
+static tls_certstore_t *new_certstore(tls_server_t *s)
+{
+    tls_certstore_t *store = tls_certstore_new(init_sni_ctx, s);
+
+    if (store) {
+        // the SNI handler consults the store before the callback function
+        SSL_CTX_set_tlsext_servername_callback(s->ctx, sni_callback);
+        SSL_CTX_set_tlsext_servername_arg(s->ctx, s);
+    }
+    return store;
+}
+
+static int add_sni_cert_lua(lua_State *L)
+{
+    tls_server_t *s  = luaL_checkudata(L, 1, NET_TLS_SERVER_MT);
+    const char *name = luaL_checkstring(L, 2);
+    size_t cert_len  = 0;
+    const char *cert = luaL_checklstring(L, 3, &cert_len);
+    size_t key_len   = 0;
+    const char *key  = luaL_checklstring(L, 4, &key_len);
+    int rv           = -1;
+
+    pthread_rwlock_wrlock(&s->lock.config);
+    if (s->certstore || (s->certstore = new_certstore(s))) {
+        rv = tls_certstore_add(s->certstore, name, cert, cert_len, key,
+                               key_len);
+    }
+    pthread_rwlock_unlock(&s->lock.config);
+
+    if (rv != 0) {
+        lua_pushboolean(L, 0);
+        lua_errno_new(L, errno, "add_sni_cert");
+        return 2;
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+static int remove_sni_cert_lua(lua_State *L)
+{
+    tls_server_t *s  = luaL_checkudata(L, 1, NET_TLS_SERVER_MT);
+    const char *name = luaL_checkstring(L, 2);
+    int removed      = 0;
+
+    pthread_rwlock_wrlock(&s->lock.config);
+    removed = s->certstore && tls_certstore_remove(s->certstore, name);
+    pthread_rwlock_unlock(&s->lock.config);
+    lua_pushboolean(L, removed);
+    return 1;
+}
+
+static int set_sni_cache_limits_lua(lua_State *L)
+{
+    tls_server_t *s     = luaL_checkudata(L, 1, NET_TLS_SERVER_MT);
+    lua_Integer maxctx  = lauxh_optinteger(L, 2, 0);
+    lua_Integer maxsize = lauxh_optinteger(L, 3, 0);
+    int ok              = 0;
+
+    if (maxctx < 0) {
+        return lauxh_argerror(L, 2, "max_contexts must be >= 0");
+    } else if (maxsize < 0) {
+        return lauxh_argerror(L, 3, "max_bytes must be >= 0");
+    }
+
+    pthread_rwlock_wrlock(&s->lock.config);
+    if ((ok = s->certstore || (s->certstore = new_certstore(s)))) {
+        tls_certstore_set_limits(s->certstore, (size_t)maxctx,
+                                 (size_t)maxsize);
+    }
+    pthread_rwlock_unlock(&s->lock.config);
+
+    if (!ok) {
+        lua_pushboolean(L, 0);
+        lua_errno_new(L, errno, "set_sni_cache_limits");
+        return 2;
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+static int get_sni_cache_stats_lua(lua_State *L)
+{
+    tls_server_t *s        = luaL_checkudata(L, 1, NET_TLS_SERVER_MT);
+    tls_certstore_t *store = s->certstore;
+    lua_Integer nentry     = 0;
+    lua_Integer nloaded    = 0;
+    lua_Integer nbytes     = 0;
+
+    if (store) {
+        // the counters are updated by the SNI lookups of handshakes
+        pthread_mutex_lock(&s->lock.cache);
+        nentry  = (lua_Integer)store->nentry;
+        nloaded = (lua_Integer)store->nloaded;
+        nbytes  = (lua_Integer)store->loaded_bytes;
+        pthread_mutex_unlock(&s->lock.cache);
+    }
+    lua_createtable(L, 0, 3);
+    lauxh_pushint2tbl(L, "certs", nentry);
+    lauxh_pushint2tbl(L, "loaded", nloaded);
+    lauxh_pushint2tbl(L, "bytes", nbytes);
+    return 1;
+}
+
 static int gc_lua(lua_State *L)
 {
     tls_server_t *s = luaL_checkudata(L, 1, NET_TLS_SERVER_MT);
     SSL_CTX_set_tlsext_servername_callback(s->ctx, NULL);
     SSL_CTX_set_tlsext_servername_arg(s->ctx, NULL);
-    s->sni_callback_ref = lauxh_unref(L, s->sni_callback_ref);
-    s->ref_alpn         = lauxh_unref(L, s->ref_alpn);
+    s->sni_callback_ref  = lauxh_unref(L, s->sni_callback_ref);
+    s->ref_alpn          = lauxh_unref(L, s->ref_alpn);
+    s->ocsp_callback_ref = lauxh_unref(L, s->ocsp_callback_ref);
+    tls_certstore_free(s->certstore);
+    s->certstore = NULL;
+    tls_staple_free(s->staple);
+    s->staple = NULL;
+    tls_sslpool_free(&s->pool);
     SSL_CTX_free(s->ctx);
+    tls_lock_destroy(&s->lock);
     return 0;
 }
 
+static int use_certificate(SSL_CTX *ctx, const char *cert, size_t cert_len,
+                           const char *key, size_t key_len,
+                           const char **errop, const char **errmsg)
+{
+    // set certificate chain (leaf followed by intermediate CAs in a
+    // single PEM file, as recommended by OpenSSL for server certificates).
+    // the parsed chain is shared with other contexts using the same source.
+    if (tls_x509cache_use_chain(ctx, cert, cert_len) != 1) {
+        *errop  = "tls_x509cache_use_chain";
+        *errmsg = "failed to load certificate chain";
+        return 0;
+    }
+
+    // set private key
+    if (tls_x509cache_use_key(ctx, key, key_len) != 1) {
+        *errop  = "tls_x509cache_use_key";
+        *errmsg = "failed to load private key";
+        return 0;
+    }
+
+    // check that the private key matches the certificate
+    if (SSL_CTX_check_private_key(ctx) != 1) {
+        *errop  = "SSL_CTX_check_private_key";
+        *errmsg = "private key does not match the certificate";
+        return 0;
+    }
+    return 1;
+}
+
+// return the certificate of @p ctx whose key has the same type as the key of
+// @p cert, or NULL, and make it the current one.  a context holds at most one
+// certificate per key type.  a certificate without a private key is never
+// served, so it is treated as absent.
+static X509 *find_certificate(SSL_CTX *ctx, X509 *cert)
+{
+    int type = EVP_PKEY_base_id(X509_get0_pubkey(cert));
+
+    int rv   = SSL_CTX_set_current_cert(ctx, SSL_CERT_SET_FIRST);
+
+    for (; rv == 1; rv = SSL_CTX_set_current_cert(ctx, SSL_CERT_SET_NEXT)) {
+        X509 *x = SSL_CTX_get0_certificate(ctx);
+        if (x && SSL_CTX_get0_privatekey(ctx) &&
+            EVP_PKEY_base_id(X509_get0_pubkey(x)) == type) {
+            return x;
+        }
+    }
+    return NULL;
+}
+
+// set @p cert, @p pkey and @p chain to the slot of the key type of @p cert.
+// these are separate calls, so the slot may be left partially updated on
+// failure.
+static int install_certificate(SSL_CTX *ctx, X509 *cert, EVP_PKEY *pkey,
+                               STACK_OF(X509) *chain)
+{
+    return SSL_CTX_use_certificate(ctx, cert) == 1 &&
+           SSL_CTX_use_PrivateKey(ctx, pkey) == 1 &&
+           SSL_CTX_set1_chain(ctx, chain) == 1;
+}
+
+static int replace_certificate(lua_State *L, int add)
+{
+    tls_server_t *s          = luaL_checkudata(L, 1, NET_TLS_SERVER_MT);
+    size_t cert_len          = 0;
+    const char *cert         = luaL_checklstring(L, 2, &cert_len);
+    size_t key_len           = 0;
+    const char *key          = luaL_checklstring(L, 3, &key_len);
+    SSL_CTX *tmp             = SSL_CTX_new(TLS_server_method());
+    STACK_OF(X509) *chain    = NULL;
+    X509 *oldcert            = NULL;
+    EVP_PKEY *oldkey         = NULL;
+    STACK_OF(X509) *oldchain = NULL;
+    const char *errop        = NULL;
+    const char *errmsg       = NULL;
+
+    // load the new pair into a scratch context first, so that a broken pair
+    // never replaces the working one.
+    if (!tmp) {
+        errop  = "SSL_CTX_new";
+        errmsg = "failed to create SSL_CTX";
+        goto FAIL;
+    } else if (use_certificate(tmp, cert, cert_len, key, key_len, &errop,
+                               &errmsg) != 1) {
+        goto FAIL;
+    }
+
+    // NOTE: SSL_new() copies the certificate of the context into the SSL
+    // object, so connections in progress keep the old certificate and only
+    // new handshakes use the new one.  the session cache stays with s->ctx.
+    // the pooled SSL objects hold the old certificate, so they are dropped.
+    // the certificate replaces the one with the same key type, so that
+    // ECDSA and RSA certificates can be served side by side.
+    SSL_CTX_get0_chain_certs(tmp, &chain);
+    pthread_rwlock_wrlock(&s->lock.config);
+    if ((oldcert = find_certificate(s->ctx, SSL_CTX_get0_certificate(tmp)))) {
+        if (add) {
+            pthread_rwlock_unlock(&s->lock.config);
+            oldcert = NULL;
+            errop   = "add_certificate";
+            errmsg  = "certificate of the same key type already exists";
+            goto FAIL;
+        }
+        // keep the current pair to restore it if the replacement fails
+        X509_up_ref(oldcert);
+        oldkey = SSL_CTX_get0_privatekey(s->ctx);
+        EVP_PKEY_up_ref(oldkey);
+        SSL_CTX_get0_chain_certs(s->ctx, &oldchain);
+        if (oldchain && !(oldchain = X509_chain_up_ref(oldchain))) {
+            pthread_rwlock_unlock(&s->lock.config);
+            errop  = "X509_chain_up_ref";
+            errmsg = "failed to copy certificate chain";
+            goto FAIL;
+        }
+    } else if (!add) {
+        // OpenSSL cannot remove a certificate from a context, so a
+        // certificate of another key type would be served next to the
+        // current one instead of replacing it
+        pthread_rwlock_unlock(&s->lock.config);
+        errop  = "set_certificate";
+        errmsg = "no certificate of the same key type to replace";
+        goto FAIL;
+    }
+    if (!install_certificate(s->ctx, SSL_CTX_get0_certificate(tmp),
+                             SSL_CTX_get0_privatekey(tmp), chain)) {
+        // put the previous pair back.  a new key type has no previous pair;
+        // a certificate left without its key is neither served nor found.
+        if (oldcert) {
+            ERR_set_mark();
+            install_certificate(s->ctx, oldcert, oldkey, oldchain);
+            ERR_pop_to_mark();
+        }
+        pthread_rwlock_unlock(&s->lock.config);
+        errop  = "SSL_CTX_use_certificate";
+        errmsg = "failed to replace certificate";
+        goto FAIL;
+    }
+    // the stapled OCSP response of the old certificate is no longer used
+    if (oldcert && s->staple &&
+        X509_cmp(oldcert, SSL_CTX_get0_certificate(s->ctx)) != 0) {
+        tls_staple_remove(s->staple, oldcert);
+    }
+    pthread_rwlock_unlock(&s->lock.config);
+    X509_free(oldcert);
+    EVP_PKEY_free(oldkey);
+    sk_X509_pop_free(oldchain, X509_free);
+    tls_sslpool_flush(&s->pool);
+
+    SSL_CTX_free(tmp);
+    lua_pushboolean(L, 1);
+    return 1;
+
+FAIL:
+    X509_free(oldcert);
+    EVP_PKEY_free(oldkey);
+    sk_X509_pop_free(oldchain, X509_free);
+    if (tmp) {
+        SSL_CTX_free(tmp);
+    }
+    lua_pushboolean(L, 0);
+    tls_push_error(L, errop, errmsg);
+    return 2;
+}
+
+static int set_handshake_offload_lua(lua_State *L)
+{
+    tls_server_t *s = luaL_checkudata(L, 1, NET_TLS_SERVER_MT);
+
+    // applies to the connections accepted afterwards
+    s->offload = lauxh_optboolean(L, 2, 1);
+    return 0;
+}
+
+static int set_shutdown_mode_lua(lua_State *L)
+{
+    tls_server_t *s = luaL_checkudata(L, 1, NET_TLS_SERVER_MT);
+
+    // applies to the connections accepted afterwards
+    s->shutdown_mode = luaL_checkoption(L, 2, NULL, TLS_SHUTDOWN_MODES);
+    return 0;
+}
+
+static int set_ssl_pool_size_lua(lua_State *L)
+{
+    tls_server_t *s = luaL_checkudata(L, 1, NET_TLS_SERVER_MT);
+    size_t n        = (size_t)lauxh_checkuinteger(L, 2);
+
+    // SSL objects and BIO buffers of closed connections are kept for the
+    // connections accepted afterwards; 0 disables the pool
+    if (tls_sslpool_set_max(&s->pool, n) != 0) {
+        lua_pushboolean(L, 0);
+        lua_errno_new(L, errno, "set_ssl_pool_size");
+        return 2;
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+static int set_certificate_lua(lua_State *L)
+{
+    return replace_certificate(L, 0);
+}
+
+static int add_certificate_lua(lua_State *L)
+{
+    return replace_certificate(L, 1);
+}
+
+static int set_groups_lua(lua_State *L)
+{
+    tls_server_t *s    = luaL_checkudata(L, 1, NET_TLS_SERVER_MT);
+    const char *groups = luaL_checkstring(L, 2);
+    int rv             = 0;
+
+    // e.g. "X25519:P-256"; the first group is preferred
+    pthread_rwlock_wrlock(&s->lock.config);
+    rv = SSL_CTX_set1_groups_list(s->ctx, groups);
+    pthread_rwlock_unlock(&s->lock.config);
+    tls_sslpool_flush(&s->pool);
+    if (rv != 1) {
+        lua_pushboolean(L, 0);
+        tls_push_error(L, "SSL_CTX_set1_groups_list",
+                       "failed to set key exchange groups");
+        return 2;
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+static int set_ciphersuites_lua(lua_State *L)
+{
+    tls_server_t *s    = luaL_checkudata(L, 1, NET_TLS_SERVER_MT);
+    const char *suites = luaL_checkstring(L, 2);
+    int rv             = 0;
+
+    // replaces the TLS 1.3 ciphersuites of the cipher suite policy
+    pthread_rwlock_wrlock(&s->lock.config);
+    rv = tls_set_ciphersuites(s->ctx, suites);
+    pthread_rwlock_unlock(&s->lock.config);
+    tls_sslpool_flush(&s->pool);
+    if (rv != 1) {
+        lua_pushboolean(L, 0);
+        tls_push_error(L, "SSL_CTX_set_ciphersuites",
+                       "failed to set TLS 1.3 ciphersuites");
+        return 2;
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+static int set_sigalgs_lua(lua_State *L)
+{
+    tls_server_t *s     = luaL_checkudata(L, 1, NET_TLS_SERVER_MT);
+    const char *sigalgs = luaL_checkstring(L, 2);
+    int rv              = 0;
+
+    // e.g. "ECDSA+SHA256:RSA-PSS+SHA256"
+    pthread_rwlock_wrlock(&s->lock.config);
+    rv = SSL_CTX_set1_sigalgs_list(s->ctx, sigalgs);
+    pthread_rwlock_unlock(&s->lock.config);
+    tls_sslpool_flush(&s->pool);
+    if (rv != 1) {
+        lua_pushboolean(L, 0);
+        tls_push_error(L, "SSL_CTX_set1_sigalgs_list",
+                       "failed to set signature algorithms");
+        return 2;
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
 static void set_session_conf(SSL_CTX *ctx, long timeout, long cache_size)
 {
     SSL_CTX_set_timeout(ctx, timeout);
@@ -172,8 +838,10 @@ static void set_session_conf(SSL_CTX *ctx, long timeout, long cache_size)
 
 static int new_lua(lua_State *L)
 {
-    const char *cert = luaL_checkstring(L, 1);
-    const char *key  = luaL_checkstring(L, 2);
+    size_t cert_len  = 0;
+    const char *cert = luaL_checklstring(L, 1, &cert_len);
+    size_t key_len   = 0;
+    const char *key  = luaL_checklstring(L, 2, &key_len);
     int protocol     = luaL_checkoption(L, 3, "default", TLS_PROTOCOLS);
     int cipher_suite = luaL_checkoption(L, 4, "default", TLS_CIPHER_SUITES);
     int nalpn        = 0;
@@ -193,17 +861,30 @@ static int new_lua(lua_State *L)
     }
 
     // create context
-    s                   = lua_newuserdata(L, sizeof(tls_server_t));
-    s->L                = L;
-    s->sni_callback_ref = LUA_NOREF;
-    s->alpn             = NULL;
-    s->alpn_len         = 0;
-    s->ref_alpn         = LUA_NOREF;
+    s                    = lua_newuserdata(L, sizeof(tls_server_t));
+    s->L                 = L;
+    s->certstore         = NULL;
+    s->staple            = NULL;
+    s->ocsp_callback_ref = LUA_NOREF;
+    s->sni_callback_ref  = LUA_NOREF;
+    s->alpn              = NULL;
+    s->alpn_len          = 0;
+    s->ref_alpn          = LUA_NOREF;
+    s->offload           = 0;
+    s->shutdown_mode     = NET_TLS_SHUTDOWN_FULL;
+    tls_sslpool_init(&s->pool);
+    tls_openssl_init();
     s->ctx              = SSL_CTX_new(TLS_server_method());
     if (!s->ctx) {
         errop  = "SSL_CTX_new";
         errmsg = "failed to create SSL_CTX";
         goto FAIL;
+    } else if (tls_lock_init(&s->lock) != 0) {
+        SSL_CTX_free(s->ctx);
+        s->ctx = NULL;
+        errop  = "tls_lock_init";
+        errmsg = "failed to initialize locks";
+        goto FAIL;
     }
 
     // set mode
@@ -211,25 +892,9 @@ static int new_lua(lua_State *L)
     SSL_CTX_set_mode(s->ctx, SSL_MODE_ENABLE_PARTIAL_WRITE);
     SSL_CTX_set_mode(s->ctx, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
 
-    // set certificate chain (leaf followed by intermediate CAs in a
-    // single PEM file, as recommended by OpenSSL for server certificates)
-    if (SSL_CTX_use_certificate_chain_file(s->ctx, cert) != 1) {
-        errop  = "SSL_CTX_use_certificate_chain_file";
-        errmsg = "failed to load certificate chain file";
-        goto FAIL;
-    }
-
-    // set private key
-    if (SSL_CTX_use_PrivateKey_file(s->ctx, key, SSL_FILETYPE_PEM) != 1) {
-        errop  = "SSL_CTX_use_PrivateKey_file";
-        errmsg = "failed to load private key file";
-        goto FAIL;
-    }
-
-    // check that the private key matches the certificate
-    if (SSL_CTX_check_private_key(s->ctx) != 1) {
-        errop  = "SSL_CTX_check_private_key";
-        errmsg = "private key does not match the certificate";
+    // set certificate chain and private key
+    if (use_certificate(s->ctx, cert, cert_len, key, key_len, &errop,
+                        &errmsg) != 1) {
         goto FAIL;
     }
 
@@ -276,6 +941,7 @@ static int new_lua(lua_State *L)
 FAIL:
     if (s && s->ctx) {
         SSL_CTX_free(s->ctx);
+        tls_lock_destroy(&s->lock);
     }
     lua_pushnil(L);
     tls_push_error(L, errop, errmsg);
@@ -290,8 +956,23 @@ LUALIB_API int luaopen_net_tls_server(lua_State *L)
         {NULL,         NULL        }
     };
     struct luaL_Reg method[] = {
-        {"set_sni_callback", set_sni_callback_lua},
-        {NULL,               NULL                }
+        {"set_certificate",       set_certificate_lua      },
+        {"add_certificate",       add_certificate_lua      },
+        {"set_groups",            set_groups_lua           },
+        {"set_sigalgs",           set_sigalgs_lua          },
+        {"set_ciphersuites",      set_ciphersuites_lua     },
+        {"set_ocsp_response",     set_ocsp_response_lua    },
+        {"set_ocsp_callback",     set_ocsp_callback_lua    },
+        {"refresh_ocsp",          refresh_ocsp_lua         },
+        {"set_sni_callback",      set_sni_callback_lua     },
+        {"add_sni_cert",          add_sni_cert_lua         },
+        {"remove_sni_cert",       remove_sni_cert_lua      },
+        {"set_sni_cache_limits",  set_sni_cache_limits_lua },
+        {"get_sni_cache_stats",   get_sni_cache_stats_lua  },
+        {"set_handshake_offload", set_handshake_offload_lua},
+        {"set_shutdown_mode",     set_shutdown_mode_lua    },
+        {"set_ssl_pool_size",     set_ssl_pool_size_lua    },
+        {NULL,                    NULL                     }
     };
 
     luaL_newmetatable(L, NET_TLS_SERVER_MT);
@@ -0,0 +1,189 @@
+/**
+ *  Copyright (C) 2026 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef net_tls_sslpool_h
+#define net_tls_sslpool_h
+
+#include <openssl/buffer.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#include <stdlib.h>
+
+/**
+ * @brief Backing memory and methods of the memory BIO rings of one
+ * connection, detached from its tls_bio_t so that the next connection can
+ * adopt them.  See tls_bio_new() and tls_bio_detach().
+ */
+typedef struct tls_biomem_t {
+    struct tls_biomem_t *next;
+    size_t cap;
+    BIO_METHOD *rx_method;
+    BIO_METHOD *tx_method;
+    BUF_MEM *rx;
+    BUF_MEM *tx;
+} tls_biomem_t;
+
+/**
+ * @brief Pool of reset SSL objects and BIO rings of a server or client.
+ *
+ * The pool is only used by the thread running Lua, so it has no lock.  The
+ * SSL objects copy some settings of the SSL_CTX when they are created, so the
+ * pool must be flushed whenever those settings change.  Everything in the
+ * pool is released with OpenSSL functions only, so that the modules that do
+ * not link tls_bio.c can free it.
+ */
+typedef struct {
+    size_t max; /**< maximum number of SSL objects and of rings; 0 disables */
+    size_t nssl;
+    SSL **ssl;
+    size_t nbio;
+    tls_biomem_t *bio;
+} tls_sslpool_t;
+
+static inline void tls_biomem_free(tls_biomem_t *m)
+{
+    if (m) {
+        BIO_meth_free(m->rx_method);
+        BIO_meth_free(m->tx_method);
+        BUF_MEM_free(m->rx);
+        BUF_MEM_free(m->tx);
+        free(m);
+    }
+}
+
+static inline void tls_sslpool_init(tls_sslpool_t *pool)
+{
+    *pool = (tls_sslpool_t){0};
+}
+
+/**
+ * @brief Release the pooled objects, keeping the pool enabled.
+ */
+static inline void tls_sslpool_flush(tls_sslpool_t *pool)
+{
+    while (pool->nssl) {
+        SSL_free(pool->ssl[--pool->nssl]);
+    }
+    while (pool->bio) {
+        tls_biomem_t *m = pool->bio;
+        pool->bio       = m->next;
+        tls_biomem_free(m);
+    }
+    pool->nbio = 0;
+}
+
+static inline void tls_sslpool_free(tls_sslpool_t *pool)
+{
+    tls_sslpool_flush(pool);
+    free(pool->ssl);
+    tls_sslpool_init(pool);
+}
+
+/**
+ * @brief Set the maximum number of pooled objects; 0 disables the pool.
+ *
+ * @return 0 on success, -1 on allocation failure.
+ */
+static inline int tls_sslpool_set_max(tls_sslpool_t *pool, size_t max)
+{
+    SSL **ssl = NULL;
+
+    tls_sslpool_flush(pool);
+    if (max == 0) {
+        tls_sslpool_free(pool);
+        return 0;
+    } else if (!(ssl = realloc(pool->ssl, sizeof(SSL *) * max))) {
+        return -1;
+    }
+    pool->ssl = ssl;
+    pool->max = max;
+    return 0;
+}
+
+/**
+ * @brief Take a pooled SSL object of @p ctx, or create a new one.
+ */
+static inline SSL *tls_sslpool_get_ssl(tls_sslpool_t *pool, SSL_CTX *ctx)
+{
+    if (pool->nssl) {
+        return pool->ssl[--pool->nssl];
+    }
+    return SSL_new(ctx);
+}
+
+/**
+ * @brief Reset @p ssl and keep it for the next connection of @p ctx, or free
+ * it if the pool is full or it cannot be reused.
+ */
+static inline void tls_sslpool_put_ssl(tls_sslpool_t *pool, SSL_CTX *ctx,
+                                       SSL *ssl)
+{
+    // a connection switched to another context by SNI cannot go back
+    if (pool->nssl < pool->max && SSL_get_SSL_CTX(ssl) == ctx &&
+        SSL_clear(ssl) == 1) {
+        // SSL_clear() keeps the BIOs and the peer identity of the client;
+        // the BIOs refer to the rings of the connection, so free them here
+        SSL_set_bio(ssl, NULL, NULL);
+        SSL_set_session(ssl, NULL);
+        SSL_set_tlsext_host_name(ssl, NULL);
+        SSL_set1_host(ssl, NULL);
+        SSL_set_tlsext_status_ocsp_resp(ssl, NULL, 0);
+        X509_VERIFY_PARAM_set1_ip(SSL_get0_param(ssl), NULL, 0);
+        pool->ssl[pool->nssl++] = ssl;
+        return;
+    }
+    SSL_free(ssl);
+}
+
+/**
+ * @brief Take pooled rings of @p cap bytes, or return NULL.
+ */
+static inline tls_biomem_t *tls_sslpool_get_bio(tls_sslpool_t *pool,
+                                                size_t cap)
+{
+    for (tls_biomem_t **slot = &pool->bio; *slot; slot = &(*slot)->next) {
+        tls_biomem_t *m = *slot;
+        if (m->cap == cap) {
+            *slot   = m->next;
+            m->next = NULL;
+            pool->nbio--;
+            return m;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Keep @p m for the next connection, or free it if the pool is full.
+ */
+static inline void tls_sslpool_put_bio(tls_sslpool_t *pool, tls_biomem_t *m)
+{
+    if (pool->nbio < pool->max) {
+        m->next   = pool->bio;
+        pool->bio = m;
+        pool->nbio++;
+        return;
+    }
+    tls_biomem_free(m);
+}
+
+#endif /* net_tls_sslpool_h */
@@ -0,0 +1,238 @@
+/**
+ *  Copyright (C) 2026 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+#include "tls_staple.h"
+#include <limits.h>
+#include <openssl/err.h>
+#include <stdlib.h>
+#include <string.h>
+
+tls_staple_t *tls_staple_new(void)
+{
+    return calloc(1, sizeof(tls_staple_t));
+}
+
+static void free_entry(tls_staple_entry_t *e)
+{
+    X509_free(e->cert);
+    X509_free(e->issuer);
+    OPENSSL_free(e->der);
+    free(e);
+}
+
+void tls_staple_free(tls_staple_t *st)
+{
+    if (st) {
+        tls_staple_entry_t *e = st->head;
+        while (e) {
+            tls_staple_entry_t *next = e->next;
+            free_entry(e);
+            e = next;
+        }
+        free(st);
+    }
+}
+
+tls_staple_entry_t *tls_staple_find(tls_staple_t *st, X509 *cert)
+{
+    tls_staple_entry_t *e = st->head;
+
+    // certificates are shared by the certificate cache, so the pointer
+    // comparison hits in the common case
+    for (; e; e = e->next) {
+        if (e->cert == cert) {
+            return e;
+        }
+    }
+    for (e = st->head; e; e = e->next) {
+        if (X509_cmp(e->cert, cert) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static tls_staple_entry_t *get_entry(tls_staple_t *st, X509 *cert)
+{
+    tls_staple_entry_t *e = tls_staple_find(st, cert);
+
+    if (e) {
+        return e;
+    } else if (!(e = calloc(1, sizeof(tls_staple_entry_t)))) {
+        return NULL;
+    } else if (X509_up_ref(cert) != 1) {
+        free(e);
+        return NULL;
+    }
+    e->cert  = cert;
+    e->next  = st->head;
+    st->head = e;
+    return e;
+}
+
+void tls_staple_remove(tls_staple_t *st, X509 *cert)
+{
+    tls_staple_entry_t **slot = &st->head;
+
+    while (*slot) {
+        tls_staple_entry_t *e = *slot;
+        if (X509_cmp(e->cert, cert) == 0) {
+            *slot = e->next;
+            free_entry(e);
+            return;
+        }
+        slot = &e->next;
+    }
+}
+
+X509 *tls_staple_find_issuer(X509 *cert, STACK_OF(X509) *chain)
+{
+    for (int i = 0; i < sk_X509_num(chain); i++) {
+        X509 *issuer = sk_X509_value(chain, i);
+        if (X509_check_issued(issuer, cert) == X509_V_OK) {
+            return issuer;
+        }
+    }
+    return NULL;
+}
+
+static time_t to_time(const ASN1_GENERALIZEDTIME *t, time_t now)
+{
+    int days = 0;
+    int secs = 0;
+
+    if (!t || !ASN1_TIME_diff(&days, &secs, NULL, t)) {
+        return 0;
+    }
+    return now + (time_t)days * 86400 + secs;
+}
+
+/**
+ * @brief Get thisUpdate and nextUpdate of the status of @p cert.  A response
+ * is never matched without the CertID, since it may hold the statuses of
+ * other certificates.
+ *
+ * @return 1 on success, 0 if the response has no such status.
+ */
+static int get_update_times(OCSP_BASICRESP *basic, X509 *cert, X509 *issuer,
+                            time_t now, time_t *thisupd, time_t *nextupd)
+{
+    ASN1_GENERALIZEDTIME *tu = NULL;
+    ASN1_GENERALIZEDTIME *nu = NULL;
+    OCSP_SINGLERESP *single  = NULL;
+    OCSP_CERTID *id          = NULL;
+    int idx                  = 0;
+
+    if (!issuer || !(id = OCSP_cert_to_id(NULL, cert, issuer))) {
+        return 0;
+    }
+    idx = OCSP_resp_find(basic, id, -1);
+    OCSP_CERTID_free(id);
+    if (idx < 0 || !(single = OCSP_resp_get0(basic, idx)) ||
+        OCSP_single_get0_status(single, NULL, NULL, &tu, &nu) < 0) {
+        return 0;
+    }
+    *thisupd = to_time(tu, now);
+    *nextupd = to_time(nu, now);
+    return 1;
+}
+
+tls_staple_entry_t *tls_staple_set(tls_staple_t *st, X509 *cert,
+                                   X509 *issuer, const unsigned char *der,
+                                   size_t len, time_t now)
+{
+    const unsigned char *p = der;
+    OCSP_RESPONSE *resp    = NULL;
+    OCSP_BASICRESP *basic  = NULL;
+    tls_staple_entry_t *e  = NULL;
+    unsigned char *copy    = NULL;
+    time_t thisupd         = 0;
+    time_t nextupd         = 0;
+
+    if (len > LONG_MAX || !(resp = d2i_OCSP_RESPONSE(NULL, &p, (long)len))) {
+        return NULL;
+    } else if (OCSP_response_status(resp) != OCSP_RESPONSE_STATUS_SUCCESSFUL ||
+               !(basic = OCSP_response_get1_basic(resp)) ||
+               !get_update_times(basic, cert, issuer, now, &thisupd,
+                                 &nextupd) ||
+               (nextupd && nextupd <= now) ||
+               !(copy = OPENSSL_malloc(len)) || !(e = get_entry(st, cert)) ||
+               (e->issuer != issuer && X509_up_ref(issuer) != 1)) {
+        OPENSSL_free(copy);
+        OCSP_BASICRESP_free(basic);
+        OCSP_RESPONSE_free(resp);
+        return NULL;
+    }
+    OCSP_BASICRESP_free(basic);
+    OCSP_RESPONSE_free(resp);
+
+    if (e->issuer != issuer) {
+        X509_free(e->issuer);
+        e->issuer = issuer;
+    }
+    memcpy(copy, der, len);
+    OPENSSL_free(e->der);
+    e->der         = copy;
+    e->len         = len;
+    e->next_update = nextupd;
+    if (!nextupd) {
+        e->refresh_at = now + TLS_STAPLE_DEFAULT_INTERVAL;
+    } else {
+        // refresh halfway to nextUpdate so that a failed fetch can be
+        // retried before the stapled response expires
+        if (!thisupd || thisupd > now) {
+            thisupd = now;
+        }
+        e->refresh_at = thisupd + (nextupd - thisupd) / 2;
+    }
+    return e;
+}
+
+tls_staple_entry_t *tls_staple_request(tls_staple_t *st, X509 *cert,
+                                       X509 *issuer)
+{
+    tls_staple_entry_t *e = get_entry(st, cert);
+
+    // a new entry has refresh_at 0, so it is fetched by the next refresh
+    if (e && !e->issuer && issuer) {
+        if (X509_up_ref(issuer) != 1) {
+            return NULL;
+        }
+        e->issuer = issuer;
+    }
+    return e;
+}
+
+tls_staple_entry_t *tls_staple_set_failed(tls_staple_t *st, X509 *cert,
+                                          time_t now)
+{
+    tls_staple_entry_t *e = get_entry(st, cert);
+
+    if (e) {
+        e->refresh_at = now + TLS_STAPLE_RETRY_INTERVAL;
+        if (!tls_staple_is_valid(e, now)) {
+            OPENSSL_free(e->der);
+            e->der = NULL;
+            e->len = 0;
+        }
+    }
+    return e;
+}
@@ -0,0 +1,133 @@
+/**
+ *  Copyright (C) 2026 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef net_tls_staple_h
+#define net_tls_staple_h
+
+#include <openssl/ocsp.h>
+#include <openssl/x509.h>
+#include <stddef.h>
+#include <time.h>
+
+/** @brief Retry interval of a certificate whose response could not be
+ * fetched. */
+#define TLS_STAPLE_RETRY_INTERVAL 60
+
+/** @brief Refresh interval of a response that has no nextUpdate. */
+#define TLS_STAPLE_DEFAULT_INTERVAL 3600
+
+/**
+ * @brief OCSP response stapled for one certificate.
+ */
+typedef struct tls_staple_entry_t {
+    struct tls_staple_entry_t *next;
+    X509 *cert;         /**< certificate the response belongs to */
+    X509 *issuer;       /**< issuer of cert; NULL if unknown */
+    unsigned char *der; /**< DER encoded response; NULL if not available */
+    size_t len;         /**< length of der */
+    time_t next_update; /**< nextUpdate of the response; 0 if absent */
+    time_t refresh_at;  /**< time to fetch a new response */
+} tls_staple_entry_t;
+
+/**
+ * @brief Per-certificate cache of OCSP responses.
+ */
+typedef struct {
+    tls_staple_entry_t *head;
+} tls_staple_t;
+
+/**
+ * @brief Allocate an empty cache.
+ *
+ * @return New cache, or NULL on allocation failure.
+ */
+tls_staple_t *tls_staple_new(void);
+
+/**
+ * @brief Release every entry, then the cache itself.
+ *
+ * @param st Cache to free; may be NULL.
+ */
+void tls_staple_free(tls_staple_t *st);
+
+/**
+ * @brief Find the entry of @p cert.
+ *
+ * @return Entry, or NULL if @p cert has no entry.
+ */
+tls_staple_entry_t *tls_staple_find(tls_staple_t *st, X509 *cert);
+
+/**
+ * @brief Store the DER encoded OCSP response @p der for @p cert.
+ *
+ * The response must be successful and must contain the status of @p cert,
+ * so it is refused if @p issuer is unknown.  The refresh time is set halfway
+ * between thisUpdate and nextUpdate of that status.
+ *
+ * @param issuer Issuer of @p cert; may be NULL, in which case it fails.
+ * @return       Entry on success, or NULL on failure with the OpenSSL error
+ *               queue set.
+ */
+tls_staple_entry_t *tls_staple_set(tls_staple_t *st, X509 *cert,
+                                   X509 *issuer, const unsigned char *der,
+                                   size_t len, time_t now);
+
+/**
+ * @brief Record that a response is wanted for @p cert.  A new entry is due
+ * for refresh immediately; the refresh time of an existing entry is kept.
+ *
+ * @param issuer Issuer of @p cert; stored if the entry has none.  May be NULL.
+ * @return       Entry, or NULL on allocation failure.
+ */
+tls_staple_entry_t *tls_staple_request(tls_staple_t *st, X509 *cert,
+                                       X509 *issuer);
+
+/**
+ * @brief Record that no response is available for @p cert, so that it is
+ * fetched again after TLS_STAPLE_RETRY_INTERVAL.  A response that is still
+ * valid is kept.
+ *
+ * @return Entry, or NULL on allocation failure.
+ */
+tls_staple_entry_t *tls_staple_set_failed(tls_staple_t *st, X509 *cert,
+                                          time_t now);
+
+/**
+ * @brief Remove the entry of @p cert.
+ */
+void tls_staple_remove(tls_staple_t *st, X509 *cert);
+
+/**
+ * @brief Return non-zero if the entry holds a response that can be stapled
+ * at @p now.
+ */
+static inline int tls_staple_is_valid(const tls_staple_entry_t *e, time_t now)
+{
+    return e && e->der && (!e->next_update || now < e->next_update);
+}
+
+/**
+ * @brief Return the certificate in @p chain that issued @p cert, or NULL.
+ */
+X509 *tls_staple_find_issuer(X509 *cert, STACK_OF(X509) *chain);
+
+#endif /* net_tls_staple_h */
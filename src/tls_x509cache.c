@@ -0,0 +1,655 @@
+/**
+ *  Copyright (C) 2026 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *
+ * Parsed certificate chains and X509_STORE objects are cached per module,
+ * keyed by a digest of their sources, so that contexts created from the same
+ * files or blobs share one copy instead of parsing them again.  This file is
+ * compiled into both net.tls.client and net.tls.server, and each module has
+ * its own cache; a client and a server that load the same file do not share
+ * the parsed objects.
+ *
+ * A store is never modified once it is cached: adding CA certificates or
+ * CRLs to a store derives a new store whose key chains the key of the base
+ * store.  Stores are freed when their last user releases them, and chains,
+ * which are only needed while a context is configured, are kept in LRU order
+ * up to TLS_X509CACHE_MAX_CHAINS.
+ */
+#include "tls_x509cache.h"
+#include "tls_digest.h"
+#include <limits.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+typedef struct x509chain_t {
+    struct x509chain_t *next;
+    unsigned char key[TLS_X509CACHE_KEYLEN];
+    STACK_OF(X509) *certs; /**< leaf first */
+} x509chain_t;
+
+static pthread_mutex_t CacheLock = PTHREAD_MUTEX_INITIALIZER;
+static x509chain_t *Chains       = NULL;
+static size_t NChains            = 0;
+static tls_x509store_t *Stores   = NULL;
+
+static int is_der(const char *src, size_t len)
+{
+    // certificates, keys and CRLs are ASN.1 SEQUENCEs that are too long for
+    // the short length form; no sane file path starts with these two bytes.
+    return len >= 2 && (unsigned char)src[0] == 0x30 &&
+           ((unsigned char)src[1] & 0x80);
+}
+
+static int is_pem(const char *src, size_t len)
+{
+    static const char header[] = "-----BEGIN ";
+    const size_t hlen          = sizeof(header) - 1;
+
+    if (is_der(src, len)) {
+        return 0;
+    }
+    // PEM readers skip the text before the first header, such as the dump
+    // that `openssl ca` and `openssl x509 -text` write before the PEM block
+    for (; len >= hlen; src++, len--) {
+        if (*src == '-' && memcmp(src, header, hlen) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int tls_x509cache_is_blob(const char *src, size_t len)
+{
+    return is_pem(src, len) || is_der(src, len);
+}
+
+/**
+ * @brief Open @p src as a memory BIO; file contents are read into memory so
+ * that PEM and DER can be told apart.
+ *
+ * @param secure Use secure heap for file contents (private keys).
+ */
+static BIO *source_bio(const char *src, size_t len, int secure)
+{
+    BIO *file = NULL;
+    BIO *mem  = NULL;
+    char buf[4096];
+    int n = 0;
+
+    if (tls_x509cache_is_blob(src, len)) {
+        return (len > INT_MAX) ? NULL : BIO_new_mem_buf(src, (int)len);
+    } else if (!(file = BIO_new_file(src, "rb"))) {
+        return NULL;
+    }
+
+    mem = BIO_new(secure ? BIO_s_secmem() : BIO_s_mem());
+    while (mem && (n = BIO_read(file, buf, sizeof(buf))) > 0) {
+        if (BIO_write(mem, buf, n) != n) {
+            BIO_free(mem);
+            mem = NULL;
+        }
+    }
+    OPENSSL_cleanse(buf, sizeof(buf));
+    BIO_free(file);
+    return mem;
+}
+
+/**
+ * @brief Read PEM or DER encoded certificates and CRLs from @p bio.
+ *
+ * PEM input may mix both kinds.  DER input is read as a sequence of
+ * certificates if @p certs is given, otherwise as a sequence of CRLs.
+ *
+ * @return 1 on success, 0 on failure.
+ */
+static int read_objects(BIO *bio, STACK_OF(X509) *certs,
+                        STACK_OF(X509_CRL) *crls)
+{
+    char *data = NULL;
+    long n     = BIO_get_mem_data(bio, &data);
+
+    if (n > 0 && is_pem(data, (size_t)n)) {
+        STACK_OF(X509_INFO) *inf = PEM_X509_INFO_read_bio(bio, NULL, NULL,
+                                                          NULL);
+        int rv                   = inf != NULL;
+
+        for (int i = 0; rv && i < sk_X509_INFO_num(inf); i++) {
+            X509_INFO *it = sk_X509_INFO_value(inf, i);
+            if (certs && it->x509) {
+                rv = sk_X509_push(certs, it->x509) > 0;
+                if (rv) {
+                    it->x509 = NULL;
+                }
+            }
+            if (rv && crls && it->crl) {
+                rv = sk_X509_CRL_push(crls, it->crl) > 0;
+                if (rv) {
+                    it->crl = NULL;
+                }
+            }
+        }
+        if (inf) {
+            sk_X509_INFO_pop_free(inf, X509_INFO_free);
+        }
+        return rv;
+    }
+
+    // a sequence of DER encoded objects
+    while (!BIO_eof(bio)) {
+        if (certs) {
+            X509 *x = d2i_X509_bio(bio, NULL);
+            if (!x) {
+                return 0;
+            } else if (sk_X509_push(certs, x) <= 0) {
+                X509_free(x);
+                return 0;
+            }
+        } else {
+            X509_CRL *crl = d2i_X509_CRL_bio(bio, NULL);
+            if (!crl) {
+                return 0;
+            } else if (sk_X509_CRL_push(crls, crl) <= 0) {
+                X509_CRL_free(crl);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+int tls_x509cache_read(const char *src, size_t len, STACK_OF(X509) *certs,
+                       STACK_OF(X509_CRL) *crls)
+{
+    BIO *bio = source_bio(src, len, 0);
+    int rv   = bio && read_objects(bio, certs, crls);
+
+    BIO_free(bio);
+    return rv;
+}
+
+static int digest_source(EVP_MD_CTX *md, const char *src, size_t len,
+                         int blob)
+{
+    struct {
+        dev_t dev;
+        ino_t ino;
+        off_t size;
+        time_t mtime;
+        time_t ctime;
+    } id;
+    struct stat st = {0};
+
+    if (blob || tls_x509cache_is_blob(src, len)) {
+        return EVP_DigestUpdate(md, "m", 1) && EVP_DigestUpdate(md, src, len);
+    } else if (stat(src, &st) != 0) {
+        // let the loader report the error
+        return 0;
+    }
+
+    // a file is identified by its path and the stat(2) result, so a file
+    // that is replaced or rewritten is parsed again.
+    memset(&id, 0, sizeof(id));
+    id.dev   = st.st_dev;
+    id.ino   = st.st_ino;
+    id.size  = st.st_size;
+    id.mtime = st.st_mtime;
+    id.ctime = st.st_ctime;
+    return EVP_DigestUpdate(md, "f", 1) &&
+           EVP_DigestUpdate(md, src, strlen(src) + 1) &&
+           EVP_DigestUpdate(md, &id, sizeof(id));
+}
+
+/**
+ * @brief Compute the cache key of an object made of @p base plus @p src and
+ * @p capath.
+ *
+ * @return 1 on success, 0 if the sources cannot be identified.
+ */
+static int make_key(unsigned char *key, const char *tag,
+                    const tls_x509store_t *base, const char *src, size_t len,
+                    int blob, const char *capath)
+{
+    EVP_MD_CTX *md = EVP_MD_CTX_new();
+    unsigned int n = 0;
+    int rv         = 0;
+
+    if (md && EVP_DigestInit_ex(md, tls_digest_sha256(), NULL) &&
+        EVP_DigestUpdate(md, tag, strlen(tag) + 1) &&
+        (!base || EVP_DigestUpdate(md, base->key, TLS_X509CACHE_KEYLEN)) &&
+        (!src || digest_source(md, src, len, blob))) {
+        if (capath) {
+            rv = EVP_DigestUpdate(md, "d", 1) &&
+                 EVP_DigestUpdate(md, capath, strlen(capath) + 1);
+        } else {
+            rv = 1;
+        }
+        rv = rv && EVP_DigestFinal_ex(md, key, &n);
+    }
+    EVP_MD_CTX_free(md);
+    return rv;
+}
+
+static STACK_OF(X509) *read_chain(const char *src, size_t len)
+{
+    STACK_OF(X509) *certs = sk_X509_new_null();
+    BIO *bio              = NULL;
+
+    if (!certs) {
+        return NULL;
+    } else if (!(bio = source_bio(src, len, 0)) ||
+               read_objects(bio, certs, NULL) != 1 ||
+               sk_X509_num(certs) == 0) {
+        BIO_free(bio);
+        sk_X509_pop_free(certs, X509_free);
+        return NULL;
+    }
+    BIO_free(bio);
+    return certs;
+}
+
+/**
+ * @brief Return a new stack holding references to the cached certificates of
+ * @p src, parsing and caching them on the first call.
+ */
+static STACK_OF(X509) *get_chain(const char *src, size_t len)
+{
+    unsigned char key[TLS_X509CACHE_KEYLEN];
+    int cacheable         = make_key(key, "chain", NULL, src, len, 0, NULL);
+    STACK_OF(X509) *certs = NULL;
+    x509chain_t *e        = NULL;
+
+    if (!cacheable) {
+        return read_chain(src, len);
+    }
+
+    pthread_mutex_lock(&CacheLock);
+    for (x509chain_t **slot = &Chains; (e = *slot); slot = &e->next) {
+        if (memcmp(e->key, key, TLS_X509CACHE_KEYLEN) == 0) {
+            // move to front
+            *slot   = e->next;
+            e->next = Chains;
+            Chains  = e;
+            certs   = X509_chain_up_ref(e->certs);
+            pthread_mutex_unlock(&CacheLock);
+            return certs;
+        }
+    }
+
+    if ((certs = read_chain(src, len))) {
+        // failing to cache the chain is not an error
+        if ((e = malloc(sizeof(x509chain_t)))) {
+            memcpy(e->key, key, TLS_X509CACHE_KEYLEN);
+            e->certs = X509_chain_up_ref(certs);
+            if (e->certs) {
+                e->next = Chains;
+                Chains  = e;
+                NChains++;
+            } else {
+                free(e);
+            }
+        }
+        // drop the least recently used chain; a file that was modified is
+        // keyed differently, so its previous chain is eventually dropped here
+        if (NChains > TLS_X509CACHE_MAX_CHAINS) {
+            x509chain_t **slot = &Chains;
+            while ((*slot)->next) {
+                slot = &(*slot)->next;
+            }
+            sk_X509_pop_free((*slot)->certs, X509_free);
+            free(*slot);
+            *slot = NULL;
+            NChains--;
+        }
+    }
+    pthread_mutex_unlock(&CacheLock);
+    return certs;
+}
+
+int tls_x509cache_use_chain(SSL_CTX *ctx, const char *src, size_t len)
+{
+    STACK_OF(X509) *certs = get_chain(src, len);
+    int rv                = 0;
+
+    if (!certs) {
+        return 0;
+    }
+    // leaf certificate followed by the intermediate CAs, as in
+    // SSL_CTX_use_certificate_chain_file()
+    if (SSL_CTX_use_certificate(ctx, sk_X509_value(certs, 0)) == 1 &&
+        SSL_CTX_clear_chain_certs(ctx) == 1) {
+        rv = 1;
+        for (int i = 1; rv && i < sk_X509_num(certs); i++) {
+            rv = SSL_CTX_add1_chain_cert(ctx, sk_X509_value(certs, i)) == 1;
+        }
+    }
+    sk_X509_pop_free(certs, X509_free);
+    return rv;
+}
+
+int tls_x509cache_use_key(SSL_CTX *ctx, const char *src, size_t len)
+{
+    BIO *bio      = source_bio(src, len, 1);
+    EVP_PKEY *key = NULL;
+    char *data    = NULL;
+    long n        = 0;
+    int rv        = 0;
+
+    if (!bio) {
+        return 0;
+    }
+    n   = BIO_get_mem_data(bio, &data);
+    key = (n > 0 && is_pem(data, (size_t)n)) ?
+              PEM_read_bio_PrivateKey(bio, NULL, NULL, NULL) :
+              d2i_PrivateKey_bio(bio, NULL);
+    if (key) {
+        rv = SSL_CTX_use_PrivateKey(ctx, key);
+        EVP_PKEY_free(key);
+    }
+    BIO_free(bio);
+    return rv;
+}
+
+static int copy_objects(X509_STORE *dst, X509_STORE *src)
+{
+    STACK_OF(X509_OBJECT) *objs = NULL;
+    int rv                      = 1;
+
+    // hashed directory lookups may add objects to a shared store at any time
+    if (X509_STORE_lock(src) != 1) {
+        return 0;
+    }
+    objs = X509_STORE_get0_objects(src);
+    for (int i = 0; rv && i < sk_X509_OBJECT_num(objs); i++) {
+        X509_OBJECT *obj = sk_X509_OBJECT_value(objs, i);
+
+        switch (X509_OBJECT_get_type(obj)) {
+        case X509_LU_X509:
+            rv = X509_STORE_add_cert(dst, X509_OBJECT_get0_X509(obj));
+            break;
+        case X509_LU_CRL:
+            rv = X509_STORE_add_crl(dst, X509_OBJECT_get0_X509_CRL(obj));
+            break;
+        default:
+            break;
+        }
+    }
+    X509_STORE_unlock(src);
+    return rv;
+}
+
+static char *join_dirs(const char *dirs, const char *capath)
+{
+    size_t len = (dirs ? strlen(dirs) + 1 : 0) + strlen(capath) + 1;
+    char *buf  = malloc(len);
+
+    if (buf) {
+        if (dirs) {
+            strcpy(buf, dirs);
+            strcat(buf, ":");
+            strcat(buf, capath);
+        } else {
+            strcpy(buf, capath);
+        }
+    }
+    return buf;
+}
+
+static void free_store(tls_x509store_t *st)
+{
+    if (st) {
+        X509_STORE_free(st->store);
+        free(st->dirs);
+        free(st);
+    }
+}
+
+/**
+ * @brief Create an uncached store that holds the objects, parameters and
+ * directory lookups of @p base, plus the hashed directory @p capath.
+ */
+static tls_x509store_t *new_store(const unsigned char *key,
+                                  const tls_x509store_t *base,
+                                  const char *capath)
+{
+    tls_x509store_t *st = calloc(1, sizeof(tls_x509store_t));
+    X509_LOOKUP *lu     = NULL;
+
+    if (!st) {
+        return NULL;
+    }
+    memcpy(st->key, key, TLS_X509CACHE_KEYLEN);
+    if (!(st->store = X509_STORE_new())) {
+        goto FAIL;
+    } else if (base) {
+        st->default_paths = base->default_paths;
+        if (copy_objects(st->store, base->store) != 1 ||
+            X509_VERIFY_PARAM_set1(X509_STORE_get0_param(st->store),
+                                   X509_STORE_get0_param(base->store)) != 1) {
+            goto FAIL;
+        }
+        if (base->dirs && !(st->dirs = strdup(base->dirs))) {
+            goto FAIL;
+        }
+    }
+    if (capath) {
+        char *dirs = join_dirs(st->dirs, capath);
+        if (!dirs) {
+            goto FAIL;
+        }
+        free(st->dirs);
+        st->dirs = dirs;
+    }
+
+    // hashed directories are looked up lazily, so they are installed again
+    // instead of being copied
+    if (st->default_paths || st->dirs) {
+        lu = X509_STORE_add_lookup(st->store, X509_LOOKUP_hash_dir());
+        if (!lu ||
+            (st->default_paths &&
+             X509_LOOKUP_add_dir(lu, NULL, X509_FILETYPE_DEFAULT) != 1) ||
+            (st->dirs &&
+             X509_LOOKUP_add_dir(lu, st->dirs, X509_FILETYPE_PEM) != 1)) {
+            goto FAIL;
+        }
+    }
+    return st;
+
+FAIL:
+    free_store(st);
+    return NULL;
+}
+
+// must be called with CacheLock held; returns a new reference
+static const tls_x509store_t *find_store(const unsigned char *key)
+{
+    for (tls_x509store_t *st = Stores; st; st = st->next) {
+        if (memcmp(st->key, key, TLS_X509CACHE_KEYLEN) == 0) {
+            st->refcnt++;
+            return st;
+        }
+    }
+    return NULL;
+}
+
+// must be called with CacheLock held; returns the reference of the caller
+static const tls_x509store_t *insert_store(tls_x509store_t *st)
+{
+    st->refcnt = 1;
+    st->next   = Stores;
+    Stores     = st;
+    return st;
+}
+
+void tls_x509cache_release(const tls_x509store_t *st)
+{
+    tls_x509store_t **slot = &Stores;
+
+    if (!st) {
+        return;
+    }
+    pthread_mutex_lock(&CacheLock);
+    if (--((tls_x509store_t *)st)->refcnt == 0) {
+        while (*slot != st) {
+            slot = &(*slot)->next;
+        }
+        *slot = st->next;
+        free_store((tls_x509store_t *)st);
+    }
+    pthread_mutex_unlock(&CacheLock);
+}
+
+const tls_x509store_t *tls_x509cache_default_store(void)
+{
+    unsigned char key[TLS_X509CACHE_KEYLEN];
+    const tls_x509store_t *found = NULL;
+    tls_x509store_t *st          = NULL;
+
+    if (!make_key(key, "default", NULL, NULL, 0, 0, NULL)) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&CacheLock);
+    if (!(found = find_store(key)) && (st = new_store(key, NULL, NULL))) {
+        if (X509_STORE_set_default_paths(st->store) != 1) {
+            free_store(st);
+        } else {
+            st->default_paths = 1;
+            found             = insert_store(st);
+            // held by the cache for the lifetime of the process
+            st->refcnt++;
+        }
+    }
+    pthread_mutex_unlock(&CacheLock);
+    return found;
+}
+
+static int add_ca(X509_STORE *store, const char *ca, size_t len)
+{
+    STACK_OF(X509) *certs    = sk_X509_new_null();
+    STACK_OF(X509_CRL) *crls = sk_X509_CRL_new_null();
+    BIO *bio                 = NULL;
+    int rv                   = 0;
+
+    if (certs && crls && (bio = source_bio(ca, len, 0)) &&
+        read_objects(bio, certs, crls) == 1 &&
+        // refuse a file without any object, as X509_load_cert_crl_file()
+        sk_X509_num(certs) + sk_X509_CRL_num(crls) > 0) {
+        rv = 1;
+        for (int i = 0; rv && i < sk_X509_num(certs); i++) {
+            rv = X509_STORE_add_cert(store, sk_X509_value(certs, i));
+        }
+        for (int i = 0; rv && i < sk_X509_CRL_num(crls); i++) {
+            rv = X509_STORE_add_crl(store, sk_X509_CRL_value(crls, i));
+        }
+    }
+    BIO_free(bio);
+    sk_X509_pop_free(certs, X509_free);
+    sk_X509_CRL_pop_free(crls, X509_CRL_free);
+    return rv;
+}
+
+const tls_x509store_t *tls_x509cache_add_ca(const tls_x509store_t *base,
+                                            const char *ca, size_t len,
+                                            const char *capath)
+{
+    unsigned char key[TLS_X509CACHE_KEYLEN];
+    const tls_x509store_t *found = NULL;
+    tls_x509store_t *st          = NULL;
+
+    if (!make_key(key, "ca", base, ca, len, 0, capath)) {
+        // the CA file cannot be identified; let OpenSSL report the reason
+        // with a throwaway store.
+        X509_STORE *tmp = X509_STORE_new();
+        if (tmp && ca) {
+            add_ca(tmp, ca, len);
+        }
+        X509_STORE_free(tmp);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&CacheLock);
+    if (!(found = find_store(key)) && (st = new_store(key, base, capath))) {
+        if (ca && add_ca(st->store, ca, len) != 1) {
+            free_store(st);
+        } else {
+            found = insert_store(st);
+        }
+    }
+    pthread_mutex_unlock(&CacheLock);
+    return found;
+}
+
+const tls_x509store_t *tls_x509cache_add_crl(const tls_x509store_t *base,
+                                             const char *crl, size_t len)
+{
+    unsigned char key[TLS_X509CACHE_KEYLEN];
+    const tls_x509store_t *found = NULL;
+    tls_x509store_t *st          = NULL;
+
+    if (!make_key(key, "crl", base, crl, len, 1, NULL)) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&CacheLock);
+    if (!(found = find_store(key)) && (st = new_store(key, base, NULL))) {
+        STACK_OF(X509_CRL) *crls = sk_X509_CRL_new_null();
+        BIO *bio                 = NULL;
+        int rv                   = 0;
+
+        if (crls && len <= INT_MAX &&
+            (bio = BIO_new_mem_buf(crl, (int)len)) &&
+            read_objects(bio, NULL, crls) == 1) {
+            rv = 1;
+            for (int i = 0; rv && i < sk_X509_CRL_num(crls); i++) {
+                rv = X509_STORE_add_crl(st->store, sk_X509_CRL_value(crls, i));
+            }
+            // enable CRL checking for the entire certificate chain and also
+            // enable CRL checking for leaf certificate
+            rv = rv && X509_STORE_set_flags(st->store,
+                                            X509_V_FLAG_CRL_CHECK |
+                                                X509_V_FLAG_CRL_CHECK_ALL);
+        }
+        BIO_free(bio);
+        sk_X509_CRL_pop_free(crls, X509_CRL_free);
+        if (rv) {
+            found = insert_store(st);
+        } else {
+            free_store(st);
+        }
+    }
+    pthread_mutex_unlock(&CacheLock);
+    return found;
+}
+
+int tls_x509cache_use_store(SSL_CTX *ctx, const tls_x509store_t *st)
+{
+    if (X509_STORE_up_ref(st->store) != 1) {
+        return 0;
+    }
+    // releases the previous store of ctx
+    SSL_CTX_set_cert_store(ctx, st->store);
+    return 1;
+}
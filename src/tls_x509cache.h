@@ -0,0 +1,138 @@
+/**
+ *  Copyright (C) 2026 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef net_tls_x509cache_h
+#define net_tls_x509cache_h
+
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <stddef.h>
+
+/** @brief Length of a cache key (SHA-256 digest). */
+#define TLS_X509CACHE_KEYLEN 32
+
+/** @brief Maximum number of parsed certificate chains kept in the cache. */
+#define TLS_X509CACHE_MAX_CHAINS 64
+
+/**
+ * @brief Shared, read-only certificate store.
+ *
+ * Entries are owned by the cache of the module and are reference counted;
+ * every store returned by the functions below holds a reference that must be
+ * released by tls_x509cache_release().  The X509_STORE must not be modified;
+ * derive a new entry instead.
+ */
+typedef struct tls_x509store_t {
+    struct tls_x509store_t *next;              /**< cache list */
+    unsigned char key[TLS_X509CACHE_KEYLEN]; /**< digest of the sources */
+    X509_STORE *store;                         /**< shared store */
+    size_t refcnt;     /**< number of references; guarded by the cache */
+    char *dirs;        /**< colon separated hashed directories or NULL */
+    int default_paths; /**< lookups of the default paths are installed */
+} tls_x509store_t;
+
+/**
+ * @brief Return non-zero if @p src holds a PEM or DER encoded object rather
+ * than a file path.
+ */
+int tls_x509cache_is_blob(const char *src, size_t len);
+
+/**
+ * @brief Read the certificates and CRLs of a file path or a PEM/DER blob.
+ *
+ * PEM input may mix both kinds.  DER input is read as a sequence of
+ * certificates if @p certs is given, otherwise as a sequence of CRLs.  The
+ * objects are not cached.
+ *
+ * @param certs Stack to append the certificates to; may be NULL.
+ * @param crls  Stack to append the CRLs to; may be NULL.
+ * @return      1 on success, 0 on failure with the OpenSSL error queue set.
+ */
+int tls_x509cache_read(const char *src, size_t len, STACK_OF(X509) *certs,
+                       STACK_OF(X509_CRL) *crls);
+
+/**
+ * @brief Set the certificate chain of @p ctx from a file path or a PEM/DER
+ * blob.  The parsed certificates are cached and shared between contexts; the
+ * least recently used chains are dropped beyond TLS_X509CACHE_MAX_CHAINS.
+ *
+ * The first certificate is used as the leaf and the rest as the chain, as in
+ * SSL_CTX_use_certificate_chain_file().
+ *
+ * @return 1 on success, 0 on failure with the OpenSSL error queue set.
+ */
+int tls_x509cache_use_chain(SSL_CTX *ctx, const char *src, size_t len);
+
+/**
+ * @brief Set the private key of @p ctx from a file path or a PEM/DER blob.
+ * Private keys are parsed every time and never cached.
+ *
+ * @return 1 on success, 0 on failure with the OpenSSL error queue set.
+ */
+int tls_x509cache_use_key(SSL_CTX *ctx, const char *src, size_t len);
+
+/**
+ * @brief Return the store that holds the default verify paths.  The cache
+ * keeps a reference of its own, so the default paths are loaded only once.
+ *
+ * @return Shared store, or NULL on failure with the OpenSSL error queue set.
+ */
+const tls_x509store_t *tls_x509cache_default_store(void);
+
+/**
+ * @brief Return the store made of @p base plus the CA certificates of
+ * @p ca (a file path or a PEM/DER blob; may be NULL) and the hashed
+ * directory @p capath (may be NULL).
+ *
+ * File sources are keyed by their path and stat(2) result, so a modified
+ * file is parsed again.
+ *
+ * @return Shared store, or NULL on failure with the OpenSSL error queue set.
+ */
+const tls_x509store_t *tls_x509cache_add_ca(const tls_x509store_t *base,
+                                            const char *ca, size_t len,
+                                            const char *capath);
+
+/**
+ * @brief Return the store made of @p base plus the CRLs in the PEM/DER
+ * blob @p crl, with CRL checking enabled for the entire chain.
+ *
+ * @return Shared store, or NULL on failure with the OpenSSL error queue set.
+ */
+const tls_x509store_t *tls_x509cache_add_crl(const tls_x509store_t *base,
+                                             const char *crl, size_t len);
+
+/**
+ * @brief Release a reference to @p st, freeing it with the last one.  A
+ * context that uses the store keeps its own reference to the X509_STORE.
+ * @p st may be NULL.
+ */
+void tls_x509cache_release(const tls_x509store_t *st);
+
+/**
+ * @brief Make @p ctx verify peers against the shared store @p st.
+ *
+ * @return 1 on success, 0 on failure.
+ */
+int tls_x509cache_use_store(SSL_CTX *ctx, const tls_x509store_t *st);
+
+#endif /* net_tls_x509cache_h */
@@ -0,0 +1,117 @@
+/**
+ *  Copyright (C) 2026 Masatoshi Fukunaga
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to
+ *  deal in the Software without restriction, including without limitation the
+ *  rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ *  sell copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ */
+
+
+// project
+#include "net_socket.h"
+
+struct net_wqnode_t {
+    net_wqnode_t *next;
+    size_t len;
+    char data[];
+};
+
+int net_wqueue_push(net_wqueue_t *q, const char *str, size_t len)
+{
+    net_wqnode_t *node = malloc(sizeof(net_wqnode_t) + len);
+
+    if (!node) {
+        return -1;
+    }
+    node->next = NULL;
+    node->len  = len;
+    memcpy(node->data, str, len);
+    if (q->tail) {
+        q->tail->next = node;
+    } else {
+        q->head = node;
+    }
+    q->tail = node;
+    q->len += len;
+    return 0;
+}
+
+// discard n bytes from the head of the queue
+static void consume(net_wqueue_t *q, size_t n)
+{
+    q->len -= n;
+    while (n) {
+        net_wqnode_t *node = q->head;
+        size_t remain      = node->len - q->off;
+
+        if (n < remain) {
+            q->off += n;
+            return;
+        }
+        n -= remain;
+        q->off  = 0;
+        q->head = node->next;
+        free(node);
+    }
+    if (!q->head) {
+        q->tail = NULL;
+    }
+}
+
+ssize_t net_wqueue_send(net_wqueue_t *q, int fd, int stream)
+{
+    struct iovec iov[NET_IOVMAX];
+    struct msghdr msg  = {.msg_iov = iov};
+    net_wqnode_t *node = q->head;
+    size_t off         = q->off;
+    ssize_t n          = 0;
+
+    // a datagram socket sends one buffer per message
+    while (node && msg.msg_iovlen < (stream ? NET_IOVMAX : 1)) {
+        iov[msg.msg_iovlen].iov_base = node->data + off;
+        iov[msg.msg_iovlen].iov_len  = node->len - off;
+        msg.msg_iovlen++;
+        node = node->next;
+        off  = 0;
+    }
+    if (!msg.msg_iovlen) {
+        return 0;
+    }
+
+RETRY:
+    n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    if (n == -1) {
+        if (errno == EINTR) {
+            goto RETRY;
+        }
+        return -1;
+    }
+    consume(q, (size_t)n);
+    return n;
+}
+
+void net_wqueue_clear(net_wqueue_t *q)
+{
+    net_wqnode_t *node = q->head;
+
+    while (node) {
+        net_wqnode_t *next = node->next;
+        free(node);
+        node = next;
+    }
+    *q = (net_wqueue_t){0};
+}
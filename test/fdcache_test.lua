@@ -0,0 +1,120 @@
+require('luacov')
+local testcase = require('testcase')
+local assert = require('assert')
+local sleep = require('time.sleep')
+local error_is = require('error').is
+local errno = require('errno')
+local fdcache = require('net.fdcache')
+
+local PATHNAMES = {}
+
+function testcase.before_each()
+    for i = 1, 3 do
+        PATHNAMES[i] = os.tmpname()
+        local f = assert(io.open(PATHNAMES[i], 'w'))
+        f:write(string.rep('x', i))
+        f:close()
+    end
+end
+
+function testcase.after_each()
+    for _, pathname in ipairs(PATHNAMES) do
+        os.remove(pathname)
+    end
+end
+
+function testcase.new()
+    -- test that create new instance of net.fdcache
+    local cache = assert(fdcache.new())
+    assert.match(tostring(cache), '^net.fdcache: ', false)
+    assert.equal({
+        cache:limits(),
+    }, {
+        64,
+        1,
+    })
+    assert.match(tostring(fdcache.default), '^net.fdcache: ', false)
+
+    -- test that throws an error
+    assert.match(assert.throws(fdcache.new, 0), 'maxlen must be greater than 0',
+                 false)
+    assert.match(assert.throws(fdcache.new, 1, -1),
+                 'ttl must be unsigned number', false)
+end
+
+function testcase.open_release()
+    local cache = assert(fdcache.new(2, 60))
+
+    -- test that open returns the cached descriptor
+    local fd, size, mtime = assert(cache:open(PATHNAMES[1]))
+    assert.equal(size, 1)
+    assert.is_int(mtime)
+    assert.equal(cache:open(PATHNAMES[1]), fd)
+    assert.equal(cache:len(), 1)
+    assert.is_true(cache:release(fd))
+    assert.is_true(cache:release(fd))
+    assert.is_false(cache:release(fd))
+
+    -- test that the least recently used file is evicted
+    local fd2 = assert(cache:open(PATHNAMES[2]))
+    assert(cache:release(fd2))
+    local fd3 = assert(cache:open(PATHNAMES[3]))
+    assert(cache:release(fd3))
+    assert.equal(cache:len(), 2)
+    assert.is_false(cache:evict(PATHNAMES[1]))
+    assert.is_true(cache:evict(PATHNAMES[2]))
+    assert.equal(cache:len(), 1)
+    cache:clear()
+    assert.equal(cache:len(), 0)
+
+    -- test that returns an error
+    local _, err = cache:open(PATHNAMES[1] .. '-unknown')
+    assert.not_nil(error_is(err, errno.ENOENT))
+    _, err = cache:open('/')
+    assert.not_nil(error_is(err, errno.EISDIR))
+end
+
+function testcase.pread()
+    local cache = assert(fdcache.new(2, 60))
+    local fd = assert(cache:open(PATHNAMES[3]))
+
+    -- test that read from the referenced descriptor at the offset
+    assert.equal(assert(cache:pread(fd, 2)), 'xx')
+    assert.equal(assert(cache:pread(fd, 8, 1)), 'xx')
+    assert.equal(assert(cache:pread(fd, 8, 3)), '')
+
+    -- test that returns an error if the descriptor is not referenced
+    assert(cache:release(fd))
+    local _, err = cache:pread(fd, 2)
+    assert.not_nil(error_is(err, errno.EBADF))
+
+    -- test that throws an error
+    assert.match(assert.throws(cache.pread, cache, fd, -1),
+                 'count must be unsigned integer', false)
+end
+
+function testcase.revalidate()
+    local cache = assert(fdcache.new(8, 0.1))
+    local fd = assert(cache:open(PATHNAMES[1]))
+    assert(cache:release(fd))
+
+    -- test that the modified file is reopened after ttl
+    local f = assert(io.open(PATHNAMES[1], 'a'))
+    f:write('yy')
+    f:close()
+    local _, size = assert(cache:open(PATHNAMES[1]))
+    assert.equal(size, 1)
+    assert(cache:release(fd))
+    sleep(0.2)
+    local fd2
+    fd2, size = assert(cache:open(PATHNAMES[1]))
+    assert.equal(size, 3)
+    assert(cache:release(fd2))
+
+    -- test that the removed file is evicted after ttl
+    os.remove(PATHNAMES[1])
+    sleep(0.2)
+    local _, err = cache:open(PATHNAMES[1])
+    assert.not_nil(error_is(err, errno.ENOENT))
+    assert.equal(cache:len(), 0)
+end
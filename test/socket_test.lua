@@ -5584,6 +5584,94 @@ function testcase.read()
     b:close()
 end
 
+function testcase.timedread()
+    -- timedread() returns the seconds left until the deadline instead of
+    -- waiting, and the deadline that the caller passes to the next call.
+    local socks = assert(socket.pair({
+        socktype = 'stream',
+    }))
+    local a, b = socks[1], socks[2]
+    assert(a:rcvtimeo(0.2))
+
+    -- the deadline starts at the first EAGAIN
+    local msg, err, timeout, sec, deadl = a:timedread(16)
+    assert.is_nil(msg)
+    assert.is_nil(err)
+    assert.is_nil(timeout)
+    assert.less_or_equal(sec, 0.2)
+    assert.greater(sec, 0)
+    assert.is_number(deadl)
+
+    -- continued calls report the remaining time, then the timeout
+    timer.sleep(0.1)
+    msg, err, timeout, sec = a:timedread(16, deadl)
+    assert.is_nil(msg)
+    assert.less(sec, 0.11)
+
+    -- another operation starts its own deadline without moving this one
+    assert.greater(select(4, a:timedrecv(16)), 0.15)
+    timer.sleep(0.1)
+    msg, err, timeout, sec = a:timedread(16, deadl)
+    assert.is_nil(msg)
+    assert.is_nil(err)
+    assert.is_true(timeout)
+    assert.is_nil(sec)
+
+    -- data is returned without any deadline
+    assert(b:write('hello'))
+    assert(a:recvable(1))
+    assert.equal(a:timedread(16), 'hello')
+    assert(b:write('world'))
+    assert(a:recvable(1))
+    assert.equal(a:timedrecv(16, false, 'peek'), 'world')
+    assert.equal(a:timedrecv(16), 'world')
+
+    -- EOF returns nothing
+    b:close()
+    assert.is_nil(a:timedread(16))
+    a:close()
+end
+
+function testcase.timedwrite()
+    -- timedwrite() writes from the offset until the whole string is sent
+    local socks = assert(socket.pair({
+        socktype = 'stream',
+    }))
+    local a, b = socks[1], socks[2]
+    assert.equal(a:timedwrite('hello', 2), 5)
+    assert(b:recvable(1))
+    assert.equal(b:read(16), 'llo')
+
+    -- returns the offset of the unsent bytes when the buffer is full
+    local str = string.rep('x', 1024 * 1024)
+    local len, err, timeout, sec, deadl = a:timedwrite(str)
+    assert.less(len, #str)
+    assert.is_nil(err)
+    assert.is_nil(timeout)
+    assert.greater(sec, 0)
+    sec = a:deadline(true, deadl)
+    assert.greater(sec, 0)
+    assert.equal(select(2, a:deadline(true, deadl)), deadl)
+    len, err, timeout, sec = a:timedsend(str, len, deadl)
+    assert.less(len, #str)
+    assert.is_nil(err)
+    assert.greater(sec, 0)
+
+    -- empty string and out of range offset
+    len, err = a:timedwrite('')
+    assert.equal(len, 0)
+    assert(err)
+    err = assert.throws(a.timedwrite, a, 'x', 2)
+    assert.match(err, 'offset must be in the range')
+
+    -- a write error returns the bytes written
+    b:close()
+    len, err = a:timedwrite('hello')
+    assert.equal(len, 0)
+    assert(err)
+    a:close()
+end
+
 function testcase.read_zero_length()
     -- read(0) is rejected as an invalid length.
     local socks = assert(socket.pair({
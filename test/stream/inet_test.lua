@@ -377,3 +377,87 @@ function testcase.sendfile_eof()
     c:close()
 end
 
+local function u16(n)
+    return string.char(math.floor(n / 256), n % 256)
+end
+
+local function vec16(s)
+    return u16(#s) .. s
+end
+
+-- build a minimal TLS 1.3 ClientHello with SNI and ALPN, split into records
+-- of at most fragsize bytes if specified
+local function new_clienthello(servername, alpn, fragsize)
+    local protos = ''
+    for _, v in ipairs(alpn) do
+        protos = protos .. string.char(#v) .. v
+    end
+    local exts = u16(0) ..
+                     vec16(vec16(string.char(0) .. vec16(servername))) ..
+                     u16(16) .. vec16(vec16(protos))
+    local body = '\3\3' .. string.rep('\0', 32) .. '\0' .. vec16('\19\1') ..
+                     '\1\0' .. vec16(exts)
+    local msg = '\1\0' .. u16(#body) .. body
+    local records = {}
+    fragsize = fragsize or #msg
+    for i = 1, #msg, fragsize do
+        records[#records + 1] = '\22\3\1' .. vec16(msg:sub(i, i + fragsize - 1))
+    end
+    return table.concat(records)
+end
+
+function testcase.clienthello()
+    local _, c, peer = open_pair()
+    local hello = new_clienthello('example.com', {
+        'h2',
+        'http/1.1',
+    })
+
+    -- test that peek the SNI and ALPN of the ClientHello
+    assert(c:write(hello))
+    assert.equal(assert(peer:clienthello()), {
+        servername = 'example.com',
+        alpn = {
+            'h2',
+            'http/1.1',
+        },
+    })
+    -- test that the ClientHello is not consumed
+    assert.equal(assert(peer:read()), hello)
+
+    -- test that wait for the rest of the ClientHello
+    peer:rcvtimeo(0.1)
+    assert(c:write(hello:sub(1, 20)))
+    local res, err, timeout = peer:clienthello()
+    assert.is_nil(res)
+    assert.is_nil(err)
+    assert.is_true(timeout)
+    assert(c:write(hello:sub(21)))
+    assert.equal(assert(peer:clienthello()).servername, 'example.com')
+    assert.equal(assert(peer:read()), hello)
+
+    -- test that reassemble the ClientHello split across several records,
+    -- including the handshake header itself
+    hello = new_clienthello('example.com', {
+        'h2',
+    }, 3)
+    assert(c:write(hello:sub(1, 40)))
+    res, err, timeout = peer:clienthello()
+    assert.is_nil(res)
+    assert.is_nil(err)
+    assert.is_true(timeout)
+    assert(c:write(hello:sub(41)))
+    assert.equal(assert(peer:clienthello()), {
+        servername = 'example.com',
+        alpn = {
+            'h2',
+        },
+    })
+    assert.equal(assert(peer:read()), hello)
+
+    -- test that return EPROTO if the stream is not TLS
+    assert(c:write('GET / HTTP/1.1\r\n\r\n'))
+    res, err = peer:clienthello()
+    assert.is_nil(res)
+    assert.not_nil(error.is(err, errno.EPROTO))
+end
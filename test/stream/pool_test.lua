@@ -0,0 +1,257 @@
+require('luacov')
+local testcase = require('testcase')
+local fork = require('testcase.fork')
+local assert = require('assert')
+local exec = require('exec').execvp
+local sleep = require('time.sleep')
+local inet = require('net.stream.inet')
+local pool = require('net.stream.pool')
+
+local HOST = '127.0.0.1'
+local SERVER, PORT, POOL
+local PEERS = {}
+
+function testcase.before_all()
+    local p = assert(exec('openssl', {
+        'req',
+        '-new',
+        '-newkey',
+        'rsa:2048',
+        '-nodes',
+        '-x509',
+        '-days',
+        '1',
+        '-keyout',
+        'pool_cert.key',
+        '-out',
+        'pool_cert.pem',
+        '-subj',
+        '/C=US/CN=www.example.com',
+    }))
+
+    for line in p.stderr:lines() do
+        print(line)
+    end
+
+    local res = assert(p:close())
+    if res.exit ~= 0 then
+        error('failed to generate cert files')
+    end
+end
+
+function testcase.after_all()
+    os.remove('pool_cert.pem')
+    os.remove('pool_cert.key')
+end
+
+function testcase.before_each()
+    SERVER = assert(inet.server.new(HOST, 0, {
+        reuseaddr = true,
+        reuseport = true,
+    }))
+    assert(SERVER:listen())
+    PORT = assert(SERVER:getsockname()):port()
+end
+
+function testcase.after_each()
+    if POOL then
+        POOL:close()
+        POOL = nil
+    end
+    for _, peer in ipairs(PEERS) do
+        peer:close()
+    end
+    PEERS = {}
+    SERVER:close()
+    SERVER = nil
+end
+
+local function accept_peer()
+    local peer = assert(SERVER:accept())
+    PEERS[#PEERS + 1] = peer
+    return peer
+end
+
+function testcase.new()
+    -- test that create new net.stream.pool.Pool without connecting
+    POOL = pool.new(HOST, PORT)
+    assert.match(tostring(POOL), '^net.stream.pool.Pool: ', false)
+    assert.equal(POOL:len(), 0)
+
+    -- test that throws an error
+    assert.match(assert.throws(function()
+        pool.new(HOST, PORT, 1)
+    end), 'opts must be table', false)
+    assert.match(assert.throws(function()
+        pool.new(HOST, PORT, nil, {
+            size = -1,
+        })
+    end), 'cfg.size must be unsigned integer', false)
+    assert.match(assert.throws(function()
+        pool.new(HOST, PORT, nil, {
+            max_idle = 0,
+        })
+    end), 'cfg.max_idle must be positive finite number', false)
+end
+
+function testcase.refill_get_put()
+    POOL = pool.new(HOST, PORT, nil, {
+        size = 2,
+    })
+
+    -- test that refill connects up to the size
+    assert.equal(POOL:refill(), 2)
+    assert.equal(POOL:len(), 2)
+    assert.equal(POOL:refill(), 0)
+    local p1 = accept_peer()
+    local p2 = accept_peer()
+
+    -- test that get returns a pooled connection
+    local c1 = assert(POOL:get())
+    assert.equal(POOL:len(), 1)
+    assert.equal(c1:write('hello'), 5)
+    local port = assert(c1:getsockname()):port()
+    local peer = assert(p1:getpeername()):port() == port and p1 or p2
+    assert.equal(peer:read(), 'hello')
+
+    -- test that put returns the connection to the pool
+    assert.is_true(POOL:put(c1))
+    assert.equal(POOL:len(), 2)
+
+    -- test that a new connection is made when the pool is empty
+    local c2 = assert(POOL:get())
+    local c3 = assert(POOL:get())
+    local c4 = assert(POOL:get())
+    assert.equal(POOL:len(), 0)
+    accept_peer()
+
+    -- test that put closes the connection when the pool is full
+    assert.is_true(POOL:put(c2))
+    assert.is_true(POOL:put(c3))
+    assert.is_false(POOL:put(c4))
+    assert.equal(POOL:len(), 2)
+end
+
+function testcase.prune_closed_connections()
+    POOL = pool.new(HOST, PORT, nil, {
+        size = 2,
+    })
+    assert.equal(POOL:refill(), 2)
+    local p1 = accept_peer()
+    accept_peer()
+
+    -- test that a connection closed by the peer is pruned
+    p1:close()
+    sleep(0.1)
+    assert.equal(POOL:prune(), 1)
+    assert.equal(POOL:len(), 1)
+
+    -- test that refill replaces it
+    assert.equal(POOL:refill(), 1)
+    assert.equal(POOL:len(), 2)
+    local p3 = accept_peer()
+
+    -- test that a connection that received unsolicited data is not used
+    assert(p3:write('unsolicited'))
+    sleep(0.1)
+    local conn = assert(POOL:get())
+    assert.equal(POOL:len(), 0)
+    local peer = assert(PEERS[2])
+    assert.equal(conn:write('ping'), 4)
+    assert.equal(peer:read(), 'ping')
+    conn:close()
+end
+
+function testcase.expire_idle_connections()
+    POOL = pool.new(HOST, PORT, nil, {
+        size = 1,
+        max_idle = 0.1,
+    })
+    assert.equal(POOL:refill(), 1)
+    accept_peer()
+
+    -- test that idle connections expire
+    sleep(0.2)
+    assert.equal(POOL:prune(), 1)
+    assert.equal(POOL:len(), 0)
+
+    -- test that get returns an idle connection before it expires
+    assert.equal(POOL:refill(), 1)
+    local p1 = accept_peer()
+    local c1 = assert(POOL:get())
+    local port = assert(c1:getsockname()):port()
+    assert.equal(assert(p1:getpeername()):port(), port)
+
+    -- test that put restarts the expiry, and get closes the expired
+    -- connection and makes a new one instead
+    sleep(0.05)
+    assert.is_true(POOL:put(c1))
+    sleep(0.07)
+    assert.equal(POOL:prune(), 0)
+    sleep(0.1)
+    local c2 = assert(POOL:get())
+    assert.equal(POOL:len(), 0)
+    assert.not_equal(assert(c2:getsockname()):port(), port)
+    assert.is_nil(p1:read())
+    c2:close()
+end
+
+function testcase.tls_connections()
+    local s = assert(inet.server.new(HOST, 0, {
+        reuseaddr = true,
+        reuseport = true,
+        tlscfg = {
+            cert = 'pool_cert.pem',
+            key = 'pool_cert.key',
+        },
+    }))
+    assert(s:listen())
+    local port = assert(s:getsockname()):port()
+
+    local p = fork()
+    if p:is_child() then
+        local peer = assert(s:accept())
+        s:close()
+        assert.equal(peer:read(), 'ping')
+        assert(peer:write('pong'))
+        peer:close()
+        return
+    end
+    s:close()
+
+    -- the connections share one client context and its pool of SSL objects
+    POOL = pool.new(HOST, port, {
+        tlscfg = {
+            client = assert(require('net.tls.client')()),
+            noverify_name = true,
+            noverify_time = true,
+            noverify_cert = true,
+        },
+    }, {
+        size = 1,
+    })
+
+    -- test that refill pools a connection that has completed the handshake
+    assert.equal(POOL:refill(), 1)
+    local conn = POOL.idle[1].conn
+    assert.match(tostring(conn), '^net.tls.stream.inet.Client: ', false)
+
+    -- test that the session tickets sent by the server after the handshake
+    -- do not make the connection look closed
+    sleep(0.2)
+    local data = conn.sock:recv(1, 'peek', 'dontwait')
+    assert.is_string(data)
+    assert.equal(POOL:prune(), 0)
+    assert.equal(POOL:len(), 1)
+
+    -- test that the pooled connection is usable
+    assert.equal(POOL:get(), conn)
+    assert(conn:write('ping'))
+    assert.equal(conn:read(), 'pong')
+
+    -- test that put closes a connection that the peer has closed
+    sleep(0.1)
+    assert.is_false(POOL:put(conn))
+    assert.equal(POOL:len(), 0)
+    assert(p:wait())
+end
@@ -6,6 +6,7 @@ local fopen = require('io.fopen')
 local error_is = require('error').is
 local errno = require('errno')
 local iovec = require('iovec')
+local socket = require('net.socket')
 local unix = require('net.stream.unix')
 
 local PATHNAME
@@ -121,6 +122,103 @@ function testcase.sendfile_recv()
     assert.equal(assert(peer:recv()), 'hello')
 end
 
+function testcase.sendfiles()
+    local _, c, peer = open_pair()
+    local f = assert(io.open(TESTFILE, 'w+'))
+    assert(f:write('hello world'))
+    assert(f:flush())
+
+    -- test that send a file with the header and trailer
+    assert.equal(assert(c:sendfile(f, 5, 6, 'HEAD:', ':TAIL')), 15)
+    assert.equal(assert(peer:read()), 'HEAD:world:TAIL')
+
+    -- test that send a file by pathname through the open-fd cache
+    assert.equal(assert(c:sendfile(TESTFILE, nil, 6)), 5)
+    assert.equal(assert(peer:read()), 'world')
+    assert.equal(assert(c:sendfile(TESTFILE, 5)), 5)
+    assert.equal(assert(peer:read()), 'hello')
+
+    -- test that send multiple ranges of files
+    assert.equal(assert(c:sendfiles({
+        '[',
+        {
+            f,
+            5,
+        },
+        '|',
+        {
+            fileno(f),
+            5,
+            6,
+        },
+        ']',
+    }, 'HEAD:', ':TAIL')), 23)
+    assert.equal(assert(peer:read()), 'HEAD:[hello|world]:TAIL')
+
+    -- test that the parts after a short file are not sent
+    assert.equal(c:sendfiles({
+        {
+            f,
+            10,
+            6,
+        },
+        'unsent',
+    }), 5)
+    assert.equal(assert(peer:read()), 'world')
+
+    -- test that throws an error
+    assert.match(assert.throws(function()
+        c:sendfiles({
+            true,
+        })
+    end), 'ranges%[1%] must be string or table', false)
+end
+
+function testcase.recvfile()
+    local _, c, peer = open_pair()
+    peer:rcvtimeo(0.1)
+    local f = assert(io.open(TESTFILE, 'w+'))
+    assert(f:write('xx'))
+    assert(f:flush())
+
+    -- test that write the received data to a file at the offset
+    assert(c:write('hello world'))
+    assert.equal(assert(peer:recvfile(f, 5, 2)), 5)
+    f:seek('set')
+    assert.equal(f:read('*a'), 'xxhello')
+    assert.equal(assert(peer:read()), ' world')
+
+    -- test that write the data in the receive buffer first
+    assert(c:write('line\nrest'))
+    assert.equal(assert(peer:readline()), 'line')
+    assert.equal(assert(peer:recvfile(fileno(f), 4)), 4)
+    f:seek('set')
+    assert.equal(f:read('*a'), 'resthello')
+
+    -- test that the data is kept for the next read if it cannot be written
+    local ro = assert(io.open(TESTFILE, 'r'))
+    assert(c:write('again'))
+    local len, err = peer:recvfile(ro, 5)
+    ro:close()
+    assert.equal(len, 0)
+    assert.not_nil(error_is(err, errno.EBADF))
+    assert.equal(assert(peer:read()), 'again')
+
+    -- test that returns a timeout
+    local timeout
+    len, err, timeout = peer:recvfile(f, 5)
+    assert.equal(len, 0)
+    assert.is_nil(err)
+    assert.is_true(timeout)
+
+    -- test that returns the bytes written if closed by peer
+    assert(c:write('abc'))
+    c:close()
+    assert.equal(assert(peer:recvfile(f, 5, 9)), 3)
+    f:seek('set')
+    assert.equal(f:read('*a'), 'resthelloabc')
+end
+
 function testcase.sendmsg_recvmsg()
     local _, c, peer = open_pair()
     -- new (msg:string) API; cmsg / addr are not used on connected unix.
@@ -147,6 +245,47 @@ function testcase.writev_readv()
     assert.equal(iov_r:concat(), iov_w:get(2))
 end
 
+function testcase.writev_array()
+    local _, c, peer = open_pair()
+    c:sndtimeo(0.1)
+
+    -- test that write an array of strings
+    assert.equal(assert(c:writev({
+        'hello',
+        '',
+        'world',
+        '!',
+    })), 11)
+    assert.equal(assert(peer:read()), 'helloworld!')
+
+    -- test that write a range of an array from the offset
+    assert.equal(assert(c:writev({
+        'abc',
+        'def',
+        'ghi',
+        'jkl',
+    }, 2, 3, 1)), 5)
+    assert.equal(assert(peer:read()), 'efghi')
+
+    -- test that returns the position to resume from if timed out
+    local arr = {}
+    for i = 1, 64 do
+        arr[i] = string.rep(string.char(64 + i % 26), 65536)
+    end
+    local len, err, timeout, idx, off = c:writev(arr)
+    assert.is_nil(err)
+    assert.is_true(timeout)
+    assert.equal(len, (idx - 1) * 65536 + off)
+
+    -- test that throws an error
+    assert.match(assert.throws(function()
+        c:writev({
+            'foo',
+            1,
+        })
+    end), 'arr%[2%] must be string', false)
+end
+
 function testcase.sendfd_recvfd()
     local _, c, peer = open_pair()
     -- send an open fd from client, recv it on peer, verify contents.
@@ -187,3 +326,272 @@ function testcase.shutdown_directions()
     assert(sp[1]:close(true, true))
     assert(sp[2]:close())
 end
+
+function testcase.buffered_read()
+    local _, c, peer = open_pair()
+    peer:rcvtimeo(0.1)
+
+    -- test that readline returns lines without the LF or CRLF
+    assert(c:write('foo\r\nbar\nbaz'))
+    assert.equal(assert(peer:readline()), 'foo')
+    assert.equal(assert(peer:readline()), 'bar')
+    assert.equal(peer:buffered(), 3)
+
+    -- test that readline waits for the rest of the line
+    local line, err, timeout = peer:readline()
+    assert.is_nil(line)
+    assert.is_nil(err)
+    assert.is_true(timeout)
+    assert(c:write('\r\nqux\r\n'))
+    assert.equal(assert(peer:readline(true)), 'baz\r\n')
+    assert.equal(assert(peer:readline()), 'qux')
+
+    -- test that read_until returns data including the delimiter
+    assert(c:write('GET / HTTP/1.1\r\nHost: example.com\r\n\r\nbody'))
+    assert.equal(assert(peer:read_until('\r\n\r\n')),
+                 'GET / HTTP/1.1\r\nHost: example.com\r\n\r\n')
+
+    -- test that peek does not consume the data
+    assert(c:write('12345678'))
+    assert.equal(assert(peer:peek(6)), 'body12')
+    assert.equal(assert(peer:read_exact(6)), 'body12')
+    assert.equal(assert(peer:read_exact(2)), '34')
+
+    -- test that read returns the buffered data first
+    assert.equal(assert(peer:read()), '5678')
+    assert.equal(peer:buffered(), 0)
+
+    -- test that a line longer than the receive buffer cannot be read
+    assert.equal(peer:rbufsize(8), 65536)
+    assert.equal(peer:rbufsize(), 8)
+    assert(c:write('0123456789\n'))
+    line, err = peer:readline()
+    assert.is_nil(line)
+    assert.not_nil(error_is(err, errno.EMSGSIZE))
+    assert.equal(assert(peer:read_exact(8)), '01234567')
+    assert.equal(assert(peer:readline()), '89')
+
+    -- test that the data is moved to the start of the buffer when there is
+    -- no space after it
+    assert(c:write('abcdefgh'))
+    assert.equal(assert(peer:read_exact(1)), 'a')
+    assert.equal(peer:buffered(), 7)
+    assert(c:write('i'))
+    assert.equal(assert(peer:read_exact(8)), 'bcdefghi')
+
+    -- test that returns nil if closed by peer
+    assert(c:write('partial'))
+    c:close()
+    CLIENT = nil
+    assert.is_nil(peer:readline())
+    assert.equal(assert(peer:read()), 'partial')
+end
+
+function testcase.read_until_delimiters()
+    local _, c, peer = open_pair()
+    peer:rcvtimeo(0.1)
+
+    -- test that read_until finds the first occurrence of any delimiter
+    assert(c:write('a: 1\r\nb: 2\r\n\r\nc: 3\n\nd'))
+    local delims = {
+        '\r\n\r\n',
+        '\n\n',
+    }
+    assert.equal(assert(peer:read_until(delims)), 'a: 1\r\nb: 2\r\n\r\n')
+    assert.equal(assert(peer:read_until(delims)), 'c: 3\n\n')
+
+    -- test that a delimiter split across two reads is found
+    local str, err, timeout = peer:read_until(delims)
+    assert.is_nil(str)
+    assert.is_nil(err)
+    assert.is_true(timeout)
+    assert(c:write('\r\n\r'))
+    str, err, timeout = peer:read_until(delims)
+    assert.is_nil(str)
+    assert.is_nil(err)
+    assert.is_true(timeout)
+    assert(c:write('\n'))
+    assert.equal(assert(peer:read_until(delims)), 'd\r\n\r\n')
+
+    -- test that lines of a large pipelined batch are found in order
+    local lines = {}
+    for i = 1, 1000 do
+        lines[i] = string.rep(string.char(65 + i % 26), i % 100) .. i
+    end
+    assert(c:write(table.concat(lines, '\r\n') .. '\r\n'))
+    for i = 1, 1000 do
+        assert.equal(assert(peer:readline()), lines[i])
+    end
+
+    -- test that throws an error
+    assert.match(assert.throws(function()
+        peer:read_until('')
+    end), 'delim must not be empty', false)
+    assert.match(assert.throws(function()
+        peer:read_until({})
+    end), 'delim must have 1 to 8 delimiters', false)
+    assert.match(assert.throws(function()
+        peer:read_until({
+            '\n',
+            1,
+        })
+    end), 'delim must be string[]', false)
+end
+
+function testcase.buffered_write()
+    local _, c, peer = open_pair()
+    c:rcvtimeo(0.1)
+    peer:rcvtimeo(0.1)
+
+    -- test that bufwrite collects small writes until flush
+    assert.equal(c:bufwrite('hello'), 5)
+    assert.equal(c:bufwrite(' '), 1)
+    assert.equal(c:bufwrite('world'), 5)
+    local str, err, timeout = peer:read()
+    assert.is_nil(str)
+    assert.is_nil(err)
+    assert.is_true(timeout)
+    assert.equal(c:flush(), 11)
+    assert.equal(assert(peer:read()), 'hello world')
+    assert.equal(c:flush(), 0)
+
+    -- test that the buffered data is written when it reaches the size
+    assert.equal(c:wbufsize(8), 65536)
+    assert.equal(c:bufwrite('foo'), 3)
+    assert.equal(c:bufwrite('barbaz'), 6)
+    assert.equal(assert(peer:read()), 'foobarbaz')
+
+    -- test that the buffered data is written before waiting for a response
+    assert.equal(c:bufwrite('ping'), 4)
+    str, err, timeout = c:read()
+    assert.is_nil(str)
+    assert.is_nil(err)
+    assert.is_true(timeout)
+    assert.equal(assert(peer:read()), 'ping')
+
+    -- test that throws an error
+    assert.match(assert.throws(function()
+        c:wbufsize(0)
+    end), 'size must be positive integer', false)
+end
+
+function testcase.frames()
+    local _, c, peer = open_pair()
+    peer:rcvtimeo(0.1)
+
+    -- test that write_frame and read_frame round-trip every format
+    for _, fmt in ipairs({
+        'u16be',
+        'u32be',
+        'u64be',
+        'u16le',
+        'u32le',
+        'u64le',
+        'varint',
+    }) do
+        local encoded = socket.encode_frame(fmt, 'hello')
+        assert.equal(c:write_frame('hello', fmt), #encoded)
+        assert.equal(assert(peer:read_frame(fmt)), 'hello')
+    end
+    assert.equal(socket.encode_frame('u16be', 'abc'), '\0\3abc')
+    assert.equal(socket.encode_frame('u32le', 'abc'), '\3\0\0\0abc')
+    assert.equal(socket.encode_frame('varint', string.rep('x', 300)),
+                 '\172\2' .. string.rep('x', 300))
+
+    -- test that read_frame waits for the rest of the frame
+    assert(c:write('\0\0\0\5hel'))
+    local frame, err, timeout = peer:read_frame()
+    assert.is_nil(frame)
+    assert.is_nil(err)
+    assert.is_true(timeout)
+    assert(c:write('lo'))
+    assert.equal(assert(peer:read_frame()), 'hello')
+
+    -- test that read_frames returns all complete frames
+    assert(c:write_frames({
+        'foo',
+        '',
+        'bar',
+    }))
+    assert(c:write('\0\0\0\3ba'))
+    assert.equal(assert(peer:read_frames()), {
+        'foo',
+        '',
+        'bar',
+    })
+    assert(c:write('z'))
+    assert.equal(assert(peer:read_frames()), {
+        'baz',
+    })
+
+    -- test that a frame larger than the receive buffer is read
+    local large = string.rep('x', 100000)
+    assert(c:write_frame(large))
+    assert.equal(assert(peer:read_frame('u32be', 100000)), large)
+
+    -- test that a frame larger than maxsize cannot be read
+    assert(c:write_frame('hello'))
+    frame, err = peer:read_frame('u32be', 4)
+    assert.is_nil(frame)
+    assert.not_nil(error_is(err, errno.EMSGSIZE))
+
+    -- test that throws an error
+    assert.match(assert.throws(function()
+        socket.encode_frame('u16be', string.rep('x', 65536))
+    end), 'too long for u16be', false)
+    assert.match(assert.throws(function()
+        socket.encode_frame('u8', 'x')
+    end), 'invalid option', false)
+end
+
+function testcase.outbound_queue()
+    local _, c, peer = open_pair()
+    c:sndtimeo(0.1)
+    peer:rcvtimeo(0.1)
+    assert.equal({
+        c:watermarks(4096, 1024),
+    }, {
+        65536,
+        16384,
+    })
+
+    -- test that enqueue writes the data without waiting
+    assert.is_false(c:enqueue('hello'))
+    assert.equal(c:queued(), 0)
+    assert.equal(assert(peer:read()), 'hello')
+
+    -- test that enqueue reports that the queue exceeds the high watermark
+    local chunks = {}
+    repeat
+        local chunk = ('%08d'):format(#chunks) .. string.rep('x', 1015) ..
+                          '\n'
+        chunks[#chunks + 1] = chunk
+        local paused, err = c:enqueue(chunk)
+        assert.is_nil(err)
+    until paused
+    assert(c:queued() > 4096)
+
+    -- test that drain times out while the peer does not read
+    local ok, err, timeout = c:drain()
+    assert.is_false(ok)
+    assert.is_nil(err)
+    assert.is_true(timeout)
+
+    -- test that the queued data is received in order
+    local expected = table.concat(chunks)
+    local received = {}
+    local len = 0
+    while len < #expected do
+        local str = assert(peer:read(65536))
+        received[#received + 1] = str
+        len = len + #str
+        c:drain(0)
+    end
+    assert.equal(table.concat(received), expected)
+    assert.equal(c:queued(), 0)
+
+    -- test that throws an error
+    assert.match(assert.throws(function()
+        c:watermarks(1024, 4096)
+    end), 'low must be unsigned integer less than or equal to high', false)
+end
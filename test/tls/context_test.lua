@@ -225,6 +225,19 @@ CN = localhost
     end
     assert.equal(assert(scrt:close()).exit, 0)
 
+    -- server_chain = server + CA, so that a server can build the CertID of
+    -- the responses it staples
+    local srv_fh = assert(io.open(OCSP_FIXTURE_DIR .. '/server.crt', 'r'))
+    local srv_pem = srv_fh:read('*a')
+    srv_fh:close()
+    local ca_fh = assert(io.open(OCSP_FIXTURE_DIR .. '/ca.crt', 'r'))
+    local ca_pem = ca_fh:read('*a')
+    ca_fh:close()
+    local srv_chain = assert(io.open(OCSP_FIXTURE_DIR .. '/server_chain.crt',
+                                     'w'))
+    srv_chain:write(srv_pem, ca_pem)
+    srv_chain:close()
+
     -- request + response DER for the server cert
     local oreq = assert(exec('openssl', {
         'ocsp',
@@ -305,6 +318,25 @@ CN = localhost
     idx_after:write(idx_snapshot)
     idx_after:close()
 
+    -- an expired server cert of the same CA
+    local sexp = assert(exec('openssl', {
+        'ca',
+        '-batch',
+        '-config',
+        ocsp_cnf,
+        '-startdate',
+        '20000101000000Z',
+        '-enddate',
+        '20000102000000Z',
+        '-in',
+        OCSP_FIXTURE_DIR .. '/server.csr',
+        '-out',
+        OCSP_FIXTURE_DIR .. '/server_expired.crt',
+    }))
+    for _ in sexp.stderr:lines() do
+    end
+    assert.equal(assert(sexp:close()).exit, 0)
+
     -- Hand-crafted minimal OCSP responses for each non-successful
     -- responseStatus value (malformedRequest=1, internalError=2,
     -- tryLater=3, sigRequired=5, unauthorized=6).  Wire encoding:
@@ -2256,6 +2288,157 @@ function testcase.server_new_rejects_key_mismatch()
     assert(err, 'key/cert mismatch must return an error')
 end
 
+function testcase.server_set_certificate()
+    -- set_certificate replaces the certificate of an existing server; the
+    -- in-flight connection keeps the old one and a broken pair is refused
+    -- without touching the current certificate.
+    local server = assert(new_tls_server(SERVER_CONFIG.cert, SERVER_CONFIG.key))
+    local lsock = assert(socket.bind_inet('127.0.0.1', 0, {
+        socktype = 'stream',
+        protocol = 'tcp',
+        reuseaddr = true,
+        reuseport = true,
+    }))
+    assert(lsock:listen())
+    local port = assert(lsock:getsockname()):port()
+    local function accept(cafile)
+        local proc = start_s_client_with_ca(port, cafile)
+        assert(gpoll.wait_readable(lsock:fd(), DEADLINE))
+        local asock = assert(socket.wrap(assert(lsock:acceptfd())))
+        local fd = asock:fd()
+        local ctx = assert(tls_context.accept(server, fd, false))
+        return new_ep(ctx, 'server', fd), asock, proc
+    end
+
+    -- accept a connection with the initial certificate, then replace it
+    -- before the handshake; the connection must keep the old certificate
+    local ep, asock, proc = accept('cert.pem')
+    assert(server:set_certificate(CHAIN_FIXTURE_DIR .. '/fullchain.pem',
+                                  CHAIN_FIXTURE_DIR .. '/leaf.key'))
+    assert(handshake(ep))
+    assert(close_ep(ep))
+    asock:close()
+    proc:close()
+
+    -- new connections use the new certificate chain
+    ep, asock, proc = accept(CHAIN_FIXTURE_DIR .. '/root.crt')
+    assert(handshake(ep))
+    assert(close_ep(ep))
+    asock:close()
+    proc:close()
+
+    -- mismatched pair is refused and the current certificate is kept
+    local ok, err = server:set_certificate('cert.pem',
+                                           CHAIN_FIXTURE_DIR .. '/leaf.key')
+    assert.is_false(ok)
+    assert(err, 'key/cert mismatch must return an error')
+    ep, asock, proc = accept(CHAIN_FIXTURE_DIR .. '/root.crt')
+    assert(handshake(ep))
+    assert(close_ep(ep))
+    asock:close()
+    proc:close()
+    lsock:close()
+end
+
+--- Read the whole content of a file.
+--- @param pathname string
+--- @return string content
+local function readfile(pathname)
+    local f = assert(io.open(pathname, 'rb'))
+    local content = f:read('*a')
+    f:close()
+    return content
+end
+
+--- Convert a PEM certificate or private key file into DER.
+--- @param cmd string 'x509' or 'pkey'
+--- @param pathname string
+--- @return string der
+local function pem2der(cmd, pathname)
+    local outfile = pathname .. '.der'
+    local p = assert(exec('openssl', {
+        cmd,
+        '-in',
+        pathname,
+        '-outform',
+        'DER',
+        '-out',
+        outfile,
+    }))
+    local res = assert(p:close())
+    assert.equal(res.exit, 0)
+    local der = readfile(outfile)
+    os.remove(outfile)
+    return der
+end
+
+function testcase.server_new_from_memory()
+    -- net.tls.server accepts PEM and DER blobs as well as file paths; the
+    -- parsed certificate chain is shared between contexts.
+    local cert = readfile('cert.pem')
+    local key = readfile('cert.key')
+    assert(new_tls_server(cert, key))
+    assert(new_tls_server(cert, SERVER_CONFIG.key))
+    assert(new_tls_server(pem2der('x509', 'cert.pem'),
+                          pem2der('pkey', 'cert.key')))
+
+    -- mismatched key is still rejected when the chain comes from the cache
+    local server, err = new_tls_server(cert, readfile(CHAIN_FIXTURE_DIR ..
+                                                          '/leaf.key'))
+    assert.is_nil(server)
+    assert(err, 'key/cert mismatch must return an error')
+
+    -- handshake with the certificate loaded from memory
+    local lsock = assert(socket.bind_inet('127.0.0.1', 0, {
+        socktype = 'stream',
+        protocol = 'tcp',
+        reuseaddr = true,
+        reuseport = true,
+    }))
+    assert(lsock:listen())
+    local port = assert(lsock:getsockname()):port()
+    local proc = start_s_client_with_ca(port, 'cert.pem')
+    assert(gpoll.wait_readable(lsock:fd(), DEADLINE))
+    local asock = assert(socket.wrap(assert(lsock:acceptfd())))
+    local fd = asock:fd()
+
+    server = assert(new_tls_server(cert, key))
+    local ctx = assert(tls_context.accept(server, fd, false))
+    local ep = new_ep(ctx, 'server', fd)
+    assert(handshake(ep))
+    assert(close_ep(ep))
+    asock:close()
+    lsock:close()
+    proc:close()
+end
+
+function testcase.load_verify_locations_from_memory()
+    -- CA certificates can be passed as a PEM/DER blob without capath, and
+    -- the resulting store verifies the peer.
+    local client = assert(new_tls_client())
+    assert(client:load_verify_locations(pem2der('x509', 'cert.pem')))
+    assert(client:load_verify_locations(nil, '.'))
+
+    local port = free_port()
+    local proc = start_s_server(port)
+    local csock = assert(wait_listen(port))
+    local fd = csock:fd()
+
+    client = assert(new_tls_client())
+    assert(client:load_verify_locations(readfile('cert.pem')))
+    local ctx = assert(tls_context.connect(client, fd, 'www.example.com', false,
+                                           false, false, false))
+    local ep = new_ep(ctx, 'client', fd)
+    assert(handshake(ep))
+    assert(close_ep(ep))
+    csock:close()
+    proc:close()
+
+    -- either cafile or capath is required
+    local err = assert.throws(client.load_verify_locations, client)
+    assert.match(err, 'cafile or capath must be specified')
+end
+
 function testcase.bio_methods_reusable_across_many_connections()
     -- BIO_METHOD objects are created per connection; the composed type is
     -- cached and shared so that BIO_get_new_index()'s small budget is not
@@ -2365,3 +2548,635 @@ function testcase.connect_handshake_from_coroutine_with_ocsp()
     end
     proc:close()
 end
+
+function testcase.server_ocsp_stapling()
+    -- the server staples the response given by set_ocsp_response() or
+    -- fetched by the OCSP callback; the client verifies the stapled
+    -- response through ocsp_verify_cb.
+    local server = assert(new_tls_server(OCSP_FIXTURE_DIR ..
+                                             '/server_chain.crt',
+                                         OCSP_FIXTURE_DIR .. '/server.key'))
+    local function connect()
+        local client = assert(new_tls_client())
+        assert(client:load_verify_locations(OCSP_FIXTURE_DIR .. '/ca.crt'))
+        local csock, ssock = make_loopback_pair()
+        local cctx = assert(tls_context.connect(client, csock:fd(), nil, true,
+                                                false, true, true))
+        local sctx = assert(tls_context.accept(server, ssock:fd(), true))
+        return new_ep(cctx, 'client', csock:fd()),
+               new_ep(sctx, 'server', ssock:fd()), {
+            csock,
+            ssock,
+        }
+    end
+    local function close(socks)
+        for _, s in ipairs(socks) do
+            s:close()
+        end
+    end
+
+    -- invalid response is refused
+    local ok, err = server:set_ocsp_response('not an OCSP response')
+    assert.is_false(ok)
+    assert(err, 'invalid OCSP response must return an error')
+
+    -- response is refused if the issuer of the certificate is unknown, since
+    -- its CertID cannot be built
+    local noissuer = assert(new_tls_server(OCSP_FIXTURE_DIR .. '/server.crt',
+                                           OCSP_FIXTURE_DIR .. '/server.key'))
+    ok, err = noissuer:set_ocsp_response(readfile(OCSP_FIXTURE_DIR ..
+                                                      '/ocsp_resp.der'))
+    assert.is_false(ok)
+    assert(err, 'response without the issuer must return an error')
+
+    -- stapled GOOD response passes the client verification
+    assert(server:set_ocsp_response(readfile(OCSP_FIXTURE_DIR ..
+                                                 '/ocsp_resp.der')))
+    local cep, sep, socks = connect()
+    assert(handshake_pair(cep, sep))
+    close(socks)
+
+    -- stapled REVOKED response makes the client abort the handshake
+    assert(server:set_ocsp_response(readfile(OCSP_FIXTURE_DIR ..
+                                                 '/ocsp_resp_revoked.der')))
+    cep, sep, socks = connect()
+    assert.throws(handshake_pair, cep, sep)
+    close(socks)
+
+    -- the callback is not called while the cached response is fresh
+    local ncall = 0
+    assert(server:set_ocsp_callback(function(arg, cert)
+        ncall = ncall + 1
+        assert.equal(arg, 'foo')
+        assert.match(cert, '^-----BEGIN CERTIFICATE-----', false)
+        return readfile(OCSP_FIXTURE_DIR .. '/ocsp_resp.der')
+    end, 'foo'))
+    assert.equal(server:refresh_ocsp(), 0)
+    assert.equal(ncall, 0)
+
+    -- the handshake never calls the callback; it records the certificate
+    -- without a cached response, and refresh_ocsp() fetches it
+    server = assert(new_tls_server(OCSP_FIXTURE_DIR .. '/server_chain.crt',
+                                   OCSP_FIXTURE_DIR .. '/server.key'))
+    assert(server:set_ocsp_callback(function(cert)
+        ncall = ncall + 1
+        assert.match(cert, '^-----BEGIN CERTIFICATE-----', false)
+        return readfile(OCSP_FIXTURE_DIR .. '/ocsp_resp.der')
+    end))
+    cep, sep, socks = connect()
+    assert(handshake_pair(cep, sep))
+    close(socks)
+    assert.equal(ncall, 0)
+    assert.equal(server:refresh_ocsp(), 1)
+    assert.equal(ncall, 1)
+
+    -- the fetched response is cached
+    cep, sep, socks = connect()
+    assert(handshake_pair(cep, sep))
+    close(socks)
+    assert.equal(server:refresh_ocsp(), 0)
+    assert.equal(ncall, 1)
+
+    -- throws an error if callback is not function
+    err = assert.throws(server.set_ocsp_callback, server, 'hello')
+    assert.match(err, 'function or nil expected')
+end
+
+function testcase.client_ocsp_result_cache()
+    -- the client caches the verification result of a stapled response and
+    -- reuses it for the same response until nextUpdate; a different
+    -- response for the same certificate is verified again.
+    local server = assert(new_tls_server(OCSP_FIXTURE_DIR ..
+                                             '/server_chain.crt',
+                                         OCSP_FIXTURE_DIR .. '/server.key'))
+    local client = assert(new_tls_client())
+    assert(client:load_verify_locations(OCSP_FIXTURE_DIR .. '/ca.crt'))
+    local function connect()
+        local csock, ssock = make_loopback_pair()
+        local cctx = assert(tls_context.connect(client, csock:fd(), nil, true,
+                                                false, true, true))
+        local sctx = assert(tls_context.accept(server, ssock:fd(), true))
+        local cep = new_ep(cctx, 'client', csock:fd())
+        local sep = new_ep(sctx, 'server', ssock:fd())
+        local ok, err = pcall(handshake_pair, cep, sep)
+        csock:close()
+        ssock:close()
+        return ok, err
+    end
+
+    -- GOOD response is verified once and then served from the cache
+    assert(server:set_ocsp_response(readfile(OCSP_FIXTURE_DIR ..
+                                                 '/ocsp_resp.der')))
+    for _ = 1, 3 do
+        assert(connect())
+    end
+
+    -- REVOKED response for the same certificate is not hidden by the cache
+    assert(server:set_ocsp_response(readfile(OCSP_FIXTURE_DIR ..
+                                                 '/ocsp_resp_revoked.der')))
+    for _ = 1, 2 do
+        assert.is_false(connect())
+    end
+
+    -- switching back to the GOOD response still succeeds
+    assert(server:set_ocsp_response(readfile(OCSP_FIXTURE_DIR ..
+                                                 '/ocsp_resp.der')))
+    assert(connect())
+end
+
+function testcase.client_crl_index()
+    -- revoked serial numbers are looked up in the CRL index from the verify
+    -- callback; loading a CRL of the same issuer replaces its entries.
+    local function openssl(args)
+        local p = assert(exec('openssl', args))
+        for _ in p.stderr:lines() do
+        end
+        assert.equal(assert(p:close()).exit, 0)
+    end
+    local cnf = OCSP_FIXTURE_DIR .. '/ca.cnf'
+    local idxfile = OCSP_FIXTURE_DIR .. '/index.txt'
+    local snapshot = readfile(idxfile)
+    local function gencrl(pathname)
+        openssl({
+            'ca',
+            '-batch',
+            '-config',
+            cnf,
+            '-gencrl',
+            '-crldays',
+            '1',
+            '-out',
+            pathname,
+        })
+        return readfile(pathname)
+    end
+    local good_crl = gencrl(OCSP_FIXTURE_DIR .. '/good.crl')
+    openssl({
+        'ca',
+        '-batch',
+        '-config',
+        cnf,
+        '-revoke',
+        OCSP_FIXTURE_DIR .. '/server.crt',
+    })
+    local revoked_crl = gencrl(OCSP_FIXTURE_DIR .. '/revoked.crl')
+    local f = assert(io.open(idxfile, 'w'))
+    f:write(snapshot)
+    f:close()
+
+    local server = assert(new_tls_server(OCSP_FIXTURE_DIR .. '/server.crt',
+                                         OCSP_FIXTURE_DIR .. '/server.key'))
+    local client = assert(new_tls_client())
+    assert(client:load_verify_locations(OCSP_FIXTURE_DIR .. '/ca.crt'))
+    local function connect()
+        local csock, ssock = make_loopback_pair()
+        local cctx = assert(tls_context.connect(client, csock:fd(), nil, true,
+                                                false, false, true))
+        local sctx = assert(tls_context.accept(server, ssock:fd(), true))
+        local cep = new_ep(cctx, 'client', csock:fd())
+        local sep = new_ep(sctx, 'server', ssock:fd())
+        local ok, err = pcall(handshake_pair, cep, sep)
+        csock:close()
+        ssock:close()
+        return ok, err
+    end
+
+    -- no index
+    assert.equal(client:get_crl_index_stats(), {
+        issuers = 0,
+        serials = 0,
+    })
+    assert(connect())
+
+    -- revoked certificate is rejected
+    assert(client:add_crl_index(revoked_crl))
+    assert.equal(client:get_crl_index_stats(), {
+        issuers = 1,
+        serials = 1,
+    })
+    assert.is_false(connect())
+
+    -- newer CRL of the same issuer replaces the entries
+    assert(client:add_crl_index(good_crl))
+    assert.equal(client:get_crl_index_stats(), {
+        issuers = 1,
+        serials = 0,
+    })
+    assert(connect())
+
+    -- clear the index
+    assert(client:add_crl_index(revoked_crl))
+    client:clear_crl_index()
+    assert.equal(client:get_crl_index_stats(), {
+        issuers = 0,
+        serials = 0,
+    })
+    assert(connect())
+
+    -- CRL must be verified with its issuer certificate
+    client = assert(new_tls_client())
+    local ok, err = client:add_crl_index(revoked_crl)
+    assert.is_false(ok)
+    assert.match(err, 'failed to verify CRL')
+    assert(client:add_crl_index(revoked_crl,
+                                readfile(OCSP_FIXTURE_DIR .. '/ca.crt')))
+
+    -- invalid input
+    ok, err = client:add_crl_index('not a CRL')
+    assert.is_false(ok)
+    assert(err, 'invalid CRL must return an error')
+end
+
+function testcase.handshake_offload()
+    assert(tls_context.set_offload_threads(2))
+    assert.equal(tls_context.get_offload_threads(), 2)
+
+    local server = assert(new_tls_server(SERVER_CONFIG.cert, SERVER_CONFIG.key))
+    local client = assert(new_tls_client())
+    server:set_handshake_offload(true)
+    client:set_handshake_offload(true)
+
+    local csock, ssock = make_loopback_pair()
+    local cctx = assert(tls_context.connect(client, csock:fd(), nil, true,
+                                            false, true, true))
+    local sctx = assert(tls_context.accept(server, ssock:fd(), true))
+    local cep = new_ep(cctx, 'client', csock:fd())
+    local sep = new_ep(sctx, 'server', ssock:fd())
+    -- the descriptor is assigned only while a step is in flight
+    assert.is_nil(cctx:get_async_fd())
+    assert.is_nil(sctx:get_async_fd())
+
+    -- the handshake steps run on the workers and report WANT_ASYNC
+    local nasync = 0
+    for _ = 1, 200 do
+        if cep.done and sep.done then
+            break
+        end
+        for _, ep in ipairs({
+            cep,
+            sep,
+        }) do
+            if not ep.done then
+                local ok, err, want = ep.ctx:handshake()
+                if ok then
+                    ep.done = true
+                    pump(ep)
+                elseif want == tls_context.WANT_ASYNC then
+                    nasync = nasync + 1
+                    assert.is_int(ep.ctx:get_async_fd())
+                    -- the SSL object is owned by the worker
+                    local n, rerr = ep.ctx:read()
+                    if not n and rerr then
+                        assert.equal(rerr.type, errno.EBUSY)
+                    end
+                    -- an unfinished handshake has nothing to shut down
+                    assert.is_true(ep.ctx:shutdown())
+                    assert(gpoll.wait_readable(ep.ctx:get_async_fd(), 1))
+                else
+                    assert(want and WANT[want],
+                           ep.name .. ':handshake: ' .. tostring(err))
+                    pump(ep)
+                end
+            end
+        end
+    end
+    assert(cep.done and sep.done, 'handshake did not converge')
+    assert.greater(nasync, 0)
+    -- the job is released after the handshake
+    assert.is_nil(cctx:get_async_fd())
+    assert.is_nil(sctx:get_async_fd())
+
+    -- data is exchanged on the calling thread
+    assert.equal(cctx:write('hello'), 5)
+    pump(cep)
+    pump(sep)
+    assert.equal(sctx:read(), 'hello')
+
+    -- a Lua callback function forces the handshake to run inline
+    server:set_sni_callback(function()
+        return nil
+    end)
+    local csock2, ssock2 = make_loopback_pair()
+    cctx = assert(tls_context.connect(client, csock2:fd(), nil, true, false,
+                                      true, true))
+    sctx = assert(tls_context.accept(server, ssock2:fd(), true))
+    cep = new_ep(cctx, 'client', csock2:fd())
+    sep = new_ep(sctx, 'server', ssock2:fd())
+    for _ = 1, 200 do
+        if cep.done and sep.done then
+            break
+        end
+        local ok, err, want = cctx:handshake()
+        if ok then
+            cep.done = true
+        elseif want == tls_context.WANT_ASYNC then
+            assert(gpoll.wait_readable(cctx:get_async_fd(), 1))
+        else
+            assert(want and WANT[want], tostring(err))
+        end
+        pump(cep)
+        if not sep.done then
+            ok, err, want = sctx:handshake()
+            assert.not_equal(want, tls_context.WANT_ASYNC)
+            sep.done = ok
+            assert(ok or WANT[want], tostring(err))
+            pump(sep)
+        end
+    end
+    assert(cep.done and sep.done, 'handshake did not converge')
+
+    csock:close()
+    ssock:close()
+    csock2:close()
+    ssock2:close()
+    assert(tls_context.set_offload_threads(0))
+end
+
+function testcase.server_multiple_certificates()
+    -- generate an ECDSA P-256 certificate next to the RSA one
+    local p = assert(exec('openssl', {
+        'req',
+        '-new',
+        '-newkey',
+        'ec',
+        '-pkeyopt',
+        'ec_paramgen_curve:prime256v1',
+        '-nodes',
+        '-x509',
+        '-days',
+        '1',
+        '-keyout',
+        'ecdsa.key',
+        '-out',
+        'ecdsa.pem',
+        '-subj',
+        '/C=US/CN=www.example.com',
+    }))
+    local res = assert(p:close())
+    assert.equal(res.exit, 0)
+
+    local function connect(server, sigalgs)
+        local client = assert(new_tls_client())
+        assert(client:set_sigalgs(sigalgs))
+        local csock, ssock = make_loopback_pair()
+        local cctx = assert(tls_context.connect(client, csock:fd(), nil, true,
+                                                false, true, true))
+        local sctx = assert(tls_context.accept(server, ssock:fd(), true))
+        local cep = new_ep(cctx, 'client', csock:fd())
+        local sep = new_ep(sctx, 'server', ssock:fd())
+        local ok = pcall(handshake_pair, cep, sep)
+        csock:close()
+        ssock:close()
+        return ok
+    end
+
+    -- RSA only server cannot serve a client that accepts only ECDSA
+    local server = assert(new_tls_server(SERVER_CONFIG.cert, SERVER_CONFIG.key))
+    assert(connect(server, 'RSA-PSS+SHA256:RSA+SHA256'))
+    assert.is_false(connect(server, 'ECDSA+SHA256'))
+
+    -- set_certificate does not change the key type of the server
+    local ok, err = server:set_certificate('ecdsa.pem', 'ecdsa.key')
+    assert.is_false(ok)
+    assert.match(err, 'no certificate of the same key type')
+    assert.is_false(connect(server, 'ECDSA+SHA256'))
+
+    -- the certificate is chosen by the signature algorithms of the client
+    assert(server:add_certificate('ecdsa.pem', 'ecdsa.key'))
+    assert(connect(server, 'ECDSA+SHA256'))
+    assert(connect(server, 'RSA-PSS+SHA256:RSA+SHA256'))
+
+    -- one certificate per key type
+    ok, err = server:add_certificate('ecdsa.pem', 'ecdsa.key')
+    assert.is_false(ok)
+    assert.match(err, 'same key type')
+    -- set_certificate replaces the certificate of the same key type only
+    assert(server:set_certificate('ecdsa.pem', 'ecdsa.key'))
+    assert(connect(server, 'ECDSA+SHA256'))
+    assert(connect(server, 'RSA-PSS+SHA256:RSA+SHA256'))
+
+    -- key exchange groups
+    assert(server:set_groups('X25519:P-256'))
+    assert(connect(server, 'ECDSA+SHA256'))
+    assert(server:set_groups('P-384'))
+    local client = assert(new_tls_client())
+    assert(client:set_groups('X25519'))
+    local csock, ssock = make_loopback_pair()
+    local cctx = assert(tls_context.connect(client, csock:fd(), nil, true,
+                                            false, true, true))
+    local sctx = assert(tls_context.accept(server, ssock:fd(), true))
+    assert.is_false(pcall(handshake_pair, new_ep(cctx, 'client', csock:fd()),
+                          new_ep(sctx, 'server', ssock:fd())))
+    csock:close()
+    ssock:close()
+
+    -- invalid lists
+    ok, err = server:set_groups('no-such-group')
+    assert.is_false(ok)
+    assert(err, 'unknown group must return an error')
+    ok, err = client:set_sigalgs('no-such-sigalg')
+    assert.is_false(ok)
+    assert(err, 'unknown signature algorithm must return an error')
+
+    os.remove('ecdsa.pem')
+    os.remove('ecdsa.key')
+end
+
+function testcase.cipher_suite_performance_policy()
+    local function connect(server, client)
+        local csock, ssock = make_loopback_pair()
+        local cctx = assert(tls_context.connect(client, csock:fd(), nil, true,
+                                                false, true, true))
+        local sctx = assert(tls_context.accept(server, ssock:fd(), true))
+        local cep = new_ep(cctx, 'client', csock:fd())
+        local sep = new_ep(sctx, 'server', ssock:fd())
+        assert.is_nil(cctx:get_cipher())
+        local ok = pcall(handshake_pair, cep, sep)
+        local cipher = ok and sctx:get_cipher()
+        if ok then
+            assert.equal(cctx:get_cipher(), cipher)
+        end
+        csock:close()
+        ssock:close()
+        return cipher
+    end
+
+    local server = assert(new_tls_server(SERVER_CONFIG.cert, SERVER_CONFIG.key,
+                                         'tlsv1.3', 'performance'))
+    local client = assert(new_tls_client('tlsv1.3', 'performance'))
+    local cipher = assert(connect(server, client))
+    assert.match(cipher, '^TLS_')
+
+    -- the server chooses ChaCha20 for a client that lists it first
+    assert(client:set_ciphersuites(
+               'TLS_CHACHA20_POLY1305_SHA256:TLS_AES_128_GCM_SHA256'))
+    assert.equal(connect(server, client), 'TLS_CHACHA20_POLY1305_SHA256')
+
+    -- explicit ciphersuites of the server
+    assert(server:set_ciphersuites('TLS_AES_256_GCM_SHA384'))
+    client = assert(new_tls_client('tlsv1.3'))
+    assert.equal(connect(server, client), 'TLS_AES_256_GCM_SHA384')
+    assert(client:set_ciphersuites('TLS_AES_128_GCM_SHA256'))
+    assert.is_false(connect(server, client))
+end
+
+function testcase.ssl_pool_reuse()
+    local server = assert(new_tls_server(SERVER_CONFIG.cert, SERVER_CONFIG.key))
+    local client = assert(new_tls_client())
+    assert(server:set_ssl_pool_size(2))
+    assert(client:set_ssl_pool_size(2))
+
+    -- the SSL objects and BIO buffers of closed contexts are reused by the
+    -- following connections, in both BIO and socket modes
+    local oldbio
+    for i, use_bio in ipairs({
+        true,
+        true,
+        false,
+        true,
+    }) do
+        local csock, ssock = make_loopback_pair()
+        local cctx = assert(tls_context.connect(client, csock:fd(), nil, true,
+                                                false, true, use_bio))
+        local sctx = assert(tls_context.accept(server, ssock:fd(), use_bio))
+        local cep = new_ep(cctx, 'client', csock:fd())
+        local sep = new_ep(sctx, 'server', ssock:fd())
+        assert(handshake_pair(cep, sep))
+        assert.equal(cctx:write('hello' .. i), 6)
+        pump(cep)
+        local s
+        for _ = 1, 100 do
+            pump(sep)
+            s = sctx:read()
+            if s then
+                break
+            end
+            sleep(0.01)
+        end
+        assert.equal(s, 'hello' .. i)
+
+        if i == 1 then
+            oldbio = sep.bio
+            assert(cctx:close())
+            assert(sctx:close())
+        else
+            -- the SSL objects return to the pool on a completed shutdown
+            cctx:shutdown()
+            pump(cep)
+            assert(close_ep(sep))
+            assert(close_ep(cep))
+        end
+        csock:close()
+        ssock:close()
+    end
+
+    -- the bio of a closed context does not refer to the reused buffers
+    local n, err = oldbio:fill()
+    assert.is_nil(n)
+    assert.equal(err.type, errno.EINVAL)
+
+    -- changing the configuration empties the pool
+    assert(server:set_ciphersuites('TLS_AES_128_GCM_SHA256'))
+    local csock, ssock = make_loopback_pair()
+    local cctx = assert(tls_context.connect(client, csock:fd(), nil, true,
+                                            false, true, true))
+    local sctx = assert(tls_context.accept(server, ssock:fd(), true))
+    assert(handshake_pair(new_ep(cctx, 'client', csock:fd()),
+                          new_ep(sctx, 'server', ssock:fd())))
+    assert.equal(sctx:get_cipher(), 'TLS_AES_128_GCM_SHA256')
+    assert(cctx:close())
+    assert(sctx:close())
+    csock:close()
+    ssock:close()
+
+    -- a pooled SSL object does not keep the verify callback of noverify_time
+    server = assert(new_tls_server(OCSP_FIXTURE_DIR .. '/server_expired.crt',
+                                   OCSP_FIXTURE_DIR .. '/server.key'))
+    client = assert(new_tls_client())
+    assert(client:load_verify_locations(OCSP_FIXTURE_DIR .. '/ca.crt', '.'))
+    assert(client:set_ssl_pool_size(1))
+    csock, ssock = make_loopback_pair()
+    cctx = assert(tls_context.connect(client, csock:fd(), 'localhost', false,
+                                      true, false, true))
+    sctx = assert(tls_context.accept(server, ssock:fd(), true))
+    local cep = new_ep(cctx, 'client', csock:fd())
+    local sep = new_ep(sctx, 'server', ssock:fd())
+    assert(handshake_pair(cep, sep))
+    cctx:shutdown()
+    pump(cep)
+    assert(close_ep(sep))
+    assert(close_ep(cep))
+    csock:close()
+    ssock:close()
+
+    csock, ssock = make_loopback_pair()
+    cctx = assert(tls_context.connect(client, csock:fd(), 'localhost', false,
+                                      false, false, true))
+    sctx = assert(tls_context.accept(server, ssock:fd(), true))
+    cep = new_ep(cctx, 'client', csock:fd())
+    sep = new_ep(sctx, 'server', ssock:fd())
+    local ok, err
+    for _ = 1, 100 do
+        ok, err = cctx:handshake()
+        pump(cep)
+        if ok or err then
+            break
+        end
+        sctx:handshake()
+        pump(sep)
+        sleep(0.01)
+    end
+    assert.is_false(ok)
+    assert.match(tostring(err), 'certificate verify failed', false)
+    cctx:close()
+    sctx:close()
+    csock:close()
+    ssock:close()
+
+    -- 0 disables the pool
+    assert(server:set_ssl_pool_size(0))
+    assert(client:set_ssl_pool_size(0))
+end
+
+function testcase.shutdown_mode()
+    local server = assert(new_tls_server(SERVER_CONFIG.cert, SERVER_CONFIG.key))
+    local client = assert(new_tls_client())
+    client:set_shutdown_mode('fast')
+
+    local csock, ssock = make_loopback_pair()
+    local cctx = assert(tls_context.connect(client, csock:fd(), nil, true,
+                                            false, true, true))
+    local sctx = assert(tls_context.accept(server, ssock:fd(), true))
+    local cep = new_ep(cctx, 'client', csock:fd())
+    local sep = new_ep(sctx, 'server', ssock:fd())
+    assert(handshake_pair(cep, sep))
+
+    -- test that the contexts inherit the mode of the server and client
+    assert.equal(cctx:get_shutdown_mode(), 'fast')
+    assert.equal(sctx:get_shutdown_mode(), 'full')
+
+    -- test that the fast mode completes without the peer's close_notify
+    assert.is_true(cctx:shutdown())
+    local _, len = cep.bio:peek()
+    assert.greater(len, 0)
+    pump(cep)
+    pump(sep)
+    assert.is_nil(sctx:read(1024), 'peer must see close_notify as EOF')
+
+    -- test that the quiet mode sends nothing
+    sctx:set_shutdown_mode('quiet')
+    assert.equal(sctx:get_shutdown_mode(), 'quiet')
+    assert.is_true(sctx:shutdown())
+    _, len = sep.bio:peek()
+    assert.equal(len, 0)
+
+    -- test that throws an error with an unknown mode
+    assert.match(assert.throws(function()
+        client:set_shutdown_mode('unknown')
+    end), 'invalid option')
+
+    assert(cctx:close())
+    assert(sctx:close())
+    csock:close()
+    ssock:close()
+end
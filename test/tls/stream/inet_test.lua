@@ -364,6 +364,52 @@ function testcase.sendfile_recv_with_offset_nil_bytes()
     assert(p:wait())
 end
 
+function testcase.sendfile_pathname()
+    -- sendfile(pathname) reads the file from the descriptor of the open-fd
+    -- cache instead of wrapping it in a file handle.
+    local f = assert(io.open(TESTFILE, 'w+'))
+    local msg = 'hello world - sendfile pathname'
+    assert(f:write(msg))
+    assert(f:close())
+    local expected = msg:sub(7)
+
+    local host = '127.0.0.1'
+    local s = assert(inet.server.new(host, 0, {
+        reuseaddr = true,
+        reuseport = true,
+        tlscfg = SERVER_CONFIG,
+    }))
+    assert(s:listen())
+    local port = assert(s:getsockname()):port()
+
+    local p = fork()
+    if p:is_child() then
+        s:close()
+        local c = assert(inet.client.new(host, port, {
+            tlscfg = CLIENT_CONFIG,
+        }))
+        assert.equal(assert(c:sendfile(TESTFILE, nil, 6)), #expected)
+        -- wait for peer to close before shutting down TLS
+        c:read()
+        c:close()
+        return
+    end
+
+    local peer = assert(s:accept())
+    local total = 0
+    local chunks = {}
+    while total < #expected do
+        local data = assert(peer:recv())
+        total = total + #data
+        chunks[#chunks + 1] = data
+    end
+    assert.equal(table.concat(chunks), expected)
+
+    peer:close()
+    s:close()
+    assert(p:wait())
+end
+
 function testcase.sendfile_stops_at_eof()
     -- Regression: sendfile(f, bytes, offset) with bytes larger than the
     -- remaining file must not spin on pread returning the empty string.
@@ -564,6 +610,98 @@ function testcase.server_set_sni_callback()
     s:close()
 end
 
+function testcase.server_add_sni_cert()
+    local host = '127.0.0.1'
+    local s = assert(inet.server.new(host, 0, {
+        reuseaddr = true,
+        reuseport = true,
+        tlscfg = SERVER_CONFIG,
+    }))
+    assert(s:listen())
+    local port = assert(s:getsockname()):port()
+    local msg = 'hello'
+    local function connect(servername)
+        local p = fork()
+        if p:is_child() then
+            s:close()
+            local c = assert(inet.client.new(host, port, {
+                servername = servername,
+                tlscfg = CLIENT_CONFIG,
+            }))
+            assert(c:send(msg))
+
+            -- wait for peer to close
+            c:read()
+            c:close()
+            return true
+        end
+
+        local peer = assert(s:accept())
+        local rcv = assert(peer:recv())
+        assert.equal(rcv, msg)
+        peer:close()
+        assert(p:wait())
+    end
+
+    -- test that certificates are registered but not loaded
+    local f = assert(io.open(SERVER_CONFIG.key))
+    local key = f:read('*a')
+    f:close()
+    assert(s:add_sni_cert('www.example.com', SERVER_CONFIG.cert, key))
+    assert(s:add_sni_cert('*.example.net', SERVER_CONFIG.cert,
+                          SERVER_CONFIG.key))
+    assert.equal(s:get_sni_cache_stats(), {
+        certs = 2,
+        loaded = 0,
+        bytes = 0,
+    })
+
+    -- test that certificate is loaded on first use
+    if connect('www.example.com') then
+        return
+    end
+    local stats = s:get_sni_cache_stats()
+    assert.equal(stats.loaded, 1)
+    -- the estimate includes the overhead of the context itself
+    assert.greater(stats.bytes, 16384)
+
+    -- test that wildcard certificate is loaded and evicts the other
+    assert(s:set_sni_cache_limits(1))
+    if connect('foo.example.net') then
+        return
+    end
+    stats = s:get_sni_cache_stats()
+    assert.equal(stats.certs, 2)
+    assert.equal(stats.loaded, 1)
+
+    -- test that the callback is used for unregistered hostname
+    local ncall = 0
+    s:set_sni_callback(function(hostname)
+        ncall = ncall + 1
+        assert.equal(hostname, 'www.example.org')
+    end)
+    if connect('www.example.org') then
+        return
+    end
+    assert.equal(ncall, 1)
+
+    -- test that registered hostname still works without the callback
+    s:set_sni_callback(nil)
+    assert.is_true(s:remove_sni_cert('*.example.net'))
+    assert.is_false(s:remove_sni_cert('*.example.net'))
+    if connect('www.example.com') then
+        return
+    end
+    assert.equal(s:get_sni_cache_stats().certs, 1)
+    assert.equal(ncall, 1)
+
+    -- test that throws an error if limit is negative
+    local err = assert.throws(s.set_sni_cache_limits, s, -1)
+    assert.match(err, 'max_contexts must be >= 0')
+
+    s:close()
+end
+
 function testcase.write_read_bio()
     local host = '127.0.0.1'
     local s = assert(inet.server.new(host, 0, {